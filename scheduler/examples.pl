@@ -12,7 +12,103 @@ for $file (<examples/*>){
 		if($diff){
 			print "Test file $file differs\n$diff";
 		}
+
+		# Resumed from a checkpoint part way through, the run must end the same
+		`rm -f checkpoint`;
+		`./simulator -q -c $2 -s $3 -C 5,checkpoint examples/proc$1.csv 2>/dev/null`;
+		if(-e "checkpoint"){
+			`./simulator -R checkpoint | tail -7 > output3`;
+			$diff = `diff output1 output3`;
+			if($diff){
+				print "Test file $file differs when resumed from a checkpoint\n$diff";
+			}
+		}
+
+		# Every decision recorded with -r must come out the same under -V
+		`rm -f decisions`;
+		`./simulator -q -c $2 -s $3 -r decisions examples/proc$1.csv 2>/dev/null`;
+		$verify = `./simulator -V decisions 2>&1`;
+		if($verify !~ /all decisions match/){
+			print "Test file $file differs when its decision log is replayed\n$verify";
+		}
+	}
+}
+
+# With -q, fcfs, sjf and pri jump from one dispatch or completion to the
+# next; they must come out the same as one time unit at a time
+srand(1);
+open(JOBS, ">", "fastjobs.csv");
+print JOBS "\"Arrival time\",\"Run time\",\"Priority\"\n";
+for ($i = 0, $time = 0; $i < 2000; $i++){
+	$time += int(rand(4));
+	printf JOBS "%d,%d,%d\n", $time, 1 + int(rand(12)), int(rand(8));
+}
+close(JOBS);
+for $input ((<examples/proc*.csv>), "fastjobs.csv"){
+	for $scheme ("fcfs", "sjf", "pri"){
+		for $cores (1, 2, 3){
+			$lines = $cores + 5;
+			`./simulator -c $cores -s $scheme $input | tail -$lines > output1`;
+			`./simulator -q -c $cores -s $scheme $input | tail -$lines > output2`;
+			$diff = `diff output1 output2`;
+			if($diff){
+				print "Fast forward differs for $input on $cores core(s) with $scheme\n$diff";
+			}
+		}
+	}
+}
+# Split at idle instants and run by workers, the busy periods must add up
+# to the serial run
+for $input ((<examples/proc*.csv>), "fastjobs.csv"){
+	for $scheme ("fcfs", "sjf", "psjf", "pri", "ppri", "edf"){
+		for $cores (1, 2, 4){
+			`./simulator -q -c $cores -s $scheme $input > output1 2>&1`;
+			`./simulator -q -j 4 -c $cores -s $scheme $input > output2 2>&1`;
+			$diff = `diff output1 output2`;
+			if($diff){
+				print "Parallel run differs for $input on $cores core(s) with $scheme\n$diff";
+			}
+		}
+	}
+}
+# Quantum schemes pick the next job for an expired core themselves; with
+# cores left idle between arrivals, every job must still get to run
+srand(1);
+open(JOBS, ">", "idlejobs.csv");
+print JOBS "\"Arrival time\",\"Run time\",\"Priority\"\n";
+for ($i = 0, $time = 0; $i < 3000; $i++){
+	$time += int(rand(8));
+	printf JOBS "%d,%d,%d\n", $time, 1 + int(rand(20)), int(rand(8));
+}
+close(JOBS);
+for $scheme ("mlfq", "stride4", "lottery4"){
+	for $cores (2, 3, 4){
+		$output = `./simulator -q -c $cores -s $scheme idlejobs.csv`;
+		if($output !~ /Average Response Time/){
+			print "Jobs left unscheduled on $cores core(s) with $scheme\n";
+		}
+	}
+}
+# A trace must carry enough to print what the simulator printed,
+# deadline statistics included
+srand(1);
+open(JOBS, ">", "deadlinejobs.csv");
+print JOBS "\"Arrival time\",\"Run time\",\"Priority\",\"Deadline\"\n";
+for ($i = 0, $time = 0; $i < 500; $i++){
+	$time += int(rand(5));
+	$run = 1 + int(rand(12));
+	printf JOBS "%d,%d,%d,%s\n", $time, $run, int(rand(8)), rand() < 0.8 ? $time + $run + int(rand(30)) : "";
+}
+close(JOBS);
+for $scheme ("edf", "fcfs"){
+	for $cores (1, 2, 4){
+		`./simulator -c $cores -s $scheme -t trace deadlinejobs.csv > output1`;
+		`./tracetool text trace > output2`;
+		$diff = `diff output1 output2`;
+		if($diff){
+			print "Trace of deadlinejobs.csv differs on $cores core(s) with $scheme\n$diff";
+		}
 	}
 }
 #cleanup
-`rm output1 output2`;
+`rm -f output1 output2 output3 checkpoint decisions trace fastjobs.csv idlejobs.csv deadlinejobs.csv`;
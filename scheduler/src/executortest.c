@@ -0,0 +1,232 @@
+/** @file executortest.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "libring/libring.h"
+#include "libexecutor/libexecutor.h"
+
+// Producers and values each pushes in the ring test
+#define RING_PRODUCERS 4
+#define RING_VALUES 200000
+#define RING_CAPACITY 1024
+
+// Jobs each producer posts in the stress benchmark, and the length of a
+// unit of their work
+#define BENCH_JOBS 2000
+#define BENCH_UNIT_NS 2000LL
+#define BENCH_QUANTUM 2
+
+typedef struct _ring_producer_t
+{
+  ring_t *ring;
+  int id;
+  long full;  // Pushes turned away by a full ring
+
+} ring_producer_t;
+
+typedef struct _bench_producer_t
+{
+  executor_t *executor;
+  int first;
+  int count;
+  long long done_ns;  // When the last post went through
+  long full;
+
+} bench_producer_t;
+
+void *ring_producer(void *arg)
+{
+	ring_producer_t *p = (ring_producer_t *)arg;
+
+	for (int i = 0; i < RING_VALUES; i++) {
+		while (ring_push(p->ring, p->id * RING_VALUES + i) != 0) {
+			p->full++;
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+/**
+  Pushes from RING_PRODUCERS threads at once into a small ring and pops
+  everything on this thread, checking each value comes out once and in
+  the order its producer pushed it.
+ */
+void test_ring()
+{
+	ring_t ring;
+	ring_producer_t producers[RING_PRODUCERS];
+	pthread_t threads[RING_PRODUCERS];
+	int last[RING_PRODUCERS];
+	char *seen = calloc(RING_PRODUCERS * RING_VALUES, 1);
+	long received = 0, full = 0;
+	int lost = 0, out_of_order = 0, value, i;
+
+	ring_init(&ring, RING_CAPACITY);
+	for (i = 0; i < RING_PRODUCERS; i++) {
+		producers[i].ring = &ring;
+		producers[i].id = i;
+		producers[i].full = 0;
+		last[i] = -1;
+		pthread_create(&threads[i], NULL, ring_producer, &producers[i]);
+	}
+
+	while (received < RING_PRODUCERS * RING_VALUES) {
+		if (ring_pop(&ring, &value) != 0) {
+			sched_yield();
+			continue;
+		}
+		received++;
+
+		int producer = value / RING_VALUES;
+		if (value < 0 || producer >= RING_PRODUCERS || seen[value]) {
+			lost++;
+			continue;
+		}
+		seen[value] = 1;
+		if (value % RING_VALUES != last[producer] + 1)
+			out_of_order++;
+		last[producer] = value % RING_VALUES;
+	}
+
+	for (i = 0; i < RING_PRODUCERS; i++) {
+		pthread_join(threads[i], NULL);
+		full += producers[i].full;
+	}
+	for (i = 0; i < RING_PRODUCERS * RING_VALUES; i++) {
+		if (!seen[i])
+			lost++;
+	}
+
+	printf("Ring: %d values from %d producers through %d slots (%ld pushes found it full).\n",
+			RING_PRODUCERS * RING_VALUES, RING_PRODUCERS, RING_CAPACITY, full);
+	printf("Values lost or duplicated: %d (expected 0).\n", lost);
+	printf("Values out of order: %d (expected 0).\n", out_of_order);
+	printf("Left in the ring: %s (expected empty).\n", ring_empty(&ring) ? "empty" : "not empty");
+
+	ring_destroy(&ring);
+	free(seen);
+}
+
+void *bench_producer(void *arg)
+{
+	bench_producer_t *p = (bench_producer_t *)arg;
+
+	for (int i = 0; i < p->count; i++) {
+		while (executor_post(p->executor, p->first + i) != 0) {
+			p->full++;
+			sched_yield();
+		}
+	}
+	p->done_ns = executor_now(p->executor);
+	return NULL;
+}
+
+/**
+  Posts BENCH_JOBS short jobs from each of producers threads into an
+  executor with cores workers and prints a row of the results.
+
+  @return nonzero if any job did not run exactly its units of work
+ */
+int bench_executor(const char *label, int mode, int scheme, int producers, int cores, long long spin_per_unit)
+{
+	int count = producers * BENCH_JOBS, i;
+	executor_job_t *jobs = calloc(count, sizeof(executor_job_t));
+	bench_producer_t *p = calloc(producers, sizeof(bench_producer_t));
+	pthread_t *threads = malloc(producers * sizeof(pthread_t));
+	executor_t executor;
+	executor_stats_t stats;
+	long long units = 0, done_ns = 0;
+
+	for (i = 0; i < count; i++) {
+		jobs[i].running_time = 1 + i % 3;
+		jobs[i].priority = i % 5;
+		jobs[i].deadline = -1;
+		units += jobs[i].running_time;
+	}
+
+	if (mode == EXECUTOR_LOCKED)
+		scheduler_start_up(cores, scheme);
+	if (executor_init(&executor, mode, cores, scheme, BENCH_QUANTUM, BENCH_UNIT_NS, spin_per_unit, jobs, count) != 0) {
+		printf("Unable to start %d workers.\n", cores);
+		exit(1);
+	}
+
+	long long start = executor_now(&executor);
+	for (i = 0; i < producers; i++) {
+		p[i].executor = &executor;
+		p[i].first = i * BENCH_JOBS;
+		p[i].count = BENCH_JOBS;
+		pthread_create(&threads[i], NULL, bench_producer, &p[i]);
+	}
+	for (i = 0; i < producers; i++) {
+		pthread_join(threads[i], NULL);
+		if (p[i].done_ns > done_ns)
+			done_ns = p[i].done_ns;
+	}
+
+	int stalled = executor_wait(&executor) != 0;
+	executor_stats(&executor, &stats);
+
+	double seconds = (done_ns - start) / 1e9;
+	printf("  %-7s %9d %5d %14.0f %12.1f %12.1f %12.1f %9.0f%s\n", label, producers, cores,
+			seconds > 0 ? count / seconds : 0.0, stats.dispatch_p50, stats.dispatch_p99, stats.response_p99, stats.wall_ns ? stats.finished / (stats.wall_ns / 1e9) : 0.0,
+			stalled ? " (stalled)" : "");
+
+	executor_destroy(&executor);
+	if (mode == EXECUTOR_LOCKED)
+		scheduler_clean_up();
+
+	int bad = stalled || stats.finished != count || stats.units != units;
+	for (i = 0; i < count; i++) {
+		if (jobs[i].remaining != 0)
+			bad = 1;
+	}
+
+	free(jobs);
+	free(p);
+	free(threads);
+	return bad;
+}
+
+int main()
+{
+	const char *scheme_names[] = {"fcfs", "sjf", "psjf", "pri", "ppri", "rr", "mlfq", "ws", "edf"};
+	const char *mode_names[] = {"locked", "sharded", "relaxed"};
+	int producers[] = {1, 2, 4}, cores[] = {1, 2, 4};
+	int bad = 0;
+
+	test_ring();
+
+	long long spin = executor_calibrate(BENCH_UNIT_NS);
+
+	printf("\nStress benchmark, %d FCFS jobs of 1-3 units of %lld us per producer (latencies in us):\n",
+			BENCH_JOBS, BENCH_UNIT_NS / 1000);
+	printf("  %-7s %9s %5s %14s %12s %12s %12s %9s\n", "run", "producers", "cores", "submissions/s",
+			"dispatch p50", "dispatch p99", "response p99", "jobs/s");
+	for (int mode = EXECUTOR_LOCKED; mode <= EXECUTOR_RELAXED; mode++) {
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++)
+				bad += bench_executor(mode_names[mode], mode, FCFS, producers[i], cores[j], spin);
+		}
+	}
+
+	printf("Runs that lost or repeated work: %d (expected 0).\n", bad);
+
+	bad = 0;
+	for (int mode = EXECUTOR_SHARDED; mode <= EXECUTOR_RELAXED; mode++) {
+		printf("\nEvery scheme the %s mode takes:\n", mode_names[mode]);
+		for (int scheme = FCFS; scheme <= EDF; scheme++) {
+			if (executor_sharded(scheme))
+				bad += bench_executor(scheme_names[scheme], mode, scheme, 2, 2, spin);
+		}
+	}
+	printf("Schemes that lost or repeated work: %d (expected 0).\n", bad);
+
+	return 0;
+}
@@ -0,0 +1,1006 @@
+/** @file libexecutor.c
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+
+#include "libexecutor.h"
+
+
+// Where each worker's spin loop leaves its result, so the loop cannot be left out
+static __thread volatile unsigned long executor_sink;
+
+
+static long long executor_clock()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+/**
+  Busy work standing in for a unit of a job without a work function: a
+  chain of dependent multiplies that cannot be overlapped or skipped.
+ */
+static void executor_spin(long long iterations)
+{
+	unsigned long x = executor_sink;
+
+	for (long long i = 0; i < iterations; i++)
+		x = x * 6364136223846793005UL + 1442695040888963407UL;
+	executor_sink = x;
+}
+
+
+/**
+  Pins the calling worker to the core_id-th CPU it is allowed to run on,
+  wrapping around when there are more cores than CPUs.
+ */
+static int executor_pin(int core_id)
+{
+	cpu_set_t allowed, set;
+	int cpu, skip;
+
+	if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0 || 0 == CPU_COUNT(&allowed))
+		return 0;
+
+	skip = core_id % CPU_COUNT(&allowed);
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &allowed) && 0 == skip--)
+			break;
+	}
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+}
+
+
+/**
+  Runs one unit of job's work on the calling worker.
+ */
+static void executor_unit(executor_t *e, executor_job_t *job)
+{
+	if (job->work != NULL)
+		job->work(job->arg, job->running_time - job->remaining);
+	else
+		executor_spin(e->spin_per_unit);
+}
+
+
+/**
+  Records a dispatch that took latency_ns from the decision to the worker.
+ */
+static void executor_dispatched(executor_core_t *core, long long latency_ns)
+{
+	if (core->latencies == core->latency_size) {
+		core->latency_size = core->latency_size ? 2 * core->latency_size : 256;
+		core->latency = realloc(core->latency, core->latency_size * sizeof(long long));
+	}
+	core->latency[core->latencies++] = latency_ns;
+	core->dispatches++;
+}
+
+
+/**
+  Quantum a core's clock is armed with when it is given a job, 0 for
+  schemes that never expire one.
+ */
+static int executor_quantum(executor_t *e, int core_id)
+{
+	if (e->scheme == MLFQ)
+		return scheduler_core_quantum(core_id);
+	if (e->scheme == RR || e->scheme == STRIDE || e->scheme == LOTTERY)
+		return e->quantum;
+	return 0;
+}
+
+
+/**
+  Wakes one worker waiting for work, after a job was posted.
+ */
+static void executor_wake(executor_t *e)
+{
+	for (int i = 0; i < e->cores; i++) {
+		executor_core_t *core = &e->core[i];
+		pthread_mutex_t *lock = (e->mode == EXECUTOR_LOCKED) ? &e->lock : &core->lock;
+
+		if (!atomic_load(&core->sleeping))
+			continue;
+
+		pthread_mutex_lock(lock);
+		int woken = atomic_load(&core->sleeping);
+		if (woken)
+			pthread_cond_signal(&core->wake);
+		pthread_mutex_unlock(lock);
+
+		if (woken)
+			return;
+	}
+}
+
+
+/**
+  Counts a finished job, waking executor_wait() after the last one.
+ */
+static void executor_job_done(executor_t *e, long long now)
+{
+	if (atomic_fetch_add(&e->finished, 1) + 1 < e->count)
+		return;
+
+	// The locked workers already hold the lock
+	if (e->mode != EXECUTOR_LOCKED)
+		pthread_mutex_lock(&e->lock);
+	e->finish_ns = now;
+	pthread_cond_signal(&e->progress);
+	if (e->mode != EXECUTOR_LOCKED)
+		pthread_mutex_unlock(&e->lock);
+}
+
+
+/*
+ * Locked mode: every decision is libscheduler's, made under e->lock.
+ */
+
+/**
+  Time unit to hand the scheduler at now. It never goes backwards, even
+  when the caller read the clock before another thread took the lock.
+ */
+static int executor_time(executor_t *e, long long now)
+{
+	int time = (int)(now / e->unit_ns);
+
+	if (time > e->time)
+		e->time = time;
+	return e->time;
+}
+
+
+/**
+  Brings every core in line with the scheduler after a scheduler call that
+  started at since, waking the workers given a new job. Called with the
+  lock held.
+ */
+static void executor_sync(executor_t *e, long long since)
+{
+	long long now = executor_now(e);
+	int idle = 0;
+
+	e->scheduler_calls++;
+	e->scheduler_ns += now - since;
+
+	for (int i = 0; i < e->cores; i++) {
+		executor_core_t *core = &e->core[i];
+		int job = scheduler_core_job(i);
+
+		if (job != core->job) {
+			core->job = job;
+			core->assigned_ns = now;
+			if (job >= 0)
+				pthread_cond_signal(&core->wake);
+		}
+		if (core->job < 0)
+			idle++;
+	}
+
+	if (idle == e->cores)
+		pthread_cond_signal(&e->progress);
+}
+
+
+/**
+  Hands the posted jobs to the scheduler as one batch. Called with the
+  lock held, which makes the caller the ring's only consumer.
+ */
+static void executor_take_posted(executor_t *e)
+{
+	int count = 0, job_number;
+
+	while (count < EXECUTOR_RING_SLOTS && 0 == ring_pop(&e->posted, &job_number)) {
+		executor_job_t *job = &e->jobs[job_number];
+
+		e->batch[count].job_number = job_number;
+		e->batch[count].running_time = job->running_time;
+		e->batch[count].priority = job->priority;
+		e->batch[count].deadline = job->deadline;
+		e->batch[count].cores = 1;
+		count++;
+	}
+	if (0 == count)
+		return;
+
+	long long now = executor_now(e);
+	scheduler_new_jobs(e->batch, count, executor_time(e, now));
+	e->submitted += count;
+	executor_sync(e, now);
+}
+
+
+/**
+  Tells the scheduler the job on core finished. Called with the lock held.
+ */
+static void executor_finished(executor_t *e, executor_core_t *core, int job_number)
+{
+	long long now = executor_now(e);
+
+	scheduler_job_finished(core->id, job_number, executor_time(e, now));
+	executor_sync(e, now);
+
+	core->running = -1;
+	executor_job_done(e, now);
+	pthread_cond_signal(&e->progress);
+}
+
+
+/**
+  Locked worker thread body. Between units of work the worker takes the
+  lock and looks at what the scheduler has on its core; that is the only
+  point a job can be preempted at.
+ */
+static void *executor_worker(void *arg)
+{
+	executor_core_t *core = (executor_core_t *)arg;
+	executor_t *e = core->executor;
+	int pinned = executor_pin(core->id);
+
+	pthread_mutex_lock(&e->lock);
+	core->pinned = pinned;
+
+	while (!atomic_load(&e->closing)) {
+		if (!ring_empty(&e->posted))
+			executor_take_posted(e);
+
+		int job_number = core->job;
+
+		if (job_number < 0) {
+			core->running = -1;
+
+			// A job posted after this check finds the worker asleep and wakes it
+			atomic_store(&core->sleeping, 1);
+			atomic_fetch_add(&e->sleepers, 1);
+			if (ring_empty(&e->posted) && !atomic_load(&e->closing))
+				pthread_cond_wait(&core->wake, &e->lock);
+			atomic_fetch_sub(&e->sleepers, 1);
+			atomic_store(&core->sleeping, 0);
+			continue;
+		}
+
+		executor_job_t *job = &e->jobs[job_number];
+
+		// The job was taken off another core that is still in a unit of it
+		if (job->worker >= 0) {
+			pthread_cond_wait(&core->wake, &e->lock);
+			continue;
+		}
+
+		long long now = executor_now(e);
+
+		if (job_number != core->running) {
+			executor_dispatched(core, now - core->assigned_ns);
+
+			if (core->running >= 0 && e->jobs[core->running].remaining > 0)
+				core->preemptions++;
+			core->running = job_number;
+			core->quantum_left = executor_quantum(e, core->id);
+
+			if (job->start_ns < 0)
+				job->start_ns = now;
+		}
+
+		// A job that ran its last unit after being taken off a core
+		// finishes as soon as it is given one again
+		if (0 == job->remaining) {
+			executor_finished(e, core, job_number);
+			continue;
+		}
+
+		job->worker = core->id;
+		pthread_mutex_unlock(&e->lock);
+
+		executor_unit(e, job);
+		long long end = executor_now(e);
+
+		pthread_mutex_lock(&e->lock);
+		job->worker = -1;
+		core->busy_ns += end - now;
+		core->units++;
+
+		if (0 == --job->remaining)
+			job->finish_ns = end;
+
+		if (core->job != job_number) {
+			// Preempted during the unit; wake whichever core has it now
+			for (int i = 0; i < e->cores; i++) {
+				if (e->core[i].job == job_number)
+					pthread_cond_signal(&e->core[i].wake);
+			}
+		} else if (0 == job->remaining) {
+			executor_finished(e, core, job_number);
+		} else if (core->quantum_left > 0 && 0 == --core->quantum_left) {
+			scheduler_quantum_expired(core->id, executor_time(e, end));
+			executor_sync(e, end);
+			core->quantum_left = executor_quantum(e, core->id);
+		}
+	}
+	pthread_mutex_unlock(&e->lock);
+
+	return NULL;
+}
+
+
+/*
+ * Sharded mode: each core's worker makes its own decisions from its own
+ * ready queue, under the core's lock. Relaxed mode shares these workers,
+ * but every core polls the same relaxed queue.
+ */
+
+static int executor_fifo_comparator(const void *a, const void *b)
+{
+	return 0;
+}
+
+static int executor_sjf_comparator(const void *a, const void *b)
+{
+	return ((const executor_job_t *)a)->running_time - ((const executor_job_t *)b)->running_time;
+}
+
+static int executor_psjf_comparator(const void *a, const void *b)
+{
+	return ((const executor_job_t *)a)->remaining - ((const executor_job_t *)b)->remaining;
+}
+
+static int executor_pri_comparator(const void *a, const void *b)
+{
+	return ((const executor_job_t *)a)->priority - ((const executor_job_t *)b)->priority;
+}
+
+static int executor_edf_comparator(const void *a, const void *b)
+{
+	int x = ((const executor_job_t *)a)->deadline, y = ((const executor_job_t *)b)->deadline;
+
+	// Jobs without a deadline go behind every job with one
+	if (x == y)
+		return 0;
+	if (x < 0)
+		return 1;
+	if (y < 0)
+		return -1;
+	return x - y;
+}
+
+
+/**
+  Whether a job queued on a core takes the core from a worse running job.
+ */
+static int executor_preemptive(int scheme)
+{
+	return scheme == PSJF || scheme == PPRI || scheme == EDF;
+}
+
+
+/**
+  Queues job on a core: one whose worker is waiting for work if there is
+  one, otherwise the shorter of two ready queues drawn at random. In
+  relaxed mode job goes on the shared queue instead, and a waiting worker
+  is woken for it. Only the thread draining the ring places jobs.
+ */
+static void executor_place(executor_t *e, executor_job_t *job)
+{
+	executor_core_t *core = NULL;
+
+	if (e->mode == EXECUTOR_RELAXED) {
+		job->queued_ns = executor_now(e);
+		priqueue_multi_offer(&e->relaxed, job, &e->seed);
+	}
+
+	if (atomic_load(&e->sleepers) > 0) {
+		for (int i = 0; i < e->cores && NULL == core; i++) {
+			if (atomic_load(&e->core[i].sleeping))
+				core = &e->core[i];
+		}
+	}
+	if (e->mode == EXECUTOR_RELAXED) {
+		if (core != NULL) {
+			pthread_mutex_lock(&core->lock);
+			pthread_cond_signal(&core->wake);
+			pthread_mutex_unlock(&core->lock);
+		}
+		return;
+	}
+	if (NULL == core) {
+		executor_core_t *a = &e->core[rand_r(&e->seed) % e->cores];
+		executor_core_t *b = &e->core[rand_r(&e->seed) % e->cores];
+		core = (atomic_load(&b->length) < atomic_load(&a->length)) ? b : a;
+	}
+
+	pthread_mutex_lock(&core->lock);
+	job->queued_ns = executor_now(e);
+	priqueue_offer(&core->ready, job);
+	atomic_fetch_add(&core->length, 1);
+
+	// The worker compares the job with its own at its next unit boundary
+	if (core->current != NULL && executor_preemptive(e->scheme))
+		atomic_store(&core->preempt, 1);
+	if (atomic_load(&core->sleeping))
+		pthread_cond_signal(&core->wake);
+	pthread_mutex_unlock(&core->lock);
+}
+
+
+/**
+  Places every posted job, unless another worker already is.
+ */
+static void executor_drain(executor_t *e)
+{
+	int job_number;
+
+	if (ring_empty(&e->posted) || atomic_exchange(&e->draining, 1))
+		return;
+
+	while (0 == ring_pop(&e->posted, &job_number))
+		executor_place(e, &e->jobs[job_number]);
+	atomic_store(&e->draining, 0);
+}
+
+
+/**
+  Takes the best job off core's ready queue, or failing that off the first
+  other core's queue that has one and is not locked. In relaxed mode the
+  job is polled from the shared queue.
+
+  @return the job, now core's current job, or NULL if none was found
+ */
+static executor_job_t *executor_take(executor_t *e, executor_core_t *core)
+{
+	executor_job_t *job = NULL;
+
+	if (e->mode == EXECUTOR_RELAXED)
+		return priqueue_multi_poll(&e->relaxed, &core->seed);
+
+	pthread_mutex_lock(&core->lock);
+	if ((job = priqueue_poll(&core->ready)) != NULL)
+		atomic_fetch_sub(&core->length, 1);
+	core->current = job;
+	pthread_mutex_unlock(&core->lock);
+
+	for (int i = 1; i < e->cores && NULL == job; i++) {
+		executor_core_t *victim = &e->core[(core->id + i) % e->cores];
+
+		if (0 == atomic_load(&victim->length) || pthread_mutex_trylock(&victim->lock) != 0)
+			continue;
+		if ((job = priqueue_poll(&victim->ready)) != NULL)
+			atomic_fetch_sub(&victim->length, 1);
+		pthread_mutex_unlock(&victim->lock);
+
+		if (job != NULL) {
+			pthread_mutex_lock(&core->lock);
+			core->current = job;
+			pthread_mutex_unlock(&core->lock);
+		}
+	}
+
+	return job;
+}
+
+
+/**
+  Waits for a job to be queued on core or posted, unless one already
+  has been, or is queued anywhere for the worker to steal.
+ */
+static void executor_idle(executor_t *e, executor_core_t *core)
+{
+	int queued = 0;
+
+	pthread_mutex_lock(&core->lock);
+	atomic_store(&core->sleeping, 1);
+	atomic_fetch_add(&e->sleepers, 1);
+
+	if (e->mode == EXECUTOR_RELAXED)
+		queued = priqueue_multi_size(&e->relaxed);
+	for (int i = 0; i < e->cores; i++)
+		queued += atomic_load(&e->core[i].length);
+	if (0 == queued && ring_empty(&e->posted) && !atomic_load(&e->closing))
+		pthread_cond_wait(&core->wake, &core->lock);
+
+	atomic_fetch_sub(&e->sleepers, 1);
+	atomic_store(&core->sleeping, 0);
+	pthread_mutex_unlock(&core->lock);
+}
+
+
+/**
+  Puts job back on core's ready queue in place of the queue's best job, if
+  the quantum expired or the best job comes before it.
+
+  @return the job to run next, which may be job
+ */
+static executor_job_t *executor_switch(executor_t *e, executor_core_t *core, executor_job_t *job, int expired,
+		long long now)
+{
+	pthread_mutex_lock(&core->lock);
+	executor_job_t *next = priqueue_peek(&core->ready);
+	if (next != NULL && (expired || e->comp(next, job) < 0)) {
+		priqueue_poll(&core->ready);
+		job->queued_ns = now;
+		priqueue_offer(&core->ready, job);
+		core->current = next;
+	} else {
+		next = job;
+	}
+	pthread_mutex_unlock(&core->lock);
+
+	return next;
+}
+
+
+/**
+  The same for relaxed mode: when the quantum expired, job goes back on
+  the shared queue and the worker polls it again; under a preemptive
+  scheme job is swapped for the better of two heads if that comes first.
+
+  @return the job to run next, which may be job, or NULL if job went back
+    and another worker has taken every job since
+ */
+static executor_job_t *executor_requeue(executor_t *e, executor_core_t *core, executor_job_t *job, int expired,
+		long long now)
+{
+	job->queued_ns = now;
+	if (expired) {
+		priqueue_multi_offer(&e->relaxed, job, &core->seed);
+		return priqueue_multi_poll(&e->relaxed, &core->seed);
+	}
+	if (executor_preemptive(e->scheme))
+		return priqueue_multi_swap(&e->relaxed, job, &core->seed);
+	return job;
+}
+
+
+/**
+  Sharded and relaxed worker thread body. Between units of work the
+  worker places posted jobs and checks, without a lock, whether a job has
+  been queued on its core that may beat its own, or its quantum is up;
+  only then does it take the core's lock to look at its queue. A relaxed
+  worker instead draws two heads from the shared queue for each check.
+ */
+static void *executor_shard_worker(void *arg)
+{
+	executor_core_t *core = (executor_core_t *)arg;
+	executor_t *e = core->executor;
+	int pinned = executor_pin(core->id);
+
+	pthread_mutex_lock(&e->lock);
+	core->pinned = pinned;
+	pthread_mutex_unlock(&e->lock);
+
+	while (!atomic_load(&e->closing)) {
+		executor_drain(e);
+
+		executor_job_t *job = executor_take(e, core);
+		if (NULL == job) {
+			executor_idle(e, core);
+			continue;
+		}
+
+		long long now = executor_now(e);
+		executor_dispatched(core, now - job->queued_ns);
+		if (job->start_ns < 0)
+			job->start_ns = now;
+		core->quantum_left = executor_quantum(e, core->id);
+
+		while (1) {
+			executor_unit(e, job);
+			long long end = executor_now(e);
+
+			core->busy_ns += end - now;
+			core->units++;
+			now = end;
+
+			if (0 == --job->remaining) {
+				job->finish_ns = end;
+				pthread_mutex_lock(&core->lock);
+				core->current = NULL;
+				pthread_mutex_unlock(&core->lock);
+				executor_job_done(e, end);
+				break;
+			}
+
+			executor_drain(e);
+
+			int expired = 0;
+			if (core->quantum_left > 0 && 0 == --core->quantum_left) {
+				if (e->mode == EXECUTOR_RELAXED)
+					expired = priqueue_multi_size(&e->relaxed) > 0;
+				else
+					expired = atomic_load(&core->length) > 0;
+				core->quantum_left = e->quantum;
+			}
+
+			executor_job_t *next;
+			if (e->mode == EXECUTOR_RELAXED)
+				next = executor_requeue(e, core, job, expired, end);
+			else if (expired || (atomic_load_explicit(&core->preempt, memory_order_relaxed)
+					&& atomic_exchange(&core->preempt, 0)))
+				next = executor_switch(e, core, job, expired, end);
+			else
+				continue;
+
+			if (next != job) {
+				core->preemptions++;
+				if (NULL == next)
+					break;
+
+				job = next;
+				executor_dispatched(core, end - job->queued_ns);
+				if (job->start_ns < 0)
+					job->start_ns = end;
+				core->quantum_left = e->quantum;
+			}
+			now = executor_now(e);
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+  Times the spin loop run for jobs without a work function.
+
+  @param unit_ns wall-clock length of one time unit in nanoseconds
+  @return spin loop iterations that take about unit_ns on this machine
+ */
+long long executor_calibrate(long long unit_ns)
+{
+	long long iterations = 1 << 16, elapsed;
+
+	while (1) {
+		long long start = executor_clock();
+		executor_spin(iterations);
+		elapsed = executor_clock() - start;
+
+		if (elapsed >= EXECUTOR_CALIBRATE_NS)
+			break;
+		iterations *= 2;
+	}
+
+	long long per_unit = (long long)((double)iterations * unit_ns / elapsed);
+	return per_unit > 0 ? per_unit : 1;
+}
+
+
+/**
+  @param scheme a scheme_t
+  @return nonzero if the scheme can run in EXECUTOR_SHARDED or
+    EXECUTOR_RELAXED mode
+ */
+int executor_sharded(int scheme)
+{
+	return scheme == FCFS || scheme == SJF || scheme == PSJF || scheme == PRI || scheme == PPRI
+		|| scheme == RR || scheme == EDF;
+}
+
+
+/**
+  Starts a worker thread for each core. In EXECUTOR_LOCKED mode the
+  scheduler must already have been started up with the same number of
+  cores and scheme; from here on it is only called by the executor, under
+  its lock. The other modes do not use the scheduler.
+
+  @param e a pointer to an instance of the executor_t data structure
+  @param mode an executor_mode_t
+  @param cores number of cores, one worker thread each
+  @param scheme the scheme_t to schedule by
+  @param quantum the RR, STRIDE or LOTTERY quantum (ignored otherwise)
+  @param unit_ns wall-clock length of one time unit in nanoseconds
+  @param spin_per_unit spin loop iterations per unit of work, from
+         executor_calibrate()
+  @param jobs the jobs that will be submitted, indexed by job number
+  @param count number of jobs
+  @return 0 on success
+  @return -1 if a worker thread could not be started, or the scheme
+    cannot be sharded (see executor_sharded())
+ */
+int executor_init(executor_t *e, int mode, int cores, int scheme, int quantum, long long unit_ns,
+		long long spin_per_unit, executor_job_t *jobs, int count)
+{
+	if (mode != EXECUTOR_LOCKED && !executor_sharded(scheme))
+		return -1;
+
+	memset(e, 0, sizeof(executor_t));
+	e->mode = mode;
+	e->cores = cores;
+	e->scheme = scheme;
+	e->quantum = quantum;
+	e->unit_ns = unit_ns;
+	e->spin_per_unit = spin_per_unit;
+	e->jobs = jobs;
+	e->count = count;
+	e->seed = 1;
+
+	if (scheme == SJF) e->comp = executor_sjf_comparator;
+	else if (scheme == PSJF) e->comp = executor_psjf_comparator;
+	else if (scheme == PRI || scheme == PPRI) e->comp = executor_pri_comparator;
+	else if (scheme == EDF) e->comp = executor_edf_comparator;
+	else e->comp = executor_fifo_comparator;
+
+	for (int i = 0; i < count; i++) {
+		jobs[i].remaining = jobs[i].running_time;
+		jobs[i].submit_ns = jobs[i].queued_ns = jobs[i].start_ns = jobs[i].finish_ns = -1;
+		jobs[i].worker = -1;
+	}
+
+	ring_init(&e->posted, EXECUTOR_RING_SLOTS);
+	if (mode == EXECUTOR_LOCKED)
+		e->batch = malloc(EXECUTOR_RING_SLOTS * sizeof(scheduler_new_job_t));
+	if (mode == EXECUTOR_RELAXED)
+		priqueue_multi_init(&e->relaxed, e->comp, cores, EXECUTOR_RELAXATION);
+	pthread_mutex_init(&e->lock, NULL);
+	pthread_cond_init(&e->progress, NULL);
+	e->core = calloc(cores, sizeof(executor_core_t));
+	e->start_ns = executor_clock();
+
+	pthread_mutex_lock(&e->lock);
+	for (int i = 0; i < cores; i++) {
+		executor_core_t *core = &e->core[i];
+
+		core->executor = e;
+		core->id = i;
+		core->job = core->running = -1;
+		core->seed = i + 1;
+		pthread_cond_init(&core->wake, NULL);
+		pthread_mutex_init(&core->lock, NULL);
+		priqueue_init_heap(&core->ready, e->comp, PRIQUEUE_CACHE_ARITY);
+
+		if (pthread_create(&core->thread, NULL, mode == EXECUTOR_LOCKED ? executor_worker : executor_shard_worker,
+				core) != 0) {
+			pthread_cond_destroy(&core->wake);
+			pthread_mutex_destroy(&core->lock);
+			priqueue_destroy(&core->ready);
+			e->cores = i;
+			pthread_mutex_unlock(&e->lock);
+			executor_destroy(e);
+			return -1;
+		}
+	}
+	pthread_mutex_unlock(&e->lock);
+
+	return 0;
+}
+
+
+/**
+  @param e a pointer to an instance of the executor_t data structure
+  @return nanoseconds since executor_init()
+ */
+long long executor_now(executor_t *e)
+{
+	return executor_clock() - e->start_ns;
+}
+
+
+/**
+  Hands jobs to the scheduler as one batch arriving now, and wakes the
+  workers of the cores they were put on. In the other modes the jobs
+  are posted one by one instead.
+
+  @param e a pointer to an instance of the executor_t data structure
+  @param job_numbers the jobs, in the order the scheduler sees them
+  @param count number of jobs
+ */
+void executor_submit(executor_t *e, const int *job_numbers, int count)
+{
+	if (e->mode != EXECUTOR_LOCKED) {
+		for (int i = 0; i < count; i++) {
+			while (executor_post(e, job_numbers[i]) != 0)
+				sched_yield();
+		}
+		return;
+	}
+
+	scheduler_new_job_t *batch = malloc(count * sizeof(scheduler_new_job_t));
+
+	pthread_mutex_lock(&e->lock);
+	long long now = executor_now(e);
+
+	for (int i = 0; i < count; i++) {
+		executor_job_t *job = &e->jobs[job_numbers[i]];
+
+		job->submit_ns = now;
+		batch[i].job_number = job_numbers[i];
+		batch[i].running_time = job->running_time;
+		batch[i].priority = job->priority;
+		batch[i].deadline = job->deadline;
+		batch[i].cores = 1;
+	}
+
+	scheduler_new_jobs(batch, count, executor_time(e, now));
+	e->submitted += count;
+	executor_sync(e, now);
+	pthread_mutex_unlock(&e->lock);
+
+	free(batch);
+}
+
+
+/**
+  Submits one job from any thread without taking a lock, unless a worker
+  is waiting for work and has to be woken. The workers hand posted jobs
+  to the scheduler, or place them on a core, at their next unit boundary.
+
+  @param e a pointer to an instance of the executor_t data structure
+  @param job_number the job
+  @return 0 on success
+  @return -1 if EXECUTOR_RING_SLOTS jobs are already waiting; try again
+ */
+int executor_post(executor_t *e, int job_number)
+{
+	e->jobs[job_number].submit_ns = executor_now(e);
+	if (ring_push(&e->posted, job_number) != 0)
+		return -1;
+
+	// Pairs with the worker counting itself a sleeper before it looks at the ring
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load(&e->sleepers) > 0)
+		executor_wake(e);
+	return 0;
+}
+
+
+/**
+  Waits for every job to be submitted and to finish.
+
+  @param e a pointer to an instance of the executor_t data structure
+  @return 0 once every job has finished
+  @return -1 if all cores were left idle while jobs were still waiting
+ */
+int executor_wait(executor_t *e)
+{
+	int stalled = 0;
+
+	pthread_mutex_lock(&e->lock);
+	while (atomic_load(&e->finished) < e->count) {
+		int idle = 0;
+		for (int i = 0; i < e->cores; i++) {
+			if (e->core[i].job < 0)
+				idle++;
+		}
+
+		// Nothing but an arrival makes the scheduler look at an idle core
+		if (e->mode == EXECUTOR_LOCKED && idle == e->cores && e->submitted == e->count) {
+			stalled = 1;
+			break;
+		}
+		pthread_cond_wait(&e->progress, &e->lock);
+	}
+	if (stalled)
+		e->finish_ns = executor_now(e);
+	pthread_mutex_unlock(&e->lock);
+
+	return stalled ? -1 : 0;
+}
+
+
+static int compare_long_long(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+	return (x > y) - (x < y);
+}
+
+
+/**
+  Percentiles and maximum of count samples in nanoseconds, sorting them,
+  as microseconds.
+ */
+static void executor_percentiles(long long *samples, int count, float *p50, float *p90, float *p99, float *max)
+{
+	*p50 = *p90 = *p99 = *max = 0;
+	if (0 == count)
+		return;
+
+	qsort(samples, count, sizeof(long long), compare_long_long);
+	*p50 = samples[(count - 1) * 50 / 100] / 1000.0f;
+	*p90 = samples[(count - 1) * 90 / 100] / 1000.0f;
+	*p99 = samples[(count - 1) * 99 / 100] / 1000.0f;
+	*max = samples[count - 1] / 1000.0f;
+}
+
+
+/**
+  Summarises the run. Call after executor_wait().
+
+  @param e a pointer to an instance of the executor_t data structure
+  @param stats filled in with the run's statistics
+ */
+void executor_stats(executor_t *e, executor_stats_t *stats)
+{
+	long long *samples;
+	int count = 0, size;
+
+	memset(stats, 0, sizeof(executor_stats_t));
+
+	pthread_mutex_lock(&e->lock);
+	stats->wall_ns = e->finish_ns;
+	stats->time = (e->mode == EXECUTOR_LOCKED) ? e->time : (int)(e->finish_ns / e->unit_ns);
+	stats->finished = atomic_load(&e->finished);
+	stats->scheduler_calls = e->scheduler_calls;
+	stats->scheduler_average = e->scheduler_calls ? (float)e->scheduler_ns / e->scheduler_calls / 1000.0f : 0.0f;
+
+	for (int i = 0; i < e->cores; i++) {
+		stats->pinned += e->core[i].pinned;
+		stats->units += e->core[i].units;
+		stats->dispatches += e->core[i].dispatches;
+		stats->preemptions += e->core[i].preemptions;
+		count += e->core[i].latencies;
+	}
+
+	size = count > e->count ? count : e->count;
+	samples = malloc((size > 0 ? size : 1) * sizeof(long long));
+	count = 0;
+	for (int i = 0; i < e->cores; i++) {
+		memcpy(samples + count, e->core[i].latency, e->core[i].latencies * sizeof(long long));
+		count += e->core[i].latencies;
+	}
+	executor_percentiles(samples, count, &stats->dispatch_p50, &stats->dispatch_p90, &stats->dispatch_p99,
+			&stats->dispatch_max);
+
+	count = 0;
+	for (int i = 0; i < e->count; i++) {
+		if (e->jobs[i].start_ns >= 0)
+			samples[count++] = e->jobs[i].start_ns - e->jobs[i].submit_ns;
+	}
+	executor_percentiles(samples, count, &stats->response_p50, &stats->response_p90, &stats->response_p99,
+			&stats->response_max);
+	pthread_mutex_unlock(&e->lock);
+
+	free(samples);
+}
+
+
+/**
+  @param e a pointer to an instance of the executor_t data structure
+  @param core_id the core
+  @return percentage of the run the core's worker spent running units of work
+ */
+float executor_core_busy(executor_t *e, int core_id)
+{
+	return e->finish_ns ? 100.0f * e->core[core_id].busy_ns / e->finish_ns : 0.0f;
+}
+
+
+/**
+  Stops the worker threads, leaving any job still on a core where it is,
+  and frees the executor's memory. The jobs array belongs to the caller.
+
+  @param e a pointer to an instance of the executor_t data structure
+ */
+void executor_destroy(executor_t *e)
+{
+	atomic_store(&e->closing, 1);
+	for (int i = 0; i < e->cores; i++) {
+		pthread_mutex_t *lock = (e->mode == EXECUTOR_LOCKED) ? &e->lock : &e->core[i].lock;
+
+		pthread_mutex_lock(lock);
+		pthread_cond_signal(&e->core[i].wake);
+		pthread_mutex_unlock(lock);
+	}
+
+	for (int i = 0; i < e->cores; i++) {
+		pthread_join(e->core[i].thread, NULL);
+		pthread_cond_destroy(&e->core[i].wake);
+		pthread_mutex_destroy(&e->core[i].lock);
+		priqueue_destroy(&e->core[i].ready);
+		free(e->core[i].latency);
+	}
+
+	ring_destroy(&e->posted);
+	if (e->mode == EXECUTOR_RELAXED)
+		priqueue_multi_destroy(&e->relaxed);
+	free(e->batch);
+	pthread_mutex_destroy(&e->lock);
+	pthread_cond_destroy(&e->progress);
+	free(e->core);
+}
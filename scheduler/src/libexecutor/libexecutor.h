@@ -0,0 +1,196 @@
+/** @file libexecutor.h
+ */
+
+#ifndef LIBEXECUTOR_H_
+#define LIBEXECUTOR_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../libscheduler/libscheduler.h"
+#include "../libpriqueue/libpriqueue.h"
+#include "../libring/libring.h"
+
+// Shortest time a spin loop is timed for when it is calibrated
+#define EXECUTOR_CALIBRATE_NS 20000000LL
+
+// Jobs executor_post() can have waiting before the workers take them
+#define EXECUTOR_RING_SLOTS 4096
+
+// Heaps per core in EXECUTOR_RELAXED mode's ready queue
+#define EXECUTOR_RELAXATION 2
+
+/**
+  How dispatch decisions are made.
+
+  - EXECUTOR_LOCKED: libscheduler makes every decision, under one lock.
+  - EXECUTOR_SHARDED: each core has a ready queue of its own, ordered the
+    way the scheme orders its queue, and its worker decides alone under
+    the core's lock, stealing from other cores when its own queue is
+    empty. Only FCFS, SJF, PSJF, PRI, PPRI, RR and EDF can be sharded.
+  - EXECUTOR_RELAXED: every worker polls one relaxed ready queue shared by
+    all cores (see priqueue_multi_t), so no worker idles while another
+    core has jobs queued, at the cost of jobs sometimes running a few
+    places out of order. Takes the same schemes as EXECUTOR_SHARDED.
+
+  The sharded and relaxed queues are ordered by libexecutor's own
+  comparators over executor_job_t, not by libscheduler's over its jobs,
+  so a scheme need not pick the same job in every mode. SJF goes by
+  running time and PSJF by time remaining, where libscheduler's SJF and
+  PSJF queues come out in arrival order. PRI and PPRI go by priority
+  and EDF by deadline as in libscheduler. Equal jobs leave in the order
+  they were queued rather than by arrival time.
+*/
+typedef enum {EXECUTOR_LOCKED = 0, EXECUTOR_SHARDED, EXECUTOR_RELAXED} executor_mode_t;
+
+/**
+  Runs one unit of a job's work. unit counts up from 0 over the job's
+  running time; a job only ever runs one unit at a time.
+*/
+typedef void (*executor_work_t)(void *arg, int unit);
+
+/**
+  A job run by the executor. Its job number in the scheduler is its index
+  in the array handed to executor_init().
+*/
+typedef struct _executor_job_t
+{
+  int running_time;       // Units of work
+  int priority;
+  int deadline;           // Absolute time unit, or -1 for none
+  executor_work_t work;   // NULL to spin for one time unit per unit of work
+  void *arg;
+
+  // Filled in by the executor, in nanoseconds since executor_init()
+  int remaining;          // Units of work left
+  int worker;             // Core whose worker is in a unit of the job, or -1
+  long long submit_ns;
+  long long queued_ns;    // When the job last joined a ready queue (sharded)
+  long long start_ns;     // When the job first ran, -1 until then
+  long long finish_ns;
+
+} executor_job_t;
+
+/**
+  One worker thread and what the scheduler has put on its core.
+*/
+typedef struct _executor_core_t
+{
+  struct _executor_t *executor;
+  int id;
+  pthread_t thread;
+  pthread_cond_t wake;    // Signalled when the core is given a job
+  int pinned;             // Whether the thread runs on a CPU of its own
+  atomic_int sleeping;    // Set while the worker waits for work
+  unsigned int seed;      // The worker's draws from the relaxed queue
+
+  int job;                // Job the scheduler has on the core, -1 for none
+  long long assigned_ns;  // When the scheduler put job on the core
+  int running;            // Job the worker last ran a unit of, -1 for none
+  int quantum_left;       // Units until the quantum expires, 0 for no quantum
+
+  // Sharded and relaxed modes only
+  pthread_mutex_t lock;   // Guards ready and current, and wake waits on it
+  priqueue_t ready;
+  atomic_int length;      // Jobs in ready, readable without the lock
+  atomic_int preempt;     // Set when a job is queued while current runs
+  executor_job_t *current;
+
+  long long busy_ns;      // Time spent running units of work
+  long long units;        // Units of work done
+  long long dispatches;
+  long long preemptions;  // Dispatches that took a job off mid-run
+  long long *latency;     // Dispatch latency of every dispatch
+  int latencies;
+  int latency_size;
+
+} executor_core_t;
+
+/**
+  Live executor. Each core of the scheduler is a worker thread pinned to a
+  CPU that runs the units of work of whatever job the scheduler has on
+  its core. Workers only look at their core between units of work, so
+  preemption is cooperative: a job taken off a core finishes the unit it
+  is in first.
+
+  Jobs come in either in batches through executor_submit(), or one at a
+  time from any number of threads through executor_post(), which only
+  pushes the job onto a lock-free ring. Workers take posted jobs off the
+  ring between units of work, one worker at a time.
+*/
+typedef struct _executor_t
+{
+  int mode;
+  int cores;
+  int scheme;
+  int quantum;
+  long long unit_ns;        // Wall-clock length of one time unit
+  long long spin_per_unit;  // Spin loop iterations in one time unit
+
+  executor_job_t *jobs;
+  int count;
+  int submitted;            // Jobs handed to the scheduler (locked)
+  atomic_int finished;
+  int time;                 // Latest time unit handed to the scheduler
+  atomic_int closing;
+
+  ring_t posted;            // Jobs from executor_post() not yet taken
+  atomic_int sleepers;      // Workers waiting for work
+  atomic_int draining;      // Held by the worker taking posted jobs (sharded)
+  scheduler_new_job_t *batch;  // Posted jobs on their way to the scheduler (locked)
+  unsigned int seed;        // Placement draws, made by the draining worker
+  int (*comp)(const void *, const void *);  // Ready queue order (sharded, relaxed)
+  priqueue_multi_t relaxed; // Ready queue of every core (relaxed)
+
+  executor_core_t *core;
+  pthread_mutex_t lock;     // Guards the scheduler (locked) and progress
+  pthread_cond_t progress;  // Signalled when a job finishes or a core goes idle
+  long long start_ns;       // CLOCK_MONOTONIC at executor_init()
+  long long finish_ns;      // When the last job finished
+
+  long long scheduler_calls;
+  long long scheduler_ns;   // Time spent in scheduler calls
+
+} executor_t;
+
+/**
+  What a run came to. Latencies are in microseconds.
+*/
+typedef struct _executor_stats_t
+{
+  long long wall_ns;        // From executor_init() to the last finish
+  int time;                 // Time unit the last job finished in
+  int finished;
+  long long units;
+  long long dispatches;
+  long long preemptions;
+  int pinned;               // Workers pinned to a CPU
+
+  float dispatch_p50;       // Scheduler decision or queueing to the worker running it
+  float dispatch_p90;
+  float dispatch_p99;
+  float dispatch_max;
+  float response_p50;       // Submission to first unit of work
+  float response_p90;
+  float response_p99;
+  float response_max;
+
+  long long scheduler_calls;
+  float scheduler_average; // Per call
+
+} executor_stats_t;
+
+
+long long executor_calibrate(long long unit_ns);
+int       executor_sharded  (int scheme);
+int       executor_init     (executor_t *e, int mode, int cores, int scheme, int quantum, long long unit_ns,
+                             long long spin_per_unit, executor_job_t *jobs, int count);
+long long executor_now      (executor_t *e);
+void      executor_submit   (executor_t *e, const int *job_numbers, int count);
+int       executor_post     (executor_t *e, int job_number);
+int       executor_wait     (executor_t *e);
+void      executor_stats    (executor_t *e, executor_stats_t *stats);
+float     executor_core_busy(executor_t *e, int core_id);
+void      executor_destroy  (executor_t *e);
+
+#endif /* LIBEXECUTOR_H_ */
@@ -3,10 +3,197 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "libpriqueue.h"
 
 
+#ifdef SCHEDULER_METRICS
+priqueue_metrics_t priqueue_metrics;
+#endif
+
+// Batches up to this size are sorted by insertion
+#define INSERTION_SORT_MAX 16
+
+// Element k of a heap backed queue. Its children are arity * k + 1 through
+// arity * k + arity; storing element k arity - 1 entries into a 64-byte
+// aligned allocation starts every group of siblings on a multiple of arity
+// entries, so with PRIQUEUE_CACHE_ARITY a sift down reads one cache line
+// per level.
+#define HEAP_AT(q, k) ((q)->heap[(k) + (q)->arity - 1])
+
+
+static int heap_less(priqueue_t *q, priqueue_entry_t *a, priqueue_entry_t *b)
+{
+	PRIQUEUE_METRIC_ADD(comparisons, 1);
+
+	int order = q->comp(a->ptr, b->ptr);
+	if(0 != order){
+		return order < 0;
+	}
+	return a->seq < b->seq;
+}
+
+
+/**
+  Makes room for count elements, doubling the allocation as needed.
+ */
+static void heap_reserve(priqueue_t *q, int count)
+{
+	if(count <= q->capacity){
+		return;
+	}
+
+	int capacity = (0 == q->capacity) ? 16 : q->capacity;
+	while(capacity < count){
+		capacity *= 2;
+	}
+
+	size_t bytes = sizeof(priqueue_entry_t) * (capacity + q->arity - 1);
+	priqueue_entry_t *heap = aligned_alloc(64, (bytes + 63) / 64 * 64);
+
+	if(0 != q->length){
+		PRIQUEUE_METRIC_ADD(bytes_copied, sizeof(priqueue_entry_t) * q->length);
+		memcpy(&heap[q->arity - 1], &HEAP_AT(q, 0), sizeof(priqueue_entry_t) * q->length);
+	}
+
+	free(q->heap);
+	q->heap = heap;
+	q->capacity = capacity;
+}
+
+
+/**
+  @return the position element k settled in
+ */
+static int heap_sift_up(priqueue_t *q, int k)
+{
+	priqueue_entry_t entry = HEAP_AT(q, k);
+
+	while(k > 0){
+		int parent = (k - 1) / q->arity;
+		if(!heap_less(q, &entry, &HEAP_AT(q, parent))){
+			break;
+		}
+		HEAP_AT(q, k) = HEAP_AT(q, parent);
+		k = parent;
+	}
+
+	HEAP_AT(q, k) = entry;
+	return k;
+}
+
+
+static void heap_sift_down(priqueue_t *q, int k)
+{
+	priqueue_entry_t entry = HEAP_AT(q, k);
+
+	while(1){
+		int first = q->arity * k + 1;
+		if(first >= q->length){
+			break;
+		}
+
+		int end = (first + q->arity < q->length) ? first + q->arity : q->length;
+		int least = first;
+		for(int child = first + 1; child < end; child++){
+			if(heap_less(q, &HEAP_AT(q, child), &HEAP_AT(q, least))){
+				least = child;
+			}
+		}
+
+		if(!heap_less(q, &HEAP_AT(q, least), &entry)){
+			break;
+		}
+		HEAP_AT(q, k) = HEAP_AT(q, least);
+		k = least;
+	}
+
+	HEAP_AT(q, k) = entry;
+}
+
+
+/**
+  Restores the heap order over all elements bottom up, O(n).
+ */
+static void heap_build(priqueue_t *q)
+{
+	if(q->length < 2){
+		return;
+	}
+
+	for(int k = (q->length - 2) / q->arity; k >= 0; k--){
+		heap_sift_down(q, k);
+	}
+}
+
+
+static void *heap_remove_at(priqueue_t *q, int k)
+{
+	void *ptr = HEAP_AT(q, k).ptr;
+
+	q->length--;
+	if(k != q->length){
+		HEAP_AT(q, k) = HEAP_AT(q, q->length);
+		if(k == heap_sift_up(q, k)){
+			heap_sift_down(q, k);
+		}
+	}
+
+	return ptr;
+}
+
+
+/**
+  Sorts count elements with the same tie rule as priqueue_offer (an
+  element goes after everything it does not compare less than): insertion
+  sort for small runs, merged pairwise through scratch above that.
+ */
+static void sort_stable(priqueue_t *q, void **ptrs, void **scratch, int count)
+{
+	if(count <= INSERTION_SORT_MAX){
+		for(int i = 1; i < count; i++){
+			void *ptr = ptrs[i];
+			int pos = i;
+			for(int j = 0; j < i; j++){
+				PRIQUEUE_METRIC_ADD(comparisons, 1);
+				if(q->comp(ptr, ptrs[j]) < 0){
+					pos = j;
+					break;
+				}
+			}
+			memmove(&ptrs[pos+1], &ptrs[pos], sizeof(void *) * (i - pos));
+			ptrs[pos] = ptr;
+		}
+		return;
+	}
+
+	int half = count / 2;
+	sort_stable(q, ptrs, scratch, half);
+	sort_stable(q, ptrs + half, scratch, count - half);
+
+	int next = 0;
+	int a = 0;
+	int b = half;
+
+	while(a < half && b < count){
+		PRIQUEUE_METRIC_ADD(comparisons, 1);
+		if(q->comp(ptrs[b], ptrs[a]) < 0){
+			scratch[next++] = ptrs[b++];
+		} else {
+			scratch[next++] = ptrs[a++];
+		}
+	}
+	while(a < half){
+		scratch[next++] = ptrs[a++];
+	}
+	while(b < count){
+		scratch[next++] = ptrs[b++];
+	}
+
+	memcpy(ptrs, scratch, sizeof(void *) * count);
+}
+
 /**
   Initializes the priqueue_t data structure.
 
@@ -21,6 +208,70 @@ void priqueue_init(priqueue_t *q, int(*comparer)(const void *, const void *))
 {
 	q->comp = comparer;
 	q->length = 0;
+	q->arity = 0;
+	q->capacity = 0;
+	q->heap = NULL;
+	q->next_seq = 0;
+}
+
+
+/**
+  Initializes the priqueue_t data structure as a d-ary heap. Elements come
+  out in the same order as from a sorted queue, but priqueue_at indexes
+  the heap array, which is only ordered from each node to its children.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param arity children per node, at least 2; PRIQUEUE_CACHE_ARITY keeps
+    the children of a node on one cache line
+ */
+void priqueue_init_heap(priqueue_t *q, int(*comparer)(const void *, const void *), int arity)
+{
+	priqueue_init(q, comparer);
+	q->arity = (arity < 2) ? 2 : arity;
+}
+
+
+/**
+  Initializes a queue holding count elements at once. A heap is built
+  bottom up in O(n); a sorted queue is merge sorted, O(n log n) instead of
+  the O(n^2) of offering each element in turn, with the same result.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param arity 0 for a sorted queue, otherwise as for priqueue_init_heap
+  @param ptrs the elements, in arrival order
+  @param count number of elements in ptrs
+ */
+void priqueue_init_from_array(priqueue_t *q, int(*comparer)(const void *, const void *), int arity, void **ptrs, int count)
+{
+	if(arity > 0){
+		priqueue_init_heap(q, comparer, arity);
+	} else {
+		priqueue_init(q, comparer);
+	}
+
+	if(count <= 0){
+		return;
+	}
+
+	if(q->arity > 0){
+		heap_reserve(q, count);
+		for(int k = 0; k < count; k++){
+			HEAP_AT(q, k).ptr = ptrs[k];
+			HEAP_AT(q, k).seq = q->next_seq++;
+		}
+		q->length = count;
+		heap_build(q);
+		return;
+	}
+
+	void **scratch = malloc(sizeof(void *[count]));
+	q->arr = malloc(sizeof(void *[count]));
+	memcpy(q->arr, ptrs, sizeof(void *) * count);
+	sort_stable(q, q->arr, scratch, count);
+	free(scratch);
+	q->length = count;
 }
 
 
@@ -33,9 +284,21 @@ void priqueue_init(priqueue_t *q, int(*comparer)(const void *, const void *))
  */
 int priqueue_offer(priqueue_t *q, void *ptr)
 {
+	PRIQUEUE_METRIC_ADD(offers, 1);
+
+	if(q->arity > 0){
+		heap_reserve(q, q->length + 1);
+		HEAP_AT(q, q->length).ptr = ptr;
+		HEAP_AT(q, q->length).seq = q->next_seq++;
+		q->length++;
+		return heap_sift_up(q, q->length - 1);
+	}
+
 	int newLength = q->length+1;
 	void **tempArr = malloc(sizeof(void *[newLength]));
 
+	PRIQUEUE_METRIC_ADD(bytes_copied, sizeof(void *) * q->length);
+
 	if( 0 == q->length ) {
 		q->length = newLength;
 		tempArr[0] = ptr;
@@ -49,6 +312,7 @@ int priqueue_offer(priqueue_t *q, void *ptr)
 
 	for(int i = 0; i < q->length; i++){
 		if(!done){
+			PRIQUEUE_METRIC_ADD(comparisons, 1);
 			if(q->comp(ptr, q->arr[i]) < 0){
 				tempArr[next] = ptr;
 				ret = next;
@@ -74,6 +338,119 @@ int priqueue_offer(priqueue_t *q, void *ptr)
 }
 
 
+/**
+  Inserts count elements at once, as a queue built by
+  priqueue_init_from_array and melded in.
+
+  The batch is ordered with the same tie rule as priqueue_offer (an element
+  goes after everything it does not compare less than), so the resulting
+  queue matches offering each element in turn, while the existing elements
+  are copied only once instead of once per element.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptrs the elements to insert, in arrival order
+  @param count number of elements in ptrs
+  @return the number of elements in the queue after the insertion
+ */
+int priqueue_offer_all(priqueue_t *q, void **ptrs, int count)
+{
+	if(count <= 0){
+		return q->length;
+	}
+
+	priqueue_t batch;
+
+	PRIQUEUE_METRIC_ADD(offers, count);
+
+	priqueue_init_from_array(&batch, q->comp, q->arity, ptrs, count);
+	priqueue_meld(q, &batch);
+	priqueue_destroy(&batch);
+	return q->length;
+}
+
+
+/**
+  Moves every element of other into q, leaving other empty. Elements of
+  other go after the elements of q they compare equal to, as if offered
+  after them in their order in other.
+
+  Sorted queues are merged in one pass, O(n + m). Heaps append other's
+  elements and either sift each up or, when other is the larger, rebuild
+  bottom up, so the cost is the smaller of O(m log(n + m)) and O(n + m).
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param other a queue with the same comparer and backing as q
+  @return the number of elements in q after the meld
+  @return -1 if q and other are not backed the same way
+ */
+int priqueue_meld(priqueue_t *q, priqueue_t *other)
+{
+	if(q->arity != other->arity){
+		return -1;
+	}
+	if(0 == other->length){
+		return q->length;
+	}
+
+	if(q->arity > 0){
+		int length = q->length;
+
+		heap_reserve(q, length + other->length);
+		PRIQUEUE_METRIC_ADD(bytes_copied, sizeof(priqueue_entry_t) * other->length);
+		for(int k = 0; k < other->length; k++){
+			HEAP_AT(q, length + k).ptr = HEAP_AT(other, k).ptr;
+			HEAP_AT(q, length + k).seq = q->next_seq + HEAP_AT(other, k).seq;
+		}
+		q->next_seq += other->next_seq;
+		q->length += other->length;
+
+		if(other->length > length){
+			heap_build(q);
+		} else {
+			for(int k = length; k < q->length; k++){
+				heap_sift_up(q, k);
+			}
+		}
+
+		other->length = 0;
+		other->next_seq = 0;
+		return q->length;
+	}
+
+	void **tempArr = malloc(sizeof(void *[q->length + other->length]));
+	int next = 0;
+	int a = 0;
+	int b = 0;
+
+	PRIQUEUE_METRIC_ADD(bytes_copied, sizeof(void *) * (q->length + other->length));
+
+	while(a < q->length && b < other->length){
+		PRIQUEUE_METRIC_ADD(comparisons, 1);
+		if(q->comp(other->arr[b], q->arr[a]) < 0){
+			tempArr[next++] = other->arr[b++];
+		} else {
+			tempArr[next++] = q->arr[a++];
+		}
+	}
+	while(a < q->length){
+		tempArr[next++] = q->arr[a++];
+	}
+	while(b < other->length){
+		tempArr[next++] = other->arr[b++];
+	}
+
+	if(0 != q->length){
+		free(q->arr);
+	}
+	free(other->arr);
+	other->length = 0;
+
+	q->length = next;
+	q->arr = tempArr;
+	return q->length;
+}
+
+
 /**
   Retrieves, but does not remove, the head of this queue, returning NULL if
   this queue is empty.
@@ -88,6 +465,9 @@ void *priqueue_peek(priqueue_t *q)
 		return NULL;
 	}
 
+	if(q->arity > 0){
+		return HEAP_AT(q, 0).ptr;
+	}
 	return q->arr[0];
 }
 
@@ -104,9 +484,14 @@ void *priqueue_poll(priqueue_t *q)
 {
 	void *tempPtr;
 
+	PRIQUEUE_METRIC_ADD(polls, 1);
+
 	if (0 == q->length) {
 		return NULL;
 
+	} else if(q->arity > 0){
+		return heap_remove_at(q, 0);
+
 	} else if(1 == q->length){
 		tempPtr = q->arr[0];
 		free(q->arr);
@@ -115,6 +500,7 @@ void *priqueue_poll(priqueue_t *q)
 	}
 
 	void **tempArr = malloc(sizeof(void *[q->length -1]));
+	PRIQUEUE_METRIC_ADD(bytes_copied, sizeof(void *) * (q->length - 1));
 	for(int i = 0; i < q->length -1; i++){
 		tempArr[i] = q->arr[i+1];
 	}
@@ -129,7 +515,8 @@ void *priqueue_poll(priqueue_t *q)
 
 /**
   Returns the element at the specified position in this list, or NULL if
-  the queue does not contain an index'th element.
+  the queue does not contain an index'th element. A heap's positions are
+  in heap order, only the first is the head.
 
   @param q a pointer to an instance of the priqueue_t data structure
   @param index position of retrieved element
@@ -142,10 +529,120 @@ void *priqueue_at(priqueue_t *q, int index)
 		return NULL;
 	}
 
+	if(q->arity > 0){
+		return HEAP_AT(q, index).ptr;
+	}
 	return q->arr[index];
 }
 
 
+/**
+  Returns the tie-breaking sequence number of the element priqueue_at()
+  returns for index, which a heap backed queue needs to be saved and put
+  back by priqueue_restore().
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param index position of retrieved element
+  @return the element's sequence number, 0 for a sorted queue
+  @return 0 if index is out of range
+ */
+unsigned long priqueue_seq_at(priqueue_t *q, int index)
+{
+	if(index >= q->length || q->arity == 0){
+		return 0;
+	}
+	return HEAP_AT(q, index).seq;
+}
+
+
+/**
+  Stores the positions of the count highest priority elements, best first,
+  so that priqueue_at() and priqueue_remove_at() can pick among them. A
+  sorted queue's are its first positions; a heap's are found by a best
+  first walk down from the root, which only ever looks at the children of
+  positions already taken.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param indexes receives up to count positions
+  @param count number of positions wanted
+  @return the number of positions stored
+ */
+int priqueue_first_indexes(priqueue_t *q, int *indexes, int count)
+{
+	if(count > q->length){
+		count = q->length;
+	}
+
+	if(q->arity == 0){
+		for(int i = 0; i < count; i++){
+			indexes[i] = i;
+		}
+		return count;
+	}
+	if(count <= 0){
+		return 0;
+	}
+
+	int *frontier = malloc(sizeof(int) * (count * q->arity + 1));
+	int frontier_size = 1;
+	frontier[0] = 0;
+
+	for(int i = 0; i < count; i++){
+		int best = 0;
+		for(int f = 1; f < frontier_size; f++){
+			if(heap_less(q, &HEAP_AT(q, frontier[f]), &HEAP_AT(q, frontier[best]))){
+				best = f;
+			}
+		}
+
+		int k = frontier[best];
+		indexes[i] = k;
+		frontier[best] = frontier[--frontier_size];
+
+		for(int child = q->arity * k + 1; child <= q->arity * k + q->arity && child < q->length; child++){
+			frontier[frontier_size++] = child;
+		}
+	}
+
+	free(frontier);
+	return count;
+}
+
+
+/**
+  Fills an empty queue with elements exactly where priqueue_at() and
+  priqueue_seq_at() found them in a saved queue, without calling the
+  comparer, so it goes on to order ties as the saved queue would have.
+
+  @param q a pointer to a queue set up with the saved queue's backing
+  @param ptrs the elements, in priqueue_at() order
+  @param seqs their sequence numbers, ignored by a sorted queue
+  @param count number of elements in ptrs
+  @param next_seq the saved queue's next_seq
+ */
+void priqueue_restore(priqueue_t *q, void **ptrs, const unsigned long *seqs, int count, unsigned long next_seq)
+{
+	q->next_seq = next_seq;
+	if(count <= 0){
+		return;
+	}
+
+	if(q->arity > 0){
+		heap_reserve(q, count);
+		for(int k = 0; k < count; k++){
+			HEAP_AT(q, k).ptr = ptrs[k];
+			HEAP_AT(q, k).seq = seqs[k];
+		}
+		q->length = count;
+		return;
+	}
+
+	q->arr = malloc(sizeof(void *[count]));
+	memcpy(q->arr, ptrs, sizeof(void *) * count);
+	q->length = count;
+}
+
+
 /**
   Removes all instances of ptr from the queue.
 
@@ -160,6 +657,20 @@ int priqueue_remove(priqueue_t *q, void *ptr)
 	int ret = 0;
 	int next = 0;
 
+	PRIQUEUE_METRIC_ADD(removes, 1);
+
+	if(q->arity > 0){
+		// Sifting can bring another copy of ptr down into slot k, so check
+		// it again; everything above k has been checked
+		for(int k = q->length - 1; k >= 0; k--){
+			while(k < q->length && HEAP_AT(q, k).ptr == ptr){
+				heap_remove_at(q, k);
+				ret++;
+			}
+		}
+		return ret;
+	}
+
 	for(int i = 0 ; i < q->length; i++){
 		if(q->arr[i] == ptr){
 			q->arr[i] = NULL;
@@ -170,6 +681,7 @@ int priqueue_remove(priqueue_t *q, void *ptr)
 	if(ret > 0){
 		if(q->length - ret != 0){
 			void **tempArr = malloc(sizeof(void *[q->length - ret]));
+			PRIQUEUE_METRIC_ADD(bytes_copied, sizeof(void *) * (q->length - ret));
 
 			for(int i = 0; i < q->length; i++){ 		//Not the most efficient way to do this
 				if(q->arr[i] != NULL){
@@ -204,8 +716,12 @@ void *priqueue_remove_at(priqueue_t *q, int index)
 {
 	void *tempPtr;
 
+	PRIQUEUE_METRIC_ADD(removes, 1);
+
 	if(index >= q->length){
 		return NULL;
+	} else if(q->arity > 0){
+		return heap_remove_at(q, index);
 	} else if(1 == q->length){
 		tempPtr = q->arr[0];
 		free(q->arr);
@@ -216,6 +732,8 @@ void *priqueue_remove_at(priqueue_t *q, int index)
 	void **tempArr = malloc(sizeof(void *[q->length -1]));
 	int next = 0;
 
+	PRIQUEUE_METRIC_ADD(bytes_copied, sizeof(void *) * (q->length - 1));
+
 	for(int i = 0; i < q->length; i++){
 		if(i != index){
 			tempArr[next] = q->arr[i];
@@ -251,7 +769,286 @@ int priqueue_size(priqueue_t *q)
  */
 void priqueue_destroy(priqueue_t *q)
 {
+	if(q->arity > 0){
+		free(q->heap);
+		q->heap = NULL;
+		q->capacity = 0;
+		q->length = 0;
+		return;
+	}
+
 	if(0 != q->length){
 		free(q->arr);
 	}
 }
+
+
+/*
+ * Relaxed queue: threads * factor heaps, each behind a lock of its own.
+ */
+
+static priqueue_shard_t *multi_draw(priqueue_multi_t *m, unsigned int *seed)
+{
+	return &m->shard[rand_r(seed) % m->heaps];
+}
+
+
+/**
+  Whether the head of locked heap a comes before the head of locked heap b,
+  ties going to the one offered first. An empty heap comes last.
+ */
+static int multi_less(priqueue_multi_t *m, priqueue_shard_t *a, priqueue_shard_t *b)
+{
+	if(0 == a->q.length || 0 == b->q.length){
+		return 0 != a->q.length;
+	}
+
+	int order = m->comp(priqueue_peek(&a->q), priqueue_peek(&b->q));
+	if(0 != order){
+		return order < 0;
+	}
+	return priqueue_seq_at(&a->q, 0) < priqueue_seq_at(&b->q, 0);
+}
+
+
+/**
+  Locks a random heap. A heap found locked is passed over for another
+  draw, PRIQUEUE_MULTI_DRAWS times, before waiting for the last one drawn.
+ */
+static priqueue_shard_t *multi_lock_any(priqueue_multi_t *m, unsigned int *seed)
+{
+	for(int i = 1; ; i++){
+		priqueue_shard_t *s = multi_draw(m, seed);
+
+		if(0 == pthread_mutex_trylock(&s->lock)){
+			return s;
+		}
+		if(PRIQUEUE_MULTI_DRAWS == i){
+			pthread_mutex_lock(&s->lock);
+			return s;
+		}
+	}
+}
+
+
+/**
+  Locks the first heap that is not empty, starting from a random one.
+
+  @return the heap, or NULL if every heap was empty
+ */
+static priqueue_shard_t *multi_lock_scan(priqueue_multi_t *m, unsigned int *seed)
+{
+	int start = rand_r(seed) % m->heaps;
+
+	for(int i = 0; i < m->heaps; i++){
+		priqueue_shard_t *s = &m->shard[(start + i) % m->heaps];
+
+		if(0 == atomic_load(&s->length)){
+			continue;
+		}
+		pthread_mutex_lock(&s->lock);
+		if(0 != s->q.length){
+			return s;
+		}
+		pthread_mutex_unlock(&s->lock);
+	}
+	return NULL;
+}
+
+
+/**
+  Draws two different heaps and locks the one whose head comes first. Empty heaps
+  and locked ones are drawn again, PRIQUEUE_MULTI_DRAWS times, before
+  every heap is looked through in turn.
+
+  @return the heap, not empty, or NULL if every heap was empty
+ */
+static priqueue_shard_t *multi_lock_best(priqueue_multi_t *m, unsigned int *seed)
+{
+	for(int i = 1; i <= PRIQUEUE_MULTI_DRAWS; i++){
+		int first = rand_r(seed) % m->heaps;
+		priqueue_shard_t *a = &m->shard[first];
+		priqueue_shard_t *b = &m->shard[(m->heaps > 1) ? (first + 1 + rand_r(seed) % (m->heaps - 1)) % m->heaps : first];
+
+		if(0 == atomic_load(&a->length)){
+			a = b;
+		}
+		if(0 == atomic_load(&a->length) || 0 != pthread_mutex_trylock(&a->lock)){
+			continue;
+		}
+
+		// b is only looked at if it can be had without waiting
+		if(b != a && 0 != atomic_load(&b->length) && 0 == pthread_mutex_trylock(&b->lock)){
+			if(multi_less(m, b, a)){
+				pthread_mutex_unlock(&a->lock);
+				a = b;
+			} else {
+				pthread_mutex_unlock(&b->lock);
+			}
+		}
+
+		if(0 != a->q.length){
+			return a;
+		}
+		pthread_mutex_unlock(&a->lock);
+	}
+
+	return multi_lock_scan(m, seed);
+}
+
+
+/**
+  Adds ptr to locked heap s.
+ */
+static void multi_push(priqueue_multi_t *m, priqueue_shard_t *s, void *ptr)
+{
+	s->q.next_seq = atomic_fetch_add(&m->next_seq, 1);
+	priqueue_offer(&s->q, ptr);
+	atomic_store(&s->length, s->q.length);
+}
+
+
+/**
+  Takes the head off locked heap s.
+ */
+static void *multi_pop(priqueue_shard_t *s)
+{
+	void *ptr = priqueue_poll(&s->q);
+
+	atomic_store(&s->length, s->q.length);
+	return ptr;
+}
+
+
+/**
+  Initializes a relaxed queue for threads threads to share.
+
+  @param m a pointer to an instance of the priqueue_multi_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param threads threads that will use the queue at once
+  @param factor heaps per thread, at least 1. More heaps mean less
+    contention but polls further from the true head; 2 to 4 is usual.
+ */
+void priqueue_multi_init(priqueue_multi_t *m, int(*comparer)(const void *, const void *), int threads, int factor)
+{
+	m->comp = comparer;
+	m->heaps = ((threads < 1) ? 1 : threads) * ((factor < 1) ? 1 : factor);
+	m->shard = aligned_alloc(64, sizeof(priqueue_shard_t) * m->heaps);
+	atomic_init(&m->length, 0);
+	atomic_init(&m->next_seq, 0);
+
+	for(int i = 0; i < m->heaps; i++){
+		pthread_mutex_init(&m->shard[i].lock, NULL);
+		priqueue_init_heap(&m->shard[i].q, comparer, PRIQUEUE_CACHE_ARITY);
+		atomic_init(&m->shard[i].length, 0);
+	}
+}
+
+
+/**
+  Adds ptr to a random heap. Safe to call from any number of threads.
+
+  @param m a pointer to an instance of the priqueue_multi_t data structure
+  @param ptr a pointer to the data to be inserted
+  @param seed the calling thread's rand_r() state
+ */
+void priqueue_multi_offer(priqueue_multi_t *m, void *ptr, unsigned int *seed)
+{
+	priqueue_shard_t *s = multi_lock_any(m, seed);
+
+	multi_push(m, s, ptr);
+	atomic_fetch_add(&m->length, 1);
+	pthread_mutex_unlock(&s->lock);
+}
+
+
+/**
+  Removes the better of the heads of two random heaps. Safe to call from
+  any number of threads.
+
+  @param m a pointer to an instance of the priqueue_multi_t data structure
+  @param seed the calling thread's rand_r() state
+  @return the element removed
+  @return NULL if the queue is empty, or only holds elements still being
+    offered or polled by other threads
+ */
+void *priqueue_multi_poll(priqueue_multi_t *m, unsigned int *seed)
+{
+	if(0 == atomic_load(&m->length)){
+		return NULL;
+	}
+
+	priqueue_shard_t *s = multi_lock_best(m, seed);
+	if(NULL == s){
+		return NULL;
+	}
+
+	void *ptr = multi_pop(s);
+	atomic_fetch_sub(&m->length, 1);
+	pthread_mutex_unlock(&s->lock);
+	return ptr;
+}
+
+
+/**
+  Looks at the better of the heads of two random heaps, and if it comes
+  before ptr, removes it and adds ptr in its place. This is how a thread
+  holding an element checks, in one step, whether the queue has anything
+  better for it.
+
+  @param m a pointer to an instance of the priqueue_multi_t data structure
+  @param ptr the element the caller holds
+  @param seed the calling thread's rand_r() state
+  @return the head removed, now that ptr is in the queue
+  @return ptr if no head drawn came before it, and it was not added
+ */
+void *priqueue_multi_swap(priqueue_multi_t *m, void *ptr, unsigned int *seed)
+{
+	if(0 == atomic_load(&m->length)){
+		return ptr;
+	}
+
+	priqueue_shard_t *s = multi_lock_best(m, seed);
+	if(NULL == s){
+		return ptr;
+	}
+
+	void *head = ptr;
+	if(m->comp(priqueue_peek(&s->q), ptr) < 0){
+		head = multi_pop(s);
+		multi_push(m, s, ptr);
+	}
+	pthread_mutex_unlock(&s->lock);
+	return head;
+}
+
+
+/**
+  Returns the number of elements in the queue. Exact only while no other
+  thread is offering or polling.
+
+  @param m a pointer to an instance of the priqueue_multi_t data structure
+  @return the number of elements in the queue
+ */
+int priqueue_multi_size(priqueue_multi_t *m)
+{
+	return atomic_load(&m->length);
+}
+
+
+/**
+  Destroys and frees all the memory associated with m. No other thread may
+  be using it.
+
+  @param m a pointer to an instance of the priqueue_multi_t data structure
+ */
+void priqueue_multi_destroy(priqueue_multi_t *m)
+{
+	for(int i = 0; i < m->heaps; i++){
+		pthread_mutex_destroy(&m->shard[i].lock);
+		priqueue_destroy(&m->shard[i].q);
+	}
+	free(m->shard);
+	m->shard = NULL;
+	m->heaps = 0;
+}
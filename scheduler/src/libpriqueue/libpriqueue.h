@@ -4,11 +4,36 @@
 #ifndef LIBPRIQUEUE_H_
 #define LIBPRIQUEUE_H_
 
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Heap arity whose children fill one 64-byte cache line
+#define PRIQUEUE_CACHE_ARITY 4
+
+// Heaps a relaxed queue draws before it waits on a locked heap, or looks
+// through every heap for one that is not empty
+#define PRIQUEUE_MULTI_DRAWS 4
+
+/**
+  Element of a heap backed queue. seq breaks ties between elements that
+  compare equal, first offered first out, as in a sorted queue.
+*/
+typedef struct _priqueue_entry_t
+{
+  void *ptr;
+  unsigned long seq;
+
+} priqueue_entry_t;
+
 /**
   Priqueue Data Structure
 
   In retrospect, backing this with an array makes removing pieces from the middle
   of it quite difficult/resource expensive in c.
+
+  Queues set up by priqueue_init_heap are instead a d-ary heap: offer, poll
+  and remove are O(log n), but priqueue_at visits the elements in heap
+  order rather than priority order.
 */
 typedef struct _priqueue_t
 {
@@ -16,19 +41,92 @@ typedef struct _priqueue_t
   int length;
   void **arr;
 
+  int arity;               // Children per heap node, 0 for a sorted array
+  int capacity;            // Entries allocated in heap
+  priqueue_entry_t *heap;  // Element k is heap[k + arity - 1], see libpriqueue.c
+  unsigned long next_seq;
+
 } priqueue_t;
 
+/**
+  One heap of a relaxed queue, on cache lines of its own so that threads
+  working different heaps do not contend for a line.
+*/
+typedef struct _priqueue_shard_t
+{
+  _Alignas(64) pthread_mutex_t lock;
+  priqueue_t q;
+  atomic_int length;  // q's length, readable without the lock
+
+} priqueue_shard_t;
+
+/**
+  Relaxed concurrent priority queue (a MultiQueue). Elements are spread
+  over factor heaps per thread, each behind a lock of its own: an offer
+  goes to a random heap, and a poll takes the better of the heads of two
+  random heaps. A thread that draws a locked heap draws again rather than
+  wait, so threads seldom contend, but a poll may return an element a few
+  places behind the true head; the more heaps per thread, the further.
+  Elements that compare equal come out roughly first offered first out.
+*/
+typedef struct _priqueue_multi_t
+{
+  int (*comp)(const void *, const void *);
+  int heaps;
+  priqueue_shard_t *shard;
+  atomic_int length;           // Elements in every heap
+  atomic_ulong next_seq;       // Shared by the heaps, so ties order across them
+
+} priqueue_multi_t;
+
+
+#ifdef SCHEDULER_METRICS
+/**
+  Operation counters shared by every priqueue_t instance. Only compiled in
+  when the build defines SCHEDULER_METRICS (make METRICS=1).
+*/
+typedef struct _priqueue_metrics_t
+{
+  unsigned long long comparisons;   // Calls made to a queue's comparer
+  unsigned long long offers;        // priqueue_offer calls
+  unsigned long long polls;         // priqueue_poll calls
+  unsigned long long removes;       // priqueue_remove and priqueue_remove_at calls
+  unsigned long long bytes_copied;  // Bytes moved between backing arrays
+
+} priqueue_metrics_t;
+
+extern priqueue_metrics_t priqueue_metrics;
+
+#define PRIQUEUE_METRIC_ADD(field, n) (priqueue_metrics.field += (n))
+#else
+#define PRIQUEUE_METRIC_ADD(field, n) ((void)0)
+#endif
+
 
 void   priqueue_init     (priqueue_t *q, int(*comparer)(const void *, const void *));
+void   priqueue_init_heap(priqueue_t *q, int(*comparer)(const void *, const void *), int arity);
+void   priqueue_init_from_array(priqueue_t *q, int(*comparer)(const void *, const void *), int arity, void **ptrs, int count);
 
 int    priqueue_offer    (priqueue_t *q, void *ptr);
+int    priqueue_offer_all(priqueue_t *q, void **ptrs, int count);
+int    priqueue_meld     (priqueue_t *q, priqueue_t *other);
 void * priqueue_peek     (priqueue_t *q);
 void * priqueue_poll     (priqueue_t *q);
 void * priqueue_at       (priqueue_t *q, int index);
+unsigned long priqueue_seq_at(priqueue_t *q, int index);
+int    priqueue_first_indexes(priqueue_t *q, int *indexes, int count);
+void   priqueue_restore  (priqueue_t *q, void **ptrs, const unsigned long *seqs, int count, unsigned long next_seq);
 int    priqueue_remove   (priqueue_t *q, void *ptr);
 void * priqueue_remove_at(priqueue_t *q, int index);
 int    priqueue_size     (priqueue_t *q);
 
 void   priqueue_destroy  (priqueue_t *q);
 
+void   priqueue_multi_init   (priqueue_multi_t *m, int(*comparer)(const void *, const void *), int threads, int factor);
+void   priqueue_multi_offer  (priqueue_multi_t *m, void *ptr, unsigned int *seed);
+void * priqueue_multi_poll   (priqueue_multi_t *m, unsigned int *seed);
+void * priqueue_multi_swap   (priqueue_multi_t *m, void *ptr, unsigned int *seed);
+int    priqueue_multi_size   (priqueue_multi_t *m);
+void   priqueue_multi_destroy(priqueue_multi_t *m);
+
 #endif /* LIBPQUEUE_H_ */
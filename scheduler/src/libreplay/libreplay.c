@@ -0,0 +1,296 @@
+/** @file libreplay.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libreplay.h"
+#include "../libscheduler/libscheduler.h"
+
+// stdio buffer used while recording
+#define REPLAY_WRITE_BUFFER (1 << 20)
+
+
+/**
+  Creates a decision log at path.
+
+  @param w a pointer to an instance of the replay_writer_t data structure
+  @param path file to create
+  @return 0 on success
+  @return -1 if the file could not be created
+ */
+int replay_writer_init(replay_writer_t *w, const char *path)
+{
+	w->count = 0;
+	w->file = fopen(path, "wb");
+	if (NULL == w->file) {
+		return -1;
+	}
+
+	setvbuf(w->file, NULL, _IOFBF, REPLAY_WRITE_BUFFER);
+
+	uint32_t header[2] = {REPLAY_MAGIC, REPLAY_VERSION};
+	fwrite(header, sizeof(header), 1, w->file);
+	return 0;
+}
+
+
+/**
+  Appends one API call to the log. Unused arguments should be 0.
+
+  @param w a pointer to an initialized replay_writer_t
+  @param call a replay_call_t value
+  @param a0 first argument of the call
+  @param a1 second argument of the call
+  @param a2 third argument of the call
+  @param a3 fourth argument of the call
+  @param a4 fifth argument of the call
+  @param result value the call returned
+ */
+void replay_record(replay_writer_t *w, int call, int a0, int a1, int a2, int a3, int a4, int result)
+{
+	replay_record_t rec = {call, {a0, a1, a2, a3, a4}, result};
+	fwrite(&rec, sizeof(replay_record_t), 1, w->file);
+	w->count++;
+}
+
+
+/**
+  Appends a call returning a float (the scheduler_average_* functions).
+
+  @param w a pointer to an initialized replay_writer_t
+  @param call a replay_call_t value
+  @param result value the call returned
+ */
+void replay_record_float(replay_writer_t *w, int call, float result)
+{
+	int32_t bits;
+	memcpy(&bits, &result, sizeof(bits));
+	replay_record(w, call, 0, 0, 0, 0, 0, bits);
+}
+
+
+/**
+  Flushes and closes the log.
+
+  @param w a pointer to an initialized replay_writer_t
+  @return 0 on success
+  @return -1 if the log could not be written completely
+ */
+int replay_writer_close(replay_writer_t *w)
+{
+	int error = ferror(w->file);
+	if (0 != fclose(w->file)) {
+		error = 1;
+	}
+	return error ? -1 : 0;
+}
+
+
+/**
+  Reads a whole decision log into memory with a single read.
+
+  @param log a pointer to an instance of the replay_log_t data structure
+  @param path log to read
+  @return 0 on success
+  @return -1 if the file cannot be read, is not a decision log or ends
+  part way through a record
+ */
+int replay_log_load(replay_log_t *log, const char *path)
+{
+	uint32_t header[2];
+	long size;
+
+	log->records = NULL;
+	log->count = 0;
+
+	FILE *file = fopen(path, "rb");
+	if (NULL == file) {
+		return -1;
+	}
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file) - (long)sizeof(header);
+	fseek(file, 0, SEEK_SET);
+
+	if (size < 0 || size % sizeof(replay_record_t) != 0 || fread(header, sizeof(header), 1, file) != 1
+		|| REPLAY_MAGIC != header[0] || REPLAY_VERSION != header[1]) {
+		fclose(file);
+		return -1;
+	}
+
+	log->count = size / sizeof(replay_record_t);
+	log->records = malloc(log->count * sizeof(replay_record_t) + 1);
+
+	if ((long)fread(log->records, sizeof(replay_record_t), log->count, file) != log->count) {
+		fclose(file);
+		replay_log_destroy(log);
+		return -1;
+	}
+
+	fclose(file);
+	return 0;
+}
+
+
+/**
+  Feeds every recorded call back through libscheduler and compares the
+  results. The log must start with a REPLAY_START_UP record; the scheduler
+  is cleaned up before returning.
+
+  @param log a pointer to a loaded replay_log_t
+  @param actual filled with the call as replayed when a difference is found
+  @return index of the first record whose result differs, or of a
+  REPLAY_NEW_JOBS record the log ends before all of its batch
+  @return -1 if every result matched
+ */
+long replay_verify(replay_log_t *log, replay_record_t *actual)
+{
+	long i;
+	int started = 0, truncated = 0;
+	float f;
+	scheduler_new_job_t *batch = NULL;
+	int batch_size = 0;
+	int mlfq_quanta[MLFQ_MAX_LEVELS];
+	int *topology_llc = NULL;
+	int *topology_node = NULL;
+	int *speeds = NULL;
+
+	for (i = 0; i < log->count; i++) {
+		replay_record_t *rec = &log->records[i];
+		*actual = *rec;
+
+		switch (rec->call) {
+			case REPLAY_START_UP:
+				if (started) {
+					scheduler_clean_up();
+				}
+				scheduler_start_up(rec->args[0], rec->args[1]);
+				started = 1;
+				break;
+			case REPLAY_CONFIGURE_MLFQ:
+				if (rec->args[0] >= 0 && rec->args[0] < MLFQ_MAX_LEVELS) {
+					mlfq_quanta[rec->args[0]] = rec->args[1];
+				}
+				if (rec->args[0] == rec->args[2] - 1) {
+					scheduler_configure_mlfq(rec->args[2], mlfq_quanta, rec->args[3]);
+				}
+				break;
+			case REPLAY_CONFIGURE_WS:
+				scheduler_configure_ws(rec->args[0], rec->args[1]);
+				break;
+			case REPLAY_CONFIGURE_SHARE:
+				scheduler_configure_share(rec->args[0], rec->args[1]);
+				break;
+			case REPLAY_CONFIGURE_AGING:
+				scheduler_configure_aging(rec->args[0]);
+				break;
+			case REPLAY_CONFIGURE_AFFINITY:
+				scheduler_configure_affinity(rec->args[0]);
+				break;
+			case REPLAY_CONFIGURE_TOPOLOGY:
+				if (rec->args[0] == 0) {
+					topology_llc = realloc(topology_llc, rec->args[3] * sizeof(int) + 1);
+					topology_node = realloc(topology_node, rec->args[3] * sizeof(int) + 1);
+				}
+				if (topology_llc != NULL && rec->args[0] >= 0 && rec->args[0] < rec->args[3]) {
+					topology_llc[rec->args[0]] = rec->args[1];
+					topology_node[rec->args[0]] = rec->args[2];
+				}
+				if (topology_llc != NULL && rec->args[0] == rec->args[3] - 1) {
+					scheduler_configure_topology(rec->args[3], topology_llc, topology_node);
+				}
+				break;
+			case REPLAY_CONFIGURE_SPEEDS:
+				if (rec->args[0] == 0) {
+					speeds = realloc(speeds, rec->args[2] * sizeof(int) + 1);
+				}
+				if (speeds != NULL && rec->args[0] >= 0 && rec->args[0] < rec->args[2]) {
+					speeds[rec->args[0]] = rec->args[1];
+				}
+				if (speeds != NULL && rec->args[0] == rec->args[2] - 1) {
+					scheduler_configure_speeds(rec->args[2], speeds);
+				}
+				break;
+			case REPLAY_NEW_JOB:
+				actual->result = scheduler_new_job(rec->args[0], rec->args[1], rec->args[2], rec->args[3]);
+				break;
+			case REPLAY_JOB_FINISHED:
+				actual->result = scheduler_job_finished(rec->args[0], rec->args[1], rec->args[2]);
+				break;
+			case REPLAY_NEW_JOBS:
+				if (rec->args[0] < 0 || i + rec->args[0] >= log->count) {
+					truncated = 1;
+					break;
+				}
+				if (rec->args[0] > batch_size || NULL == batch) {
+					batch_size = rec->args[0];
+					batch = realloc(batch, batch_size * sizeof(scheduler_new_job_t) + 1);
+				}
+				for (int k = 0; k < rec->args[0]; k++) {
+					batch[k].job_number = rec[1 + k].args[0];
+					batch[k].cores = rec[1 + k].args[1];
+					batch[k].running_time = rec[1 + k].args[2];
+					batch[k].priority = rec[1 + k].args[3];
+					batch[k].deadline = rec[1 + k].args[4];
+				}
+				actual->result = scheduler_new_jobs(batch, rec->args[0], rec->args[1]);
+				if (actual->result != rec->result) {
+					break;
+				}
+				for (int k = 0; k < rec->args[0]; k++) {
+					i++;
+					*actual = log->records[i];
+					actual->result = batch[k].core_id;
+					if (actual->result != log->records[i].result) {
+						break;
+					}
+				}
+				rec = &log->records[i];
+				break;
+			case REPLAY_QUANTUM_EXPIRED:
+				actual->result = scheduler_quantum_expired(rec->args[0], rec->args[1]);
+				break;
+			case REPLAY_AVERAGE_WAITING:
+				f = scheduler_average_waiting_time();
+				memcpy(&actual->result, &f, sizeof(f));
+				break;
+			case REPLAY_AVERAGE_TURNAROUND:
+				f = scheduler_average_turnaround_time();
+				memcpy(&actual->result, &f, sizeof(f));
+				break;
+			case REPLAY_AVERAGE_RESPONSE:
+				f = scheduler_average_response_time();
+				memcpy(&actual->result, &f, sizeof(f));
+				break;
+		}
+
+		if (truncated || actual->result != rec->result) {
+			break;
+		}
+	}
+
+	if (started) {
+		scheduler_clean_up();
+	}
+	free(batch);
+	free(topology_llc);
+	free(topology_node);
+	free(speeds);
+
+	return i == log->count ? -1 : i;
+}
+
+
+/**
+  Frees the memory held by a loaded log.
+
+  @param log a pointer to a loaded replay_log_t
+ */
+void replay_log_destroy(replay_log_t *log)
+{
+	free(log->records);
+	log->records = NULL;
+	log->count = 0;
+}
@@ -0,0 +1,79 @@
+/** @file libreplay.h
+ */
+
+#ifndef LIBREPLAY_H_
+#define LIBREPLAY_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define REPLAY_MAGIC 0x50524353 // "SCRP"
+#define REPLAY_VERSION 3
+
+/**
+  Scheduler API calls captured in a decision log.
+*/
+typedef enum {REPLAY_START_UP = 0, REPLAY_NEW_JOB, REPLAY_JOB_FINISHED, REPLAY_QUANTUM_EXPIRED,
+	REPLAY_AVERAGE_WAITING, REPLAY_AVERAGE_TURNAROUND, REPLAY_AVERAGE_RESPONSE, REPLAY_NEW_JOBS,
+	REPLAY_CONFIGURE_MLFQ, REPLAY_CONFIGURE_WS, REPLAY_CONFIGURE_SHARE,
+	REPLAY_CONFIGURE_AGING, REPLAY_CONFIGURE_AFFINITY,
+	REPLAY_CONFIGURE_TOPOLOGY, REPLAY_CONFIGURE_SPEEDS} replay_call_t;
+
+/**
+  One scheduler API call with its arguments and return value, in the order
+  the arguments appear in libscheduler.h. Float results are stored bit for
+  bit in result.
+
+  A REPLAY_NEW_JOBS record holds the batch size and time in args[0] and
+  args[1] and is followed by one REPLAY_NEW_JOB record per batch entry,
+  whose result is the core_id the batch call filled in. Those records hold
+  the job's cores in args[1], where a lone scheduler_new_job holds the
+  time, and its deadline in args[4].
+
+  scheduler_configure_mlfq is stored as one REPLAY_CONFIGURE_MLFQ record
+  per level holding the level, its quantum, the number of levels and the
+  boost period. scheduler_configure_topology is stored the same way, one
+  REPLAY_CONFIGURE_TOPOLOGY record per core holding the core, its cache
+  domain, its node and the number of cores, and scheduler_configure_speeds
+  as one REPLAY_CONFIGURE_SPEEDS record per core holding the core, its
+  speed and the number of cores.
+*/
+typedef struct _replay_record_t
+{
+  int32_t call;
+  int32_t args[5];
+  int32_t result;
+
+} replay_record_t;
+
+/**
+  Decision log writer.
+*/
+typedef struct _replay_writer_t
+{
+  FILE *file;
+  long count;
+
+} replay_writer_t;
+
+/**
+  Decision log loaded into memory in one read.
+*/
+typedef struct _replay_log_t
+{
+  replay_record_t *records;
+  long count;
+
+} replay_log_t;
+
+
+int   replay_writer_init (replay_writer_t *w, const char *path);
+void  replay_record      (replay_writer_t *w, int call, int a0, int a1, int a2, int a3, int a4, int result);
+void  replay_record_float(replay_writer_t *w, int call, float result);
+int   replay_writer_close(replay_writer_t *w);
+
+int   replay_log_load    (replay_log_t *log, const char *path);
+long  replay_verify      (replay_log_t *log, replay_record_t *actual);
+void  replay_log_destroy (replay_log_t *log);
+
+#endif /* LIBREPLAY_H_ */
@@ -0,0 +1,111 @@
+/** @file libring.c
+ */
+
+#include <stdlib.h>
+
+#include "libring.h"
+
+
+/**
+  Sets up an empty ring.
+
+  @param r a pointer to an instance of the ring_t data structure
+  @param capacity values the ring holds at least, rounded up to a power of two
+ */
+void ring_init(ring_t *r, int capacity)
+{
+	unsigned long slots = 2;
+
+	while (slots < (unsigned long)capacity)
+		slots *= 2;
+
+	r->slots = malloc(slots * sizeof(ring_slot_t));
+	r->mask = slots - 1;
+	for (unsigned long i = 0; i < slots; i++)
+		atomic_init(&r->slots[i].seq, i);
+	atomic_init(&r->tail, 0);
+	atomic_init(&r->head, 0);
+}
+
+
+/**
+  Appends value. Safe to call from any number of threads at once.
+
+  @param r a pointer to an instance of the ring_t data structure
+  @param value the value
+  @return 0 on success
+  @return -1 if the ring is full
+ */
+int ring_push(ring_t *r, int value)
+{
+	unsigned long pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+	while (1) {
+		ring_slot_t *slot = &r->slots[pos & r->mask];
+		unsigned long seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		long diff = (long)(seq - pos);
+
+		if (0 == diff) {
+			// pos is refreshed with the current tail if another producer got there first
+			if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + 1, memory_order_relaxed,
+					memory_order_relaxed)) {
+				slot->value = value;
+				atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+				return 0;
+			}
+		} else if (diff < 0) {
+			// The consumer has not read the value a lap ago yet
+			return -1;
+		} else {
+			pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+		}
+	}
+}
+
+
+/**
+  Takes the oldest value out. Only one thread may pop at a time.
+
+  @param r a pointer to an instance of the ring_t data structure
+  @param value set to the value
+  @return 0 on success
+  @return -1 if the ring is empty, or the oldest push has claimed its slot
+    but not filled it in yet
+ */
+int ring_pop(ring_t *r, int *value)
+{
+	unsigned long pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+	ring_slot_t *slot = &r->slots[pos & r->mask];
+
+	if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+		return -1;
+
+	*value = slot->value;
+	atomic_store_explicit(&slot->seq, pos + r->mask + 1, memory_order_release);
+	atomic_store_explicit(&r->head, pos + 1, memory_order_release);
+	return 0;
+}
+
+
+/**
+  Whether the ring holds no values. Any thread may ask; a value pushed
+  concurrently may or may not be seen.
+
+  @param r a pointer to an instance of the ring_t data structure
+  @return nonzero if the ring is empty
+ */
+int ring_empty(ring_t *r)
+{
+	return atomic_load(&r->head) == atomic_load(&r->tail);
+}
+
+
+/**
+  Frees the ring's slots.
+
+  @param r a pointer to an instance of the ring_t data structure
+ */
+void ring_destroy(ring_t *r)
+{
+	free(r->slots);
+}
@@ -0,0 +1,45 @@
+/** @file libring.h
+ */
+
+#ifndef LIBRING_H_
+#define LIBRING_H_
+
+#include <stdatomic.h>
+
+/**
+  One slot of the ring. seq tells producers and the consumer whose turn
+  the slot is: it equals the position a producer may claim it for, and
+  that position + 1 once the value is in.
+*/
+typedef struct _ring_slot_t
+{
+  atomic_ulong seq;
+  int value;
+
+} ring_slot_t;
+
+/**
+  Bounded lock-free multi-producer, single-consumer queue of ints. Any
+  number of threads may push at once; only one thread at a time may pop.
+  Producers claim a position with one compare-and-swap on tail and never
+  wait on each other or on the consumer.
+*/
+typedef struct _ring_t
+{
+  ring_slot_t *slots;
+  unsigned long mask;   // Slots - 1, slots being a power of two
+
+  // Kept on separate cache lines, since producers and the consumer write them
+  _Alignas(64) atomic_ulong tail;  // Next position a producer claims
+  _Alignas(64) atomic_ulong head;  // Next position the consumer reads
+
+} ring_t;
+
+
+void ring_init   (ring_t *r, int capacity);
+int  ring_push   (ring_t *r, int value);
+int  ring_pop    (ring_t *r, int *value);
+int  ring_empty  (ring_t *r);
+void ring_destroy(ring_t *r);
+
+#endif /* LIBRING_H_ */
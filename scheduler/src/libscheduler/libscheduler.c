@@ -19,6 +19,33 @@ scheme_t current_scheme;
 int num_cores;
 int *available_cores;
 
+// Idle cores, kept in step with available_cores by core_assign() and
+// core_release(). Level 0 has bit i % 64 of word i / 64 set while core i
+// is idle; each level above has bit w set while word w below it is
+// non-zero, up to a single top word.
+#define IDLE_MAX_LEVELS 4
+unsigned long long *idle_bits[IDLE_MAX_LEVELS];
+int idle_words[IDLE_MAX_LEVELS];
+int idle_levels;
+int idle_count;
+
+// Hot-path counters, only present in SCHEDULER_METRICS builds
+#ifdef SCHEDULER_METRICS
+scheduler_metrics_t metrics;
+
+#define METRIC_ADD(field, n) (metrics.field += (n))
+#define METRIC_CALL_BEGIN() unsigned long long metric_call_start = scheduler_metrics_cycles()
+#define METRIC_CALL_END(call) \
+	do { \
+		metrics.call.calls++; \
+		metrics.call.cycles += scheduler_metrics_cycles() - metric_call_start; \
+	} while (0)
+#else
+#define METRIC_ADD(field, n) ((void)0)
+#define METRIC_CALL_BEGIN() ((void)0)
+#define METRIC_CALL_END(call) ((void)0)
+#endif
+
 /**
   Stores information making up a job to be scheduled including any statistics.
 
@@ -39,7 +66,110 @@ typedef struct _job_t
 
 	int finished;			// If the job has finished
 
+	int level;				// MLFQ level, valid while mlfq_epoch matches
+	int mlfq_epoch;		// Boost epoch the level was set in
+	struct _job_t *next;	// Next job in the same MLFQ level
+
+	int home_core;		// WS run queue the job was placed on
+	int deadline;			// Absolute deadline, -1 if none
+	int weight;				// STRIDE and LOTTERY share weight
+	long long pass;		// STRIDE pass value
+	int share_slot;		// LOTTERY slot, see lottery_slot_jobs
+	int aged_key;			// Aging key, see aging_key()
+	int last_core;		// Core the job last ran on, -1 if it has not run
+	int width;				// Cores the job needs at once (GANG)
+	int *gang_cores;	// Cores the job holds while running (GANG)
+	int expected_end;	// When the job will finish once started (GANG)
+
 } job_t;
+
+/**
+  One MLFQ level, a FIFO threaded through job_t.next.
+*/
+typedef struct _mlfq_level_t
+{
+	job_t *head;
+	job_t *tail;
+
+} mlfq_level_t;
+
+// MLFQ configuration, set by scheduler_configure_mlfq()
+int mlfq_levels = 3;
+int mlfq_quanta[MLFQ_MAX_LEVELS] = {2, 4, 8};
+int mlfq_boost_period = 100;
+
+// MLFQ state
+mlfq_level_t mlfq_ready[MLFQ_MAX_LEVELS];
+job_t **core_jobs;			// Job running on each core
+int mlfq_epoch;					// Incremented by every priority boost
+int mlfq_next_boost;
+
+// WS configuration, set by scheduler_configure_ws()
+placement_t ws_placement = PLACE_ROUND_ROBIN;
+
+// STRIDE and LOTTERY configuration, set by scheduler_configure_share()
+int share_quantum = 1;
+
+// Seed for the randomized policies (p2c placement, LOTTERY)
+unsigned int random_seed = 1;
+unsigned int random_state;
+
+// Jobs waiting for a core under schemes that keep running jobs out of
+// the ready queue (EDF, aging, STRIDE, GANG)
+priqueue_t ready_queue;
+// Jobs ready_run_on() put on a core, the one ready_queue orders last first
+priqueue_t ready_running;
+
+// STRIDE and LOTTERY state
+long long share_virtual_time;	// Pass of the most recently dispatched job
+int lottery_tickets;					// Total weight of the waiting LOTTERY jobs
+
+// LOTTERY keeps its waiting jobs out of ready_queue, in the slot each job
+// took when it was admitted. A Fenwick tree over the slots' weights finds
+// a ticket's winner in O(log n).
+job_t **lottery_slot_jobs;	// Waiting job in each slot, NULL if none
+int *lottery_tree;					// Fenwick tree, lottery_tree[slot + 1] upwards
+int lottery_capacity;				// Slots allocated, a power of two
+int lottery_next_slot;			// Slot the next admitted job takes
+
+// Cache affinity configuration, set by scheduler_configure_affinity()
+int affinity_window = 0;
+
+// Topology configuration, set by scheduler_configure_topology(). NULL
+// for a flat machine where every other core is equally remote.
+int *core_llc;		// Last-level cache domain of each core
+int *core_node;		// NUMA node of each core
+int topology_cores;
+
+// Core speed configuration, set by scheduler_configure_speeds(). NULL
+// when every core runs at CORE_SPEED_ONE.
+int *core_speed;
+int speed_cores;
+
+// Running sum of the size keys of admitted jobs, see speed_job_is_large()
+long long speed_key_sum;
+long long speed_key_count;
+
+// How far apart two cores are, nearest first
+enum {DISTANCE_CORE = 0, DISTANCE_LLC, DISTANCE_NODE, DISTANCE_REMOTE};
+
+// Aging configuration, set by scheduler_configure_aging()
+int aging_interval = 0;
+
+// Aging state
+int aging_active;					// Aging is configured and applies to the scheme
+int aging_base_min;				// Range of the base keys seen so far
+int aging_base_max;
+
+// GANG state
+priqueue_t gang_running;				// Running jobs, earliest expected end first
+
+// WS state
+priqueue_t *core_queues;	// Run queue owned by each core
+int ws_next_core;					// Next core for round-robin placement
+int migrations;						// Jobs run on a core other than their home core
+
+scheduler_job_totals_t retired;		// Sums over the jobs scheduler_retire_finished() let go
 // Comparator functions
 
 int FCFS_comparator(const void *thing1, const void *thing2) {
@@ -125,8 +255,65 @@ int RR_comparator(const void *thing1, const void *thing2) {
 	return -1;
 }
 
+int STRIDE_comparator(const void *thing1, const void *thing2) {
+	job_t *this;
+	job_t *that;
+	this = (job_t*)thing1;
+	that = (job_t*)thing2;
+
+	if (this->pass == that->pass)
+		return (this->arrival_time - that->arrival_time);
+	return (this->pass < that->pass) ? -1 : 1;
+}
+
+int EDF_comparator(const void *thing1, const void *thing2) {
+	job_t *this;
+	job_t *that;
+	this = (job_t*)thing1;
+	that = (job_t*)thing2;
+
+	// Jobs without a deadline go behind every job with one
+	if (this->deadline == that->deadline)
+		return (this->arrival_time - that->arrival_time);
+	else if (this->deadline < 0)
+		return 1;
+	else if (that->deadline < 0)
+		return -1;
+	else
+		return (this->deadline - that->deadline);
+}
+
+/**
+  Orders ready_running: the reverse of ready_queue, so its head is the
+  running job an arrival would preempt, and the lowest core among equals.
+*/
+int VICTIM_comparator(const void *thing1, const void *thing2) {
+	int order = ready_queue.comp(thing2, thing1);
+
+	if (order != 0)
+		return order;
+	return ((job_t*)thing1)->core_id - ((job_t*)thing2)->core_id;
+}
+
+int AGED_comparator(const void *thing1, const void *thing2) {
+	job_t *this;
+	job_t *that;
+	this = (job_t*)thing1;
+	that = (job_t*)thing2;
+
+	if (this->aged_key == that->aged_key)
+		return (this->arrival_time - that->arrival_time);
+	return (this->aged_key - that->aged_key);
+}
+
 void tick(int time) {
 	job_t *job;
+#ifdef SCHEDULER_METRICS
+	unsigned long long tick_start = scheduler_metrics_cycles();
+#endif
+
+	METRIC_ADD(ticks, 1);
+	METRIC_ADD(tick_jobs_scanned, priqueue_size(queue));
 
 	for (int i=0; i<priqueue_size(queue); i++) {
 		job = (job_t*)priqueue_at(queue, i);
@@ -138,14 +325,235 @@ void tick(int time) {
 			job->running_time = time - job->arrival_time;
 		}
 	}
+
+#ifdef SCHEDULER_METRICS
+	metrics.tick_cycles += scheduler_metrics_cycles() - tick_start;
+#endif
 }
 
-int get_lowest_idle_core() {
+int speed_of(int core_id) {
+	if (core_speed == NULL || core_id >= speed_cores)
+		return CORE_SPEED_ONE;
+	return core_speed[core_id];
+}
+
+void idle_init() {
+	int words = num_cores;
+
+	idle_levels = 0;
+	do {
+		words = (words + 63) / 64;
+		idle_words[idle_levels] = words;
+		idle_bits[idle_levels] = (unsigned long long *) calloc(words, sizeof(unsigned long long));
+		idle_levels++;
+	} while (words > 1 && idle_levels < IDLE_MAX_LEVELS);
+
 	for (int i=0; i<num_cores; i++) {
-		if (available_cores[i] < 0)
-			return i;
+		int index = i;
+		for (int level=0; level<idle_levels; level++) {
+			idle_bits[level][index / 64] |= 1ULL << (index % 64);
+			index /= 64;
+		}
 	}
-	return -1;
+	idle_count = num_cores;
+}
+
+void idle_destroy() {
+	for (int level=0; level<idle_levels; level++) {
+		free(idle_bits[level]);
+	}
+	idle_levels = 0;
+}
+
+/**
+  The lowest idle core at or above core_id: scans the rest of its word,
+  climbs the summary levels to the next non-empty word if that fails and
+  follows the lowest set bit back down, one ctz per level.
+
+  @return -1 if no such core is idle
+*/
+int idle_next(int core_id) {
+	int index = core_id;
+	int level = 0;
+
+	while (1) {
+		if (level == idle_levels || index / 64 >= idle_words[level])
+			return -1;
+		unsigned long long word = idle_bits[level][index / 64] & (~0ULL << (index % 64));
+		if (word != 0) {
+			index = (index & ~63) + __builtin_ctzll(word);
+			break;
+		}
+		index = index / 64 + 1;
+		level++;
+	}
+
+	while (level > 0) {
+		level--;
+		index = index * 64 + __builtin_ctzll(idle_bits[level][index]);
+	}
+	return index;
+}
+
+/**
+  Marks core_id as running job_id, clearing its idle bit and every
+  summary bit whose word that empties.
+*/
+void core_assign(int core_id, int job_id) {
+	if (available_cores[core_id] < 0) {
+		int index = core_id;
+		for (int level=0; level<idle_levels; level++) {
+			unsigned long long *word = &idle_bits[level][index / 64];
+			*word &= ~(1ULL << (index % 64));
+			if (*word != 0)
+				break;
+			index /= 64;
+		}
+		idle_count--;
+	}
+	available_cores[core_id] = job_id;
+}
+
+/**
+  Marks core_id as idle, setting its idle bit and the summary bit of
+  every word that was empty until now.
+*/
+void core_release(int core_id) {
+	if (available_cores[core_id] >= 0) {
+		int index = core_id;
+		for (int level=0; level<idle_levels; level++) {
+			unsigned long long *word = &idle_bits[level][index / 64];
+			int was_empty = (*word == 0);
+			*word |= 1ULL << (index % 64);
+			if (!was_empty)
+				break;
+			index /= 64;
+		}
+		idle_count++;
+	}
+	available_cores[core_id] = -1;
+}
+
+/**
+  The idle core with the lowest id, or with core speeds configured the
+  fastest idle core, so jobs dispatched in the scheme's order fill the
+  fast cores first.
+
+  @return -1 if no core is idle
+*/
+int get_lowest_idle_core() {
+	if (core_speed == NULL)
+		return idle_next(0);
+
+	int best = -1;
+	for (int i=idle_next(0); i!=-1; i=idle_next(i + 1)) {
+		if (best == -1 || speed_of(i) > speed_of(best))
+			best = i;
+	}
+	return best;
+}
+
+/**
+  Whether an arriving job is larger than average: a higher priority
+  value under PRI and PPRI, a longer running time otherwise.
+*/
+int speed_job_is_large(job_t *job) {
+	int key = (current_scheme == PRI || current_scheme == PPRI) ? job->priority : job->burst_time;
+	int large = speed_key_count > 0 && key * speed_key_count > speed_key_sum;
+
+	speed_key_sum += key;
+	speed_key_count++;
+	return large;
+}
+
+/**
+  The idle core an arriving job should start on. With core speeds
+  configured, short or high priority jobs take the fastest idle core and
+  larger than average jobs the slowest, keeping fast cores for the jobs
+  that benefit most; otherwise the lowest id.
+
+  @return -1 if no core is idle
+*/
+int get_idle_core_for(job_t *job) {
+	if (core_speed == NULL)
+		return get_lowest_idle_core();
+
+	int large = speed_job_is_large(job);
+	int best = -1;
+	for (int i=idle_next(0); i!=-1; i=idle_next(i + 1)) {
+		if (best == -1
+			|| (large && speed_of(i) < speed_of(best))
+			|| (!large && speed_of(i) > speed_of(best)))
+			best = i;
+	}
+	return best;
+}
+
+int core_distance(int a, int b) {
+	if (a == b)
+		return DISTANCE_CORE;
+	if (core_llc == NULL || a >= topology_cores || b >= topology_cores)
+		return DISTANCE_REMOTE;
+	if (core_llc[a] == core_llc[b])
+		return DISTANCE_LLC;
+	if (core_node[a] == core_node[b])
+		return DISTANCE_NODE;
+	return DISTANCE_REMOTE;
+}
+
+/**
+  The idle core nearest to core_id, lowest id first among equals.
+
+  @return -1 if no core is idle
+*/
+int get_nearest_idle_core(int core_id) {
+	int nearest = -1;
+	for (int i=idle_next(0); i!=-1; i=idle_next(i + 1)) {
+		if (nearest == -1 || core_distance(core_id, i) < core_distance(core_id, nearest))
+			nearest = i;
+	}
+	return nearest;
+}
+
+/**
+  How warm core_id is for job: the distance from the core the job last
+  ran on, or DISTANCE_REMOTE if it has not run or is the job core_id is
+  switching away from.
+*/
+int affinity_distance(job_t *job, int core_id, job_t *outgoing) {
+	if (job->last_core < 0 || job == outgoing)
+		return DISTANCE_REMOTE;
+	return core_distance(job->last_core, core_id);
+}
+
+/**
+  The position in q of the job core_id should run next. That is the head,
+  unless one of the next affinity_window jobs in priority order last ran
+  on core_id or, with a topology, shares its cache domain or node. The
+  nearest such job wins.
+
+  @param outgoing the job core_id is switching away from, which gets no
+  preference, or NULL
+*/
+int affinity_index(priqueue_t *q, int core_id, job_t *outgoing) {
+	// The head is at 0 in a sorted queue and a heap alike
+	if (affinity_window == 0 || priqueue_size(q) == 0)
+		return 0;
+
+	int *indexes = (int *) malloc((affinity_window + 1) * sizeof(int));
+	int size = priqueue_first_indexes(q, indexes, affinity_window + 1);
+	int best = indexes[0];
+	int best_distance = DISTANCE_REMOTE;
+
+	for (int i=0; i<size; i++) {
+		int distance = affinity_distance((job_t *)priqueue_at(q, indexes[i]), core_id, outgoing);
+		if (distance < best_distance) {
+			best = indexes[i];
+			best_distance = distance;
+		}
+	}
+	free(indexes);
+	return best;
 }
 
 void set_next_job_nonpreemptive(int time) {
@@ -164,8 +572,9 @@ void set_next_job_nonpreemptive(int time) {
 				}
 			}
 			if (job_found) {
+				METRIC_ADD(context_switches, 1);
 				job->core_id = idle_core;
-				available_cores[idle_core] = job->job_id;
+				core_assign(idle_core, job->job_id);
 				idle_core = get_lowest_idle_core();
 			} else {
 				break;
@@ -182,14 +591,17 @@ void set_next_job_preemptive(int time) {
 			if (!job->finished && job->core_id < 0) {
 				int idle_core = get_lowest_idle_core();
 				if (idle_core != -1) {
+					METRIC_ADD(context_switches, 1);
 					job->core_id = idle_core;
-					available_cores[idle_core] = job->job_id;
+					core_assign(idle_core, job->job_id);
 				} else { // Find a job to be replaced
-					job_t *running_job;
-					for (int i=priqueue_size(queue)-1; i >-1; i++) {
-						running_job = (job_t*)priqueue_at(queue, i);
-						if (running_job->core_id > -1
-							&& queue->comp(job, running_job) <= 0) {
+					job_t *running_job = NULL;
+					for (int j=priqueue_size(queue)-1; j >-1; j--) {
+						job_t *candidate = (job_t*)priqueue_at(queue, j);
+						METRIC_ADD(comparisons, 1);
+						if (candidate->core_id > -1
+							&& queue->comp(job, candidate) <= 0) {
+							running_job = candidate;
 							break;
 						}
 					}
@@ -199,8 +611,10 @@ void set_next_job_preemptive(int time) {
 						running_job->core_id = -1;
 						if (running_job->running_time == 0)
 							running_job->latency_time = -1;
+						METRIC_ADD(preemptions, 1);
+						METRIC_ADD(context_switches, 1);
 						job->core_id = core_id;
-						available_cores[core_id] = job->job_id;
+						core_assign(core_id, job->job_id);
 					}
 				}
 			}
@@ -208,121 +622,1130 @@ void set_next_job_preemptive(int time) {
 	}
 }
 
-void set_next_job(int time) {
-	switch(current_scheme) {
-		case FCFS:
-		case PRI:
-		case SJF:
-		case RR:
-			set_next_job_nonpreemptive(time);
-			break;
-		case PPRI:
-		case PSJF:
-			set_next_job_preemptive(time);
-			break;
+/**
+  The level a job is at. A priority boost moves everything to level 0 by
+  bumping mlfq_epoch rather than touching every job.
+*/
+int mlfq_level_of(job_t *job) {
+	return (job->mlfq_epoch == mlfq_epoch) ? job->level : 0;
+}
+
+void mlfq_push(job_t *job, int level) {
+	job->level = level;
+	job->mlfq_epoch = mlfq_epoch;
+	job->next = NULL;
+
+	if (mlfq_ready[level].tail == NULL)
+		mlfq_ready[level].head = job;
+	else
+		mlfq_ready[level].tail->next = job;
+	mlfq_ready[level].tail = job;
+}
+
+/**
+  Removes the job core_id should run next: the head of the highest
+  non-empty level, or one of the affinity_window jobs behind it chosen as
+  in affinity_index().
+*/
+job_t *mlfq_pop(int core_id, job_t *outgoing) {
+	for (int level=0; level<mlfq_levels; level++) {
+		job_t *job = mlfq_ready[level].head;
+		if (job == NULL)
+			continue;
+
+		// prev is the job before the one taken, NULL for the head
+		job_t *prev = NULL;
+		job_t *cur_prev = NULL;
+		int best_distance = DISTANCE_REMOTE;
+		job_t *cur = job;
+		for (int i=0; i<=affinity_window && cur != NULL; i++) {
+			int distance = affinity_distance(cur, core_id, outgoing);
+			if (distance < best_distance) {
+				job = cur;
+				prev = cur_prev;
+				best_distance = distance;
+			}
+			cur_prev = cur;
+			cur = cur->next;
+		}
+
+		if (prev == NULL)
+			mlfq_ready[level].head = job->next;
+		else
+			prev->next = job->next;
+		if (mlfq_ready[level].tail == job)
+			mlfq_ready[level].tail = prev;
+		job->level = level;
+		job->mlfq_epoch = mlfq_epoch;
+		job->next = NULL;
+		return job;
 	}
+	return NULL;
 }
 
 /**
-  Initalizes the scheduler.
+  Applies any priority boost due by time. Lower levels are spliced onto
+  the end of level 0 in order, so a boost costs O(levels).
+*/
+void mlfq_boost(int time) {
+	if (mlfq_boost_period <= 0 || time < mlfq_next_boost)
+		return;
+
+	for (int level=1; level<mlfq_levels; level++) {
+		if (mlfq_ready[level].head == NULL)
+			continue;
+		if (mlfq_ready[0].tail == NULL)
+			mlfq_ready[0].head = mlfq_ready[level].head;
+		else
+			mlfq_ready[0].tail->next = mlfq_ready[level].head;
+		mlfq_ready[0].tail = mlfq_ready[level].tail;
+		mlfq_ready[level].head = mlfq_ready[level].tail = NULL;
+	}
 
-  Assumptions:
-    - You may assume this will be the first scheduler function called.
-    - You may assume this function will be called once once.
-    - You may assume that cores is a positive, non-zero number.
-    - You may assume that scheme is a valid scheduling scheme.
+	mlfq_epoch++;
+	mlfq_next_boost = (time / mlfq_boost_period + 1) * mlfq_boost_period;
+}
 
-  @param cores the number of cores that is available by the scheduler. These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
-  @param scheme  the scheduling scheme that should be used. This value will be one of the six enum values of scheme_t
+void mlfq_run_on(job_t *job, int core_id) {
+	METRIC_ADD(context_switches, 1);
+	job->core_id = core_id;
+	job->last_core = core_id;
+	core_assign(core_id, job->job_id);
+	core_jobs[core_id] = job;
+}
+
+/**
+  Places an arriving job. It takes an idle core if there is one, otherwise
+  it preempts the job at the lowest level below 0, otherwise it waits at
+  the back of level 0.
 */
-void scheduler_start_up(int cores, scheme_t scheme)
-{
-	// Set number of cores and initialize cores to inactive
-	num_cores = cores;
-	available_cores = (int *) malloc(num_cores * sizeof(int));
+void mlfq_admit(job_t *job, int time) {
+	int idle_core = get_idle_core_for(job);
+
+	if (idle_core != -1) {
+		job->level = 0;
+		job->mlfq_epoch = mlfq_epoch;
+		mlfq_run_on(job, idle_core);
+		return;
+	}
+
+	int victim_core = -1;
+	int victim_level = 0;
 	for (int i=0; i<num_cores; i++) {
-		available_cores[i] = -1;
+		if (core_jobs[i] != NULL && mlfq_level_of(core_jobs[i]) > victim_level) {
+			victim_core = i;
+			victim_level = mlfq_level_of(core_jobs[i]);
+		}
 	}
 
-	queue = (priqueue_t *)malloc(sizeof(priqueue_t));
+	if (victim_core == -1) {
+		mlfq_push(job, 0);
+		return;
+	}
 
-	current_scheme = scheme;
+	job_t *victim = core_jobs[victim_core];
+	victim->core_id = -1;
+	if (victim->latency_time == time - victim->arrival_time)
+		victim->latency_time = -1;
+	mlfq_push(victim, victim_level);
+	METRIC_ADD(preemptions, 1);
 
-	switch(current_scheme){
-		case FCFS:
-			priqueue_init(queue, FCFS_comparator);
+	job->level = 0;
+	job->mlfq_epoch = mlfq_epoch;
+	mlfq_run_on(job, victim_core);
+}
+
+void set_next_job_mlfq(int time) {
+	int idle_core = get_lowest_idle_core();
+
+	while (idle_core != -1) {
+		job_t *job = mlfq_pop(idle_core, NULL);
+		if (job == NULL)
 			break;
-		case SJF:
-			priqueue_init(queue, SJF_comparator);
+		mlfq_run_on(job, idle_core);
+		idle_core = get_lowest_idle_core();
+	}
+}
+
+int ARRIVAL_comparator(const void *thing1, const void *thing2) {
+	return ((job_t*)thing1)->arrival_time - ((job_t*)thing2)->arrival_time;
+}
+
+int ws_load(int core_id) {
+	return priqueue_size(&core_queues[core_id]) + (available_cores[core_id] >= 0);
+}
+
+unsigned int scheduler_random() {
+	// xorshift32, deterministic for a given seed
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+/**
+  Picks the run queue a new job is placed on according to ws_placement.
+*/
+int ws_place() {
+	int core_id = 0;
+
+	switch (ws_placement) {
+		case PLACE_ROUND_ROBIN:
+			core_id = ws_next_core;
+			ws_next_core = (ws_next_core + 1) % num_cores;
 			break;
-		case PSJF:
-			priqueue_init(queue, PSJF_comparator);
+		case PLACE_LEAST_LOADED:
+			for (int i=1; i<num_cores; i++) {
+				if (ws_load(i) < ws_load(core_id))
+					core_id = i;
+			}
 			break;
-		case PRI:
-			priqueue_init(queue, PRI_comparator);
+		case PLACE_TWO_CHOICES: {
+			int first = scheduler_random() % num_cores;
+			int second = scheduler_random() % num_cores;
+			core_id = (ws_load(second) < ws_load(first)) ? second : first;
 			break;
-		case PPRI:
-			priqueue_init(queue, PPRI_comparator);
-		default:
-			priqueue_init(queue, RR_comparator);
-		break;
+		}
 	}
+	return core_id;
 }
 
-
 /**
-  Called when a new job arrives.
-
-  If multiple cores are idle, the job should be assigned to the core with the
-  lowest id.
-  If the job arriving should be scheduled to run during the next
-  time cycle, return the zero-based index of the core the job should be
-  scheduled on. If another job is already running on the core specified,
-  this will preempt the currently running job.
-  Assumptions:
-    - You may assume that every job wil have a unique arrival time.
+  The run queue idle core core_id steals from: the longest non-empty one
+  in the nearest domain, so work stays within a cache domain, then a NUMA
+  node, before it crosses nodes.
 
-  @param job_number a globally unique identification number of the job arriving.
-  @param time the current time of the simulator.
-  @param running_time the total number of time units this job will run before it will be finished.
-  @param priority the priority of the job. (The lower the value, the higher the priority.)
-  @return index of core job should be scheduled on
-  @return -1 if no scheduling changes should be made.
+  @return -1 if every run queue is empty
+*/
+int ws_steal_victim(int core_id) {
+	int victim = -1;
+	int victim_distance = DISTANCE_REMOTE;
+	for (int i=0; i<num_cores; i++) {
+		if (priqueue_size(&core_queues[i]) == 0)
+			continue;
+		int distance = core_distance(core_id, i);
+		if (victim == -1 || distance < victim_distance
+			|| (distance == victim_distance && priqueue_size(&core_queues[i]) > priqueue_size(&core_queues[victim]))) {
+			victim = i;
+			victim_distance = distance;
+		}
+	}
+	return victim;
+}
 
- */
-///////////////////////
-// *******WIP******* //
-///////////////////////
-int scheduler_new_job(int job_number, int time, int running_time, int priority)
-{
-	// Create and initialize the job
-	job_t* job = (job_t *) malloc(sizeof(job_t));
-	job->job_id = job_number;
-	job->priority = priority;
-	job->core_id = -1;
-	job->burst_time = running_time;
-	job->arrival_time = time;
-	job->latency_time = -1; // Set to -1 to allow for 0 latency
-	job->running_time = 0;
-	job->end_time = 0;
-	job->finished = 0;
+void ws_run_on(job_t *job, int core_id) {
+	METRIC_ADD(context_switches, 1);
+	if (core_id != job->home_core)
+		migrations++;
+	job->core_id = core_id;
+	job->last_core = core_id;
+	core_assign(core_id, job->job_id);
+	core_jobs[core_id] = job;
+}
 
-	priqueue_offer(queue, job);
+/**
+  Places an arriving job on a run queue. If its core is idle it starts
+  there; if another core is idle the nearest one steals it straight away.
+*/
+void ws_admit(job_t *job, int time) {
+	job->home_core = ws_place();
 
-	// Update cores
-	set_next_job(time);
+	int idle_core = get_nearest_idle_core(job->home_core);
+	if (idle_core != -1) {
+		ws_run_on(job, idle_core);
+	} else {
+		priqueue_offer(&core_queues[job->home_core], job);
+	}
+}
 
-	// Update time
-	tick(time);
+/**
+  Idle cores take the head of their own run queue, or steal the head of
+  the nearest busiest one when theirs is empty.
+*/
+void set_next_job_ws(int time) {
+	for (int i=idle_next(0); i!=-1; i=idle_next(i + 1)) {
+		int victim = (priqueue_size(&core_queues[i]) > 0) ? i : ws_steal_victim(i);
+		if (victim == -1)
+			break;
 
-	return job->core_id;
+		ws_run_on((job_t *)priqueue_poll(&core_queues[victim]), i);
+	}
 }
 
+void ready_run_on(job_t *job, int core_id) {
+	METRIC_ADD(context_switches, 1);
+	job->core_id = core_id;
+	job->last_core = core_id;
+	core_assign(core_id, job->job_id);
+	core_jobs[core_id] = job;
+	priqueue_offer(&ready_running, job);
+}
 
 /**
-  Called when a job has completed execution.
+  Places an arriving job for preemptive schemes built on ready_queue. It
+  takes an idle core, otherwise preempts the running job it compares
+  furthest ahead of, the head of ready_running, otherwise waits in
+  ready_queue.
+*/
+void ready_admit(job_t *job, int time) {
+	int idle_core = get_idle_core_for(job);
 
-  The core_id, job_number and time parameters are provided for convenience. You may be able to calculate the values with your own data structure.
+	if (idle_core != -1) {
+		ready_run_on(job, idle_core);
+		return;
+	}
+
+	job_t *victim = (job_t *)priqueue_peek(&ready_running);
+
+	METRIC_ADD(comparisons, 1);
+	if (ready_queue.comp(job, victim) >= 0) {
+		priqueue_offer(&ready_queue, job);
+		return;
+	}
+
+	int victim_core = victim->core_id;
+	priqueue_poll(&ready_running);
+	victim->core_id = -1;
+	if (victim->latency_time == time - victim->arrival_time)
+		victim->latency_time = -1;
+	priqueue_offer(&ready_queue, victim);
+	METRIC_ADD(preemptions, 1);
+
+	ready_run_on(job, victim_core);
+}
+
+void set_next_job_ready(int time) {
+	int idle_core = get_lowest_idle_core();
+
+	while (idle_core != -1 && priqueue_size(&ready_queue) > 0) {
+		int index = affinity_index(&ready_queue, idle_core, NULL);
+		ready_run_on((job_t *)priqueue_remove_at(&ready_queue, index), idle_core);
+		idle_core = get_lowest_idle_core();
+	}
+}
+
+void lottery_tree_add(int slot, int weight) {
+	for (int i=slot + 1; i<=lottery_capacity; i += i & -i)
+		lottery_tree[i] += weight;
+}
+
+/**
+  Gives lottery_next_slot a slot to refer to, numbering the jobs that hold
+  slots afresh, in the same order, when at least half the slots are free
+  and doubling the slots otherwise.
+*/
+void lottery_reserve() {
+	if (lottery_next_slot < lottery_capacity)
+		return;
+
+	// Every job holding a slot is waiting or running
+	job_t **held = (job_t **) calloc(lottery_capacity + 1, sizeof(job_t *));
+	int live = 0;
+	for (int slot=0; slot<lottery_capacity; slot++) {
+		if (lottery_slot_jobs[slot] != NULL) {
+			held[slot] = lottery_slot_jobs[slot];
+			live++;
+		}
+	}
+	for (int i=0; i<num_cores; i++) {
+		if (core_jobs[i] != NULL && core_jobs[i]->share_slot < lottery_capacity) {
+			held[core_jobs[i]->share_slot] = core_jobs[i];
+			live++;
+		}
+	}
+
+	int capacity = (lottery_capacity == 0) ? 64 : lottery_capacity;
+	if (live * 2 > capacity)
+		capacity *= 2;
+
+	job_t **slot_jobs = (job_t **) calloc(capacity, sizeof(job_t *));
+	free(lottery_slot_jobs);
+	free(lottery_tree);
+	lottery_slot_jobs = slot_jobs;
+	lottery_tree = (int *) calloc(capacity + 1, sizeof(int));
+
+	int next_slot = 0;
+	for (int slot=0; slot<lottery_capacity; slot++) {
+		job_t *job = held[slot];
+		if (job == NULL)
+			continue;
+		job->share_slot = next_slot++;
+		if (job->core_id < 0) {
+			lottery_slot_jobs[job->share_slot] = job;
+			lottery_tree[job->share_slot + 1] = job->weight;
+		}
+	}
+	free(held);
+
+	// Build the tree in place, each node adding itself to its parent
+	lottery_capacity = capacity;
+	for (int i=1; i<=lottery_capacity; i++) {
+		int parent = i + (i & -i);
+		if (parent <= lottery_capacity)
+			lottery_tree[parent] += lottery_tree[i];
+	}
+	lottery_next_slot = next_slot;
+}
+
+/**
+  The slot holding the ticket'th of the waiting jobs' tickets, counting
+  through the slots in order: the lowest slot whose weights and those
+  before it add up to more than ticket.
+*/
+int lottery_draw(int ticket) {
+	int slot = 0;
+
+	for (int step=lottery_capacity; step>0; step >>= 1) {
+		if (slot + step <= lottery_capacity && lottery_tree[slot + step] <= ticket) {
+			slot += step;
+			ticket -= lottery_tree[slot];
+		}
+	}
+	return slot;
+}
+
+void share_enqueue(job_t *job) {
+	if (current_scheme == LOTTERY) {
+		lottery_slot_jobs[job->share_slot] = job;
+		lottery_tree_add(job->share_slot, job->weight);
+	} else {
+		priqueue_offer(&ready_queue, job);
+	}
+	lottery_tickets += job->weight;
+}
+
+/**
+  Removes the job core_id should run next: the lowest pass in ready_queue
+  for STRIDE, subject to cache affinity, or a weighted random draw among
+  the waiting jobs for LOTTERY.
+*/
+job_t *share_dequeue(int core_id, job_t *outgoing) {
+	job_t *job;
+
+	if (current_scheme == STRIDE) {
+		if (priqueue_size(&ready_queue) == 0)
+			return NULL;
+		job = (job_t *)priqueue_remove_at(&ready_queue, affinity_index(&ready_queue, core_id, outgoing));
+	} else {
+		if (lottery_tickets == 0)
+			return NULL;
+
+		int slot = lottery_draw(scheduler_random() % lottery_tickets);
+		job = lottery_slot_jobs[slot];
+		lottery_slot_jobs[slot] = NULL;
+		lottery_tree_add(slot, -job->weight);
+	}
+
+	lottery_tickets -= job->weight;
+	return job;
+}
+
+void share_run_on(job_t *job, int core_id) {
+	METRIC_ADD(context_switches, 1);
+	if (job->pass > share_virtual_time)
+		share_virtual_time = job->pass;
+	job->core_id = core_id;
+	job->last_core = core_id;
+	core_assign(core_id, job->job_id);
+	core_jobs[core_id] = job;
+}
+
+/**
+  Places an arriving job for STRIDE and LOTTERY. New jobs start at the
+  current virtual time so they neither starve nor monopolize the CPU, and
+  wait for the next quantum boundary if no core is idle.
+*/
+void share_admit(job_t *job, int time) {
+	int idle_core = get_idle_core_for(job);
+
+	job->pass = share_virtual_time;
+	if (current_scheme == LOTTERY) {
+		lottery_reserve();
+		job->share_slot = lottery_next_slot++;
+	}
+
+	if (idle_core != -1)
+		share_run_on(job, idle_core);
+	else
+		share_enqueue(job);
+}
+
+void set_next_job_share(int time) {
+	int idle_core = get_lowest_idle_core();
+
+	while (idle_core != -1) {
+		job_t *job = share_dequeue(idle_core, NULL);
+		if (job == NULL)
+			break;
+		share_run_on(job, idle_core);
+		idle_core = get_lowest_idle_core();
+	}
+}
+
+int END_comparator(const void *thing1, const void *thing2) {
+	job_t *this;
+	job_t *that;
+	this = (job_t*)thing1;
+	that = (job_t*)thing2;
+
+	if (this->expected_end == that->expected_end)
+		return (this->arrival_time - that->arrival_time);
+	return (this->expected_end - that->expected_end);
+}
+
+/**
+  Starts a GANG job on the lowest numbered idle cores, taken straight off
+  the idle bitmap. The lowest core leads: it is the
+  job's core_id and the core the simulator reports the job finishing on.
+*/
+void gang_start(job_t *job, int time) {
+	int taken = 0;
+
+	METRIC_ADD(context_switches, 1);
+	job->gang_cores = (int *) malloc(job->width * sizeof(int));
+	job->core_id = -1;
+
+	for (int core_id=idle_next(0); taken<job->width; core_id=idle_next(core_id + 1)) {
+		core_assign(core_id, job->job_id);
+		core_jobs[core_id] = job;
+		job->gang_cores[taken++] = core_id;
+		if (job->core_id < 0)
+			job->core_id = core_id;
+	}
+
+	job->last_core = job->core_id;
+	job->expected_end = time + job->burst_time;
+	priqueue_offer(&gang_running, job);
+}
+
+void gang_release(job_t *job) {
+	for (int i=0; i<job->width; i++) {
+		int core_id = job->gang_cores[i];
+		core_release(core_id);
+		core_jobs[core_id] = NULL;
+	}
+
+	priqueue_remove(&gang_running, job);
+	free(job->gang_cores);
+	job->gang_cores = NULL;
+}
+
+/**
+  EASY backfilling. Waiting jobs start in arrival order while they fit.
+  The first one that does not fit is promised the earliest time enough
+  running jobs will have finished (the shadow time), and a later job may
+  start ahead of it only if it fits now and either finishes by the shadow
+  time or only uses cores the reserved job will not need then.
+*/
+void gang_schedule(int time) {
+	while (priqueue_size(&ready_queue) > 0
+		&& ((job_t *)priqueue_peek(&ready_queue))->width <= idle_count) {
+		gang_start((job_t *)priqueue_poll(&ready_queue), time);
+	}
+
+	if (priqueue_size(&ready_queue) < 2 || idle_count == 0)
+		return;
+
+	job_t *head = (job_t *)priqueue_peek(&ready_queue);
+	int shadow_time = time;
+	int shadow_free = idle_count;
+	for (int i=0; i<priqueue_size(&gang_running) && shadow_free < head->width; i++) {
+		job_t *running = (job_t *)priqueue_at(&gang_running, i);
+		shadow_free += running->width;
+		shadow_time = running->expected_end;
+	}
+	int extra = shadow_free - head->width;
+
+	for (int i=1; i<priqueue_size(&ready_queue) && idle_count > 0; ) {
+		job_t *job = (job_t *)priqueue_at(&ready_queue, i);
+		int done_by_shadow = time + job->burst_time <= shadow_time;
+
+		if (job->width <= idle_count && (done_by_shadow || job->width <= extra)) {
+			if (!done_by_shadow)
+				extra -= job->width;
+			priqueue_remove_at(&ready_queue, i);
+			gang_start(job, time);
+		} else {
+			i++;
+		}
+	}
+}
+
+void gang_admit(job_t *job, int time) {
+	// A job wider than the machine would never start
+	if (job->width > num_cores)
+		job->width = num_cores;
+	if (job->width < 1)
+		job->width = 1;
+
+	priqueue_offer(&ready_queue, job);
+	gang_schedule(time);
+}
+
+/**
+  The ready_queue key of a job under aging: its priority (PRI, PPRI) or
+  running time (SJF, PSJF) plus the number of aging intervals that had
+  passed when it arrived.
+
+  Every waiting job would gain one step per interval, so only the
+  difference between arrival buckets matters and it never changes. The
+  key is therefore computed once on arrival and the queue is never
+  rescanned.
+*/
+int aging_key(job_t *job) {
+	int base = (current_scheme == SJF || current_scheme == PSJF) ? job->burst_time : job->priority;
+
+	if (aging_base_min > aging_base_max) {
+		aging_base_min = aging_base_max = base;
+	} else if (base < aging_base_min) {
+		aging_base_min = base;
+	} else if (base > aging_base_max) {
+		aging_base_max = base;
+	}
+
+	return base + job->arrival_time / aging_interval;
+}
+
+void aged_admit(job_t *job, int time) {
+	job->aged_key = aging_key(job);
+
+	if (current_scheme == PPRI || current_scheme == PSJF) {
+		ready_admit(job, time);
+		return;
+	}
+
+	int idle_core = get_idle_core_for(job);
+	if (idle_core != -1)
+		ready_run_on(job, idle_core);
+	else
+		priqueue_offer(&ready_queue, job);
+}
+
+/**
+  Tells whether the current scheme places new jobs itself rather than
+  through the shared queue.
+
+  @return 1 if new jobs go to place_job()
+  @return 0 if the caller should run set_next_job() instead
+*/
+int scheme_places_jobs() {
+	if (aging_active)
+		return 1;
+
+	switch (current_scheme) {
+		case MLFQ:
+		case WS:
+		case EDF:
+		case STRIDE:
+		case LOTTERY:
+		case GANG:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/**
+  Hands a newly created job to a scheme for which scheme_places_jobs()
+  holds.
+*/
+void place_job(job_t *job, int time) {
+	if (aging_active) {
+		aged_admit(job, time);
+		return;
+	}
+
+	switch (current_scheme) {
+		case MLFQ:
+			mlfq_boost(time);
+			mlfq_admit(job, time);
+			break;
+		case WS:
+			ws_admit(job, time);
+			break;
+		case EDF:
+			ready_admit(job, time);
+			break;
+		case STRIDE:
+		case LOTTERY:
+			share_admit(job, time);
+			break;
+		case GANG:
+			gang_admit(job, time);
+			break;
+		default:
+			break;
+	}
+}
+
+void set_next_job(int time) {
+	if (aging_active) {
+		set_next_job_ready(time);
+		return;
+	}
+
+	switch(current_scheme) {
+		case FCFS:
+		case PRI:
+		case SJF:
+		case RR:
+			set_next_job_nonpreemptive(time);
+			break;
+		case PPRI:
+		case PSJF:
+			set_next_job_preemptive(time);
+			break;
+		case MLFQ:
+			set_next_job_mlfq(time);
+			break;
+		case WS:
+			set_next_job_ws(time);
+			break;
+		case EDF:
+			set_next_job_ready(time);
+			break;
+		case STRIDE:
+		case LOTTERY:
+			set_next_job_share(time);
+			break;
+		case GANG:
+			gang_schedule(time);
+			break;
+	}
+}
+
+/**
+  Configures the MLFQ scheme. Must be called before scheduler_start_up()
+  to take effect; otherwise 3 levels with quanta 2, 4 and 8 and a boost
+  every 100 time units are used.
+
+  New jobs start at level 0. A job that uses up its level's quantum moves
+  down one level, and every boost_period time units all jobs return to
+  level 0. Job running times are never consulted.
+
+  @param levels number of levels, between 1 and MLFQ_MAX_LEVELS
+  @param quanta the quantum of each level, highest priority first
+  @param boost_period time units between priority boosts, or 0 to disable
+*/
+void scheduler_configure_mlfq(int levels, const int *quanta, int boost_period)
+{
+	if (levels < 1)
+		levels = 1;
+	if (levels > MLFQ_MAX_LEVELS)
+		levels = MLFQ_MAX_LEVELS;
+
+	mlfq_levels = levels;
+	for (int i=0; i<levels; i++) {
+		mlfq_quanta[i] = quanta[i];
+	}
+	mlfq_boost_period = boost_period;
+}
+
+
+/**
+  Configures the WS (per-core run queue) scheme. Must be called before
+  scheduler_start_up() to take effect; otherwise round-robin placement is
+  used.
+
+  Each core owns a first come first served run queue. New jobs are placed
+  on a run queue by placement, and a core whose run queue is empty steals
+  the oldest job from the longest run queue.
+
+  @param placement how new jobs are assigned to run queues
+  @param seed seed for the PLACE_TWO_CHOICES random choices
+*/
+void scheduler_configure_ws(placement_t placement, unsigned int seed)
+{
+	ws_placement = placement;
+	random_seed = seed ? seed : 1;
+}
+
+
+/**
+  Configures the proportional-share schemes, STRIDE and LOTTERY. Must be
+  called before scheduler_start_up() to take effect; otherwise a quantum
+  of 1 and a seed of 1 are used.
+
+  Both read a job's priority as its share weight (see
+  scheduler_share_weight()) and hand out the CPU one quantum at a time.
+  STRIDE always runs the job with the lowest pass value and advances it by
+  STRIDE_ONE / weight per quantum. LOTTERY draws each quantum's winner at
+  random with odds proportional to weight.
+
+  @param quantum time units a job runs before the next selection
+  @param seed seed for the LOTTERY draws
+*/
+void scheduler_configure_share(int quantum, unsigned int seed)
+{
+	share_quantum = quantum > 0 ? quantum : 1;
+	random_seed = seed ? seed : 1;
+}
+
+
+/**
+  Configures cache affinity for the MLFQ, EDF and STRIDE schemes and for
+  aging. Must be called before scheduler_start_up() to take effect;
+  otherwise a core always takes the head of its queue.
+
+  A core choosing its next job also looks at the window jobs queued
+  behind the head and takes the first that last ran on it, so a
+  preempted job tends to resume where its cache is warm. The job the
+  core is switching away from gets no preference. A larger window
+  resumes more jobs in place but lets up to window jobs run ahead of
+  the job the scheme would have picked.
+
+  @param window number of jobs behind the head a core may pick, or 0 to
+  disable
+*/
+void scheduler_configure_affinity(int window)
+{
+	affinity_window = window > 0 ? window : 0;
+}
+
+
+/**
+  Sets how fast each core runs, in units of CORE_SPEED_ONE per time unit.
+  Must be called before scheduler_start_up() to take effect; otherwise
+  every core runs at CORE_SPEED_ONE.
+
+  Arriving short or high priority jobs (compared with the average so far)
+  start on the fastest idle core and the rest on the slowest, and queued
+  jobs are handed to the fastest idle core first. Waiting times still
+  subtract the running time at speed one, so they come out lower for jobs
+  that ran on fast cores.
+
+  @param cores number of entries in speeds
+  @param speeds the speed of each core, CORE_SPEED_ONE for nominal
+*/
+void scheduler_configure_speeds(int cores, const int *speeds)
+{
+	free(core_speed);
+	core_speed = (int *) malloc(cores * sizeof(int));
+	memcpy(core_speed, speeds, cores * sizeof(int));
+	speed_cores = cores;
+}
+
+
+/**
+  Describes which last-level cache domain and NUMA node each core is in.
+  Must be called before scheduler_start_up() to take effect; otherwise
+  every core is its own domain.
+
+  With a topology, WS steals from and hands new work to the nearest busy
+  or idle core first, and cache affinity (see
+  scheduler_configure_affinity()) also favours jobs that last ran in the
+  same cache domain or node.
+
+  @param cores number of entries in llc and node
+  @param llc the cache domain of each core
+  @param node the NUMA node of each core
+*/
+void scheduler_configure_topology(int cores, const int *llc, const int *node)
+{
+	free(core_llc);
+	free(core_node);
+	core_llc = (int *) malloc(cores * sizeof(int));
+	core_node = (int *) malloc(cores * sizeof(int));
+	memcpy(core_llc, llc, cores * sizeof(int));
+	memcpy(core_node, node, cores * sizeof(int));
+	topology_cores = cores;
+}
+
+
+/**
+  Configures aging for PRI, PPRI, SJF and PSJF. Must be called before
+  scheduler_start_up() to take effect; otherwise aging is off and those
+  schemes can delay a low priority or long job indefinitely.
+
+  With aging on, a waiting job moves ahead of any job that arrives at
+  least (key range + 1) * interval time units after it, where the key
+  range is the spread of priorities (PRI, PPRI) or running times (SJF,
+  PSJF) seen. scheduler_waiting_stats() reports that window.
+
+  @param interval time units of waiting worth one priority step, or 0 to
+  disable
+*/
+void scheduler_configure_aging(int interval)
+{
+	aging_interval = interval > 0 ? interval : 0;
+}
+
+
+/**
+  Initalizes the scheduler.
+
+  Assumptions:
+    - You may assume this will be the first scheduler function called.
+    - You may assume this function will be called once once.
+    - You may assume that cores is a positive, non-zero number.
+    - You may assume that scheme is a valid scheduling scheme.
+
+  @param cores the number of cores that is available by the scheduler. These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
+  @param scheme  the scheduling scheme that should be used. This value will be one of the six enum values of scheme_t
+*/
+void scheduler_start_up(int cores, scheme_t scheme)
+{
+	// Set number of cores and initialize cores to inactive
+	num_cores = cores;
+	available_cores = (int *) malloc(num_cores * sizeof(int));
+	for (int i=0; i<num_cores; i++) {
+		available_cores[i] = -1;
+	}
+	idle_init();
+
+	core_jobs = (job_t **) calloc(num_cores, sizeof(job_t *));
+	memset(mlfq_ready, 0, sizeof(mlfq_ready));
+	mlfq_epoch = 0;
+	mlfq_next_boost = mlfq_boost_period;
+
+	core_queues = NULL;
+	if (scheme == WS) {
+		core_queues = (priqueue_t *) malloc(num_cores * sizeof(priqueue_t));
+		for (int i=0; i<num_cores; i++) {
+			priqueue_init_heap(&core_queues[i], ARRIVAL_comparator, PRIQUEUE_CACHE_ARITY);
+		}
+	}
+	random_state = random_seed;
+
+	aging_active = aging_interval > 0
+		&& (scheme == PRI || scheme == PPRI || scheme == SJF || scheme == PSJF);
+	aging_base_min = 0;
+	aging_base_max = -1;
+	speed_key_sum = 0;
+	speed_key_count = 0;
+
+	switch (scheme) {
+		case PRI:
+		case PPRI:
+		case SJF:
+		case PSJF:
+			priqueue_init_heap(&ready_queue, aging_active ? AGED_comparator : EDF_comparator, PRIQUEUE_CACHE_ARITY);
+			break;
+		case STRIDE:
+			priqueue_init_heap(&ready_queue, STRIDE_comparator, PRIQUEUE_CACHE_ARITY);
+			break;
+		case LOTTERY:
+		case GANG:
+			priqueue_init(&ready_queue, ARRIVAL_comparator);
+			break;
+		default:
+			priqueue_init_heap(&ready_queue, EDF_comparator, PRIQUEUE_CACHE_ARITY);
+			break;
+	}
+
+	priqueue_init_heap(&ready_running, VICTIM_comparator, PRIQUEUE_CACHE_ARITY);
+	priqueue_init(&gang_running, END_comparator);
+	share_virtual_time = 0;
+	lottery_tickets = 0;
+	lottery_slot_jobs = NULL;
+	lottery_tree = NULL;
+	lottery_capacity = 0;
+	lottery_next_slot = 0;
+	ws_next_core = 0;
+	migrations = 0;
+	memset(&retired, 0, sizeof(retired));
+
+	queue = (priqueue_t *)malloc(sizeof(priqueue_t));
+
+	current_scheme = scheme;
+
+	switch(current_scheme){
+		case FCFS:
+			priqueue_init(queue, FCFS_comparator);
+			break;
+		case SJF:
+			priqueue_init(queue, SJF_comparator);
+			break;
+		case PSJF:
+			priqueue_init(queue, PSJF_comparator);
+			break;
+		case PRI:
+			priqueue_init(queue, PRI_comparator);
+			break;
+		case PPRI:
+			priqueue_init(queue, PPRI_comparator);
+		default:
+			priqueue_init(queue, RR_comparator);
+		break;
+	}
+}
+
+
+job_t *create_job(int job_number, int time, int running_time, int priority) {
+	// Create and initialize the job
+	job_t* job = (job_t *) malloc(sizeof(job_t));
+	job->job_id = job_number;
+	job->priority = priority;
+	job->core_id = -1;
+	job->burst_time = running_time;
+	job->arrival_time = time;
+	job->latency_time = -1; // Set to -1 to allow for 0 latency
+	job->running_time = 0;
+	job->end_time = 0;
+	job->finished = 0;
+	job->level = 0;
+	job->mlfq_epoch = 0;
+	job->next = NULL;
+	job->home_core = -1;
+	job->deadline = -1;
+	job->weight = scheduler_share_weight(priority);
+	job->pass = 0;
+	job->share_slot = 0;
+	job->aged_key = 0;
+	job->last_core = -1;
+	job->width = 1;
+	job->gang_cores = NULL;
+	job->expected_end = 0;
+
+	return job;
+}
+
+/**
+  Called when a new job arrives.
+
+  If multiple cores are idle, the job should be assigned to the core with the
+  lowest id.
+  If the job arriving should be scheduled to run during the next
+  time cycle, return the zero-based index of the core the job should be
+  scheduled on. If another job is already running on the core specified,
+  this will preempt the currently running job.
+  Assumptions:
+    - You may assume that every job wil have a unique arrival time.
+
+  @param job_number a globally unique identification number of the job arriving.
+  @param time the current time of the simulator.
+  @param running_time the total number of time units this job will run before it will be finished.
+  @param priority the priority of the job. (The lower the value, the higher the priority.)
+  @return index of core job should be scheduled on
+  @return -1 if no scheduling changes should be made.
+
+ */
+///////////////////////
+// *******WIP******* //
+///////////////////////
+int scheduler_new_job(int job_number, int time, int running_time, int priority)
+{
+	METRIC_CALL_BEGIN();
+
+	job_t* job = create_job(job_number, time, running_time, priority);
+
+	priqueue_offer(queue, job);
+
+	// Update cores
+	if (scheme_places_jobs()) {
+		place_job(job, time);
+	} else {
+		set_next_job(time);
+	}
+
+	// Update time
+	tick(time);
+
+	METRIC_CALL_END(new_job);
+	return job->core_id;
+}
+
+
+/**
+  A job that arrived and waits for a core, made the way the scheduler
+  makes the jobs it queues, for a caller that steps a non-preemptive
+  scheme on its own (the simulator's fast forward) and ranks its waiting
+  jobs with scheduler_compare_waiting(). The scheduler does not hold it;
+  the caller frees it with free().
+
+  @param job_number the job's number
+  @param time the time the job arrived
+  @param running_time the job's running time
+  @param priority the job's priority
+  @return the job
+ */
+void *scheduler_waiting_job(int job_number, int time, int running_time, int priority)
+{
+	return create_job(job_number, time, running_time, priority);
+}
+
+
+/**
+  @param job a job from scheduler_waiting_job()
+  @return the job's number
+ */
+int scheduler_waiting_job_number(const void *job)
+{
+	return ((const job_t *)job)->job_id;
+}
+
+
+/**
+  Ranks two jobs from scheduler_waiting_job() as the queue of the scheme
+  the scheduler was started up for would.
+
+  @param job1 a job from scheduler_waiting_job()
+  @param job2 another job from scheduler_waiting_job()
+  @return less than 0 if job1 goes ahead, more than 0 if job2 does, 0 if
+    the queue keeps them in the order they were offered
+ */
+int scheduler_compare_waiting(const void *job1, const void *job2)
+{
+	return queue->comp(job1, job2);
+}
+
+
+/**
+  Called when several jobs arrive in the same time unit.
+
+  The whole batch is merged into the queue at once and a single dispatch
+  pass is made, instead of one insertion and dispatch per job. A batch of
+  one behaves exactly like scheduler_new_job().
+
+  @param batch the arriving jobs, in arrival order. On return each entry's
+  core_id holds the core the job should run on during the next time cycle,
+  or -1 if it is idle.
+  @param count number of entries in batch
+  @param time the current time of the simulator.
+  @return number of jobs in the batch that were placed on a core
+ */
+int scheduler_new_jobs(scheduler_new_job_t *batch, int count, int time)
+{
+	METRIC_CALL_BEGIN();
+
+	job_t **jobs = (job_t **) malloc(count * sizeof(job_t *));
+	int scheduled = 0;
+
+	for (int i=0; i<count; i++) {
+		jobs[i] = create_job(batch[i].job_number, time, batch[i].running_time, batch[i].priority);
+		jobs[i]->deadline = batch[i].deadline;
+		jobs[i]->width = batch[i].cores;
+	}
+
+	priqueue_offer_all(queue, (void **)jobs, count);
+
+	// Update cores once for the whole batch
+	if (scheme_places_jobs()) {
+		for (int i=0; i<count; i++)
+			place_job(jobs[i], time);
+	} else {
+		set_next_job(time);
+	}
+
+	// Update time
+	tick(time);
+
+	for (int i=0; i<count; i++) {
+		batch[i].core_id = jobs[i]->core_id;
+		if (batch[i].core_id >= 0)
+			scheduled++;
+	}
+	free(jobs);
+
+	METRIC_CALL_END(new_jobs);
+	return scheduled;
+}
+
+
+/**
+  Called when a job has completed execution.
+
+  The core_id, job_number and time parameters are provided for convenience. You may be able to calculate the values with your own data structure.
   If any job should be scheduled to run on the core free'd up by the
   finished job, return the job_number of the job that should be scheduled to
   run on core core_id.
@@ -335,6 +1758,7 @@ int scheduler_new_job(int job_number, int time, int running_time, int priority)
  */
 int scheduler_job_finished(int core_id, int job_number, int time)
 {
+	METRIC_CALL_BEGIN();
 	job_t *job;
 
 	// Find the job
@@ -350,9 +1774,18 @@ int scheduler_job_finished(int core_id, int job_number, int time)
 	job->finished = 1;
 	job->priority = 0;
 
-	available_cores[core_id] = -1;
+	if (current_scheme == GANG)
+		gang_release(job);
+	else if (aging_active || current_scheme == EDF)
+		priqueue_remove(&ready_running, job);
+
+	core_release(core_id);
+	core_jobs[core_id] = NULL;
 	job->core_id = -1;
 
+	if (current_scheme == MLFQ)
+		mlfq_boost(time);
+
 	set_next_job(time);
 
 	job->finished = 0;
@@ -361,6 +1794,7 @@ int scheduler_job_finished(int core_id, int job_number, int time)
 
 	job->finished = 1;
 
+	METRIC_CALL_END(job_finished);
 	return available_cores[core_id];
 }
 
@@ -380,7 +1814,213 @@ int scheduler_job_finished(int core_id, int job_number, int time)
  */
 int scheduler_quantum_expired(int core_id, int time)
 {
-	return -1;
+	METRIC_CALL_BEGIN();
+
+	job_t *job = core_jobs[core_id];
+
+	if (current_scheme == MLFQ) {
+		mlfq_boost(time);
+
+		// Demote the job and put it behind everything else at its new level
+		if (job != NULL) {
+			int level = mlfq_level_of(job);
+			if (level < mlfq_levels - 1)
+				level++;
+			job->core_id = -1;
+			mlfq_push(job, level);
+		}
+	} else if (current_scheme == STRIDE || current_scheme == LOTTERY) {
+		// Charge the job for the quantum it used
+		if (job != NULL) {
+			job->pass += STRIDE_ONE / job->weight;
+			job->core_id = -1;
+			share_enqueue(job);
+		}
+	} else {
+		METRIC_CALL_END(quantum_expired);
+		return -1;
+	}
+
+	core_release(core_id);
+	core_jobs[core_id] = NULL;
+
+	// Refill this core before any other idle one, since the caller only
+	// learns what this core runs next
+	job_t *next = (current_scheme == MLFQ) ? mlfq_pop(core_id, job) : share_dequeue(core_id, job);
+	if (next != NULL) {
+		if (current_scheme == MLFQ)
+			mlfq_run_on(next, core_id);
+		else
+			share_run_on(next, core_id);
+	}
+
+	set_next_job(time);
+	tick(time);
+
+	METRIC_CALL_END(quantum_expired);
+	return available_cores[core_id];
+}
+
+
+/**
+  Returns the quantum the job now running on core_id should be given.
+
+  The simulator keeps the fixed RR quantum itself.
+
+  @param core_id the zero-based index of the core
+  @return the quantum of the running job's MLFQ level, or the STRIDE and
+  LOTTERY quantum
+  @return -1 if the core is idle or the scheme has no quantum here
+ */
+int scheduler_core_quantum(int core_id)
+{
+	if (core_jobs[core_id] == NULL)
+		return -1;
+
+	switch (current_scheme) {
+		case MLFQ:
+			return mlfq_quanta[mlfq_level_of(core_jobs[core_id])];
+		case STRIDE:
+		case LOTTERY:
+			return share_quantum;
+		default:
+			return -1;
+	}
+}
+
+
+/**
+  Returns the job running on a core. Under GANG one call can start
+  several jobs across several cores, so callers use this to find out
+  which.
+
+  @param core_id the zero-based index of the core
+  @return job_number of the job running on core_id, or -1 if it is idle
+ */
+int scheduler_core_job(int core_id)
+{
+	return available_cores[core_id];
+}
+
+
+/**
+  The share weight STRIDE and LOTTERY give a job of the given priority.
+  The priority value is used directly as the weight, clamped to at least 1.
+
+  @param priority the priority the job arrived with
+  @return the job's share weight
+ */
+int scheduler_share_weight(int priority)
+{
+	return priority < 1 ? 1 : priority;
+}
+
+
+/**
+  Forgets the jobs that finished before time. Every finished job otherwise
+  stays in the job queue that most calls scan, so a scheduler that runs
+  indefinitely calls this now and then to keep its calls from slowing
+  down. The waiting, turnaround and response times of the jobs let go
+  still count in the averages and scheduler_job_totals(), but the
+  percentile and deadline statistics only cover the jobs kept.
+
+  @param time the current time of the simulator. Jobs that finished in
+    this time unit are kept, since tick() still updates them.
+  @return the number of jobs let go
+ */
+int scheduler_retire_finished(int time)
+{
+	int count = priqueue_size(queue), kept = 0;
+	void **ptrs = (void **) malloc((count + 1) * sizeof(void *));
+	unsigned long *seqs = (unsigned long *) malloc((count + 1) * sizeof(unsigned long));
+	unsigned long next_seq = queue->next_seq;
+
+	for (int i=0; i<count; i++) {
+		job_t *job = (job_t *)priqueue_at(queue, i);
+
+		if (job->finished && job->end_time < time) {
+			retired.jobs++;
+			retired.waiting_time += job->end_time - job->arrival_time - job->burst_time;
+			retired.turnaround_time += job->end_time - job->arrival_time;
+			retired.response_time += job->latency_time;
+			free(job);
+		} else {
+			seqs[kept] = priqueue_seq_at(queue, i);
+			ptrs[kept++] = job;
+		}
+	}
+
+	// Rebuilt from the jobs kept, in the order they were in
+	int (*comp)(const void *, const void *) = queue->comp;
+	priqueue_destroy(queue);
+	priqueue_init(queue, comp);
+	priqueue_restore(queue, ptrs, seqs, kept, next_seq);
+
+	free(ptrs);
+	free(seqs);
+	return count - kept;
+}
+
+
+// Earliest time scheduler_rebase_time() moves an arrival back to
+#define REBASE_FLOOR (-(1 << 29))
+
+static long long gcd(long long a, long long b)
+{
+	while (b != 0) {
+		long long r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+
+/**
+  Moves the scheduler's clock back, so a caller that never stops (such as
+  the scheduler service) can keep time in an int. Every time the scheduler
+  holds is shifted by the same amount, a multiple of the MLFQ boost period
+  and the aging interval, so boosts and aging keys carry on as before.
+  Only differences between times are compared, so decisions stay the
+  same, except that deadlines ending up before the new time 0 are clamped
+  to 0, and arrivals ending up before REBASE_FLOOR are clamped to it so
+  differences between times still fit in an int.
+
+  @param time the current time of the simulator
+  @param keep about where the current time ends up, at least 1
+  @return how far time was moved back; time less this is the new current
+    time, at least keep
+ */
+int scheduler_rebase_time(int time, int keep)
+{
+	long long step = 1;
+
+	if (current_scheme == MLFQ && mlfq_boost_period > 0)
+		step = mlfq_boost_period;
+	if (aging_active)
+		step = step / gcd(step, aging_interval) * aging_interval;
+	if (time - keep < step)
+		return 0;
+
+	int shift = (time - keep) / step * step;
+
+	for (int i=0; i<priqueue_size(queue); i++) {
+		job_t *job = (job_t *)priqueue_at(queue, i);
+
+		job->arrival_time = (job->arrival_time < REBASE_FLOOR + shift) ? REBASE_FLOOR : job->arrival_time - shift;
+		if (job->finished)
+			job->end_time -= shift;
+		if (job->deadline >= 0)
+			job->deadline = (job->deadline < shift) ? 0 : job->deadline - shift;
+		if (job->expected_end > 0)
+			job->expected_end -= shift;
+		if (aging_active)
+			job->aged_key -= shift / aging_interval;
+	}
+	if (current_scheme == MLFQ && mlfq_boost_period > 0)
+		mlfq_next_boost -= shift;
+
+	return shift;
 }
 
 
@@ -394,14 +2034,14 @@ int scheduler_quantum_expired(int core_id, int time)
 float scheduler_average_waiting_time()
 {
 	job_t *job;
-	int sum = 0;
+	long long sum = retired.waiting_time;
 
 	for (int i=0; i<priqueue_size(queue); i++) {
 		job = (job_t *)priqueue_at(queue, i);
 		sum += job->end_time - job->arrival_time - job->burst_time;
 	}
 
-	return (1.0*sum)/priqueue_size(queue);
+	return (1.0*sum)/(priqueue_size(queue) + retired.jobs);
 }
 
 
@@ -415,14 +2055,14 @@ float scheduler_average_waiting_time()
 float scheduler_average_turnaround_time()
 {
 	job_t *job;
-	int sum = 0;
+	long long sum = retired.turnaround_time;
 
 	for (int i=0; i<priqueue_size(queue); i++) {
 		job = (job_t *)priqueue_at(queue, i);
 		sum += job->end_time - job->arrival_time;
 	}
 
-	return (1.0*sum)/priqueue_size(queue);
+	return (1.0*sum)/(priqueue_size(queue) + retired.jobs);
 }
 
 
@@ -436,14 +2076,132 @@ float scheduler_average_turnaround_time()
 float scheduler_average_response_time()
 {
 	job_t *job;
-	int sum = 0;
+	long long sum = retired.response_time;
 
 	for (int i=0; i<priqueue_size(queue); i++) {
 		job = (job_t *)priqueue_at(queue, i);
 		sum += job->latency_time;
 	}
 
-	return (1.0*sum)/priqueue_size(queue);
+	return (1.0*sum)/(priqueue_size(queue) + retired.jobs);
+}
+
+
+/**
+  Returns how many jobs ran on a core other than the one whose run queue
+  they were placed on. Only the WS scheme has per-core run queues, so
+  this is 0 for every other scheme.
+
+  @return the number of run queue migrations so far
+ */
+int scheduler_migrations()
+{
+	return migrations;
+}
+
+
+int lateness_comparator(const void *a, const void *b) {
+	return *(int *)a - *(int *)b;
+}
+
+/**
+  Fills stats with deadline statistics for every job that was given a
+  deadline.
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param stats destination for the statistics; all zero if no job had a deadline
+ */
+void scheduler_deadline_stats(scheduler_deadline_stats_t *stats)
+{
+	job_t *job;
+	int *lateness = (int *) malloc((priqueue_size(queue) + 1) * sizeof(int));
+	int count = 0;
+
+	memset(stats, 0, sizeof(scheduler_deadline_stats_t));
+
+	for (int i=0; i<priqueue_size(queue); i++) {
+		job = (job_t *)priqueue_at(queue, i);
+		if (job->deadline < 0)
+			continue;
+		lateness[count++] = job->end_time - job->deadline;
+		if (job->end_time > job->deadline)
+			stats->missed++;
+	}
+
+	if (count > 0) {
+		qsort(lateness, count, sizeof(int), lateness_comparator);
+		stats->jobs = count;
+		stats->miss_rate = (1.0*stats->missed)/count;
+		stats->lateness_p50 = lateness[(count - 1) * 50 / 100];
+		stats->lateness_p90 = lateness[(count - 1) * 90 / 100];
+		stats->lateness_p99 = lateness[(count - 1) * 99 / 100];
+		stats->max_lateness = lateness[count - 1];
+	}
+
+	free(lateness);
+}
+
+
+/**
+  Fills totals with the sums behind scheduler_average_waiting_time(),
+  scheduler_average_turnaround_time() and scheduler_average_response_time().
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param totals destination for the sums
+ */
+void scheduler_job_totals(scheduler_job_totals_t *totals)
+{
+	job_t *job;
+
+	*totals = retired;
+	totals->jobs += priqueue_size(queue);
+	for (int i=0; i<priqueue_size(queue); i++) {
+		job = (job_t *)priqueue_at(queue, i);
+		totals->waiting_time += job->end_time - job->arrival_time - job->burst_time;
+		totals->turnaround_time += job->end_time - job->arrival_time;
+		totals->response_time += job->latency_time;
+	}
+}
+
+
+/**
+  Fills stats with waiting time statistics over every job, and the aging
+  overtake window (see scheduler_configure_aging()).
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param stats destination for the statistics
+ */
+void scheduler_waiting_stats(scheduler_waiting_stats_t *stats)
+{
+	job_t *job;
+	int *waiting = (int *) malloc((priqueue_size(queue) + 1) * sizeof(int));
+	int count = priqueue_size(queue);
+
+	memset(stats, 0, sizeof(scheduler_waiting_stats_t));
+
+	for (int i=0; i<count; i++) {
+		job = (job_t *)priqueue_at(queue, i);
+		waiting[i] = job->end_time - job->arrival_time - job->burst_time;
+	}
+
+	if (count > 0) {
+		qsort(waiting, count, sizeof(int), lateness_comparator);
+		stats->jobs = count;
+		stats->waiting_p50 = waiting[(count - 1) * 50 / 100];
+		stats->waiting_p90 = waiting[(count - 1) * 90 / 100];
+		stats->waiting_p99 = waiting[(count - 1) * 99 / 100];
+		stats->max_waiting = waiting[count - 1];
+	}
+
+	if (aging_active && aging_base_min <= aging_base_max)
+		stats->overtake_window = (aging_base_max - aging_base_min + 1) * aging_interval;
+	else
+		stats->overtake_window = -1;
+
+	free(waiting);
 }
 
 
@@ -460,6 +2218,487 @@ void scheduler_clean_up()
 	}
 	free(queue);
 	free(available_cores);
+	free(core_jobs);
+	priqueue_destroy(&ready_queue);
+	priqueue_destroy(&ready_running);
+	priqueue_destroy(&gang_running);
+	free(lottery_slot_jobs);
+	free(lottery_tree);
+	idle_destroy();
+	if (core_queues != NULL) {
+		for (int i=0; i<num_cores; i++) {
+			priqueue_destroy(&core_queues[i]);
+		}
+		free(core_queues);
+	}
+}
+
+
+/**
+  A job as saved in a snapshot. The job it links to in its MLFQ level is
+  saved as a job number, -1 for none, and gang_cores is 1 when the cores
+  it holds follow the records.
+*/
+typedef struct _job_record_t
+{
+	int job_id, priority, core_id, burst_time;
+	int arrival_time, latency_time, running_time, end_time;
+	int finished, level, mlfq_epoch, next;
+	int home_core, deadline, weight, aged_key;
+	int last_core, width, expected_end, gang_cores;
+	long long pass, share_slot;	// Both wide so the record has no padding
+
+} job_record_t;
+
+int snapshot_job_number(job_t *job) {
+	return (job == NULL) ? -1 : job->job_id;
+}
+
+job_t *snapshot_job(job_t **by_number, int numbers, int job_number) {
+	return (job_number < 0 || job_number >= numbers) ? NULL : by_number[job_number];
+}
+
+int SNAPSHOT_ARRIVAL_comparator(const void *thing1, const void *thing2) {
+	job_t *this = *(job_t **)thing1;
+	job_t *that = *(job_t **)thing2;
+
+	if (this->arrival_time == that->arrival_time)
+		return (this->job_id - that->job_id);
+	return (this->arrival_time - that->arrival_time);
+}
+
+void snapshot_put_queue(snapshot_t *snapshot, priqueue_t *q) {
+	int length = priqueue_size(q);
+
+	SNAPSHOT_PUT(snapshot, length);
+	SNAPSHOT_PUT(snapshot, q->next_seq);
+	for (int i=0; i<length; i++) {
+		int job_number = snapshot_job_number((job_t *)priqueue_at(q, i));
+		unsigned long seq = priqueue_seq_at(q, i);
+		SNAPSHOT_PUT(snapshot, job_number);
+		SNAPSHOT_PUT(snapshot, seq);
+	}
+}
+
+int snapshot_get_queue(snapshot_t *snapshot, priqueue_t *q, job_t **by_number, int numbers) {
+	int length;
+	unsigned long next_seq;
+
+	SNAPSHOT_GET(snapshot, length);
+	SNAPSHOT_GET(snapshot, next_seq);
+	if (snapshot->failed || length < 0 || length > numbers)
+		return -1;
+
+	void **ptrs = (void **) malloc((length + 1) * sizeof(void *));
+	unsigned long *seqs = (unsigned long *) malloc((length + 1) * sizeof(unsigned long));
+	int valid = 1;
+	for (int i=0; i<length; i++) {
+		int job_number;
+		SNAPSHOT_GET(snapshot, job_number);
+		SNAPSHOT_GET(snapshot, seqs[i]);
+		ptrs[i] = snapshot_job(by_number, numbers, job_number);
+		if (ptrs[i] == NULL)
+			valid = 0;
+	}
+
+	if (valid && !snapshot->failed)
+		priqueue_restore(q, ptrs, seqs, length, next_seq);
+	free(ptrs);
+	free(seqs);
+	return (valid && !snapshot->failed) ? 0 : -1;
+}
+
+/**
+  Appends the scheduler's configuration and complete state to a snapshot:
+  every job it has seen, which core runs what and the order of every
+  queue. The hot-path counters are not saved; a restored scheduler counts
+  from zero.
+
+  @param snapshot a snapshot started with snapshot_init()
+ */
+void scheduler_snapshot_save(snapshot_t *snapshot)
+{
+	int scheme = current_scheme;
+	int placement = ws_placement;
+	int count = priqueue_size(queue);
+	int has_core_queues = (core_queues != NULL);
+
+	SNAPSHOT_PUT(snapshot, scheme);
+	SNAPSHOT_PUT(snapshot, num_cores);
+
+	// Configuration
+	SNAPSHOT_PUT(snapshot, mlfq_levels);
+	SNAPSHOT_PUT(snapshot, mlfq_quanta);
+	SNAPSHOT_PUT(snapshot, mlfq_boost_period);
+	SNAPSHOT_PUT(snapshot, placement);
+	SNAPSHOT_PUT(snapshot, share_quantum);
+	SNAPSHOT_PUT(snapshot, random_seed);
+	SNAPSHOT_PUT(snapshot, affinity_window);
+	SNAPSHOT_PUT(snapshot, aging_interval);
+	SNAPSHOT_PUT(snapshot, topology_cores);
+	snapshot_put(snapshot, core_llc, topology_cores * sizeof(int));
+	snapshot_put(snapshot, core_node, topology_cores * sizeof(int));
+	SNAPSHOT_PUT(snapshot, speed_cores);
+	snapshot_put(snapshot, core_speed, speed_cores * sizeof(int));
+
+	// Running state
+	SNAPSHOT_PUT(snapshot, random_state);
+	SNAPSHOT_PUT(snapshot, mlfq_epoch);
+	SNAPSHOT_PUT(snapshot, mlfq_next_boost);
+	SNAPSHOT_PUT(snapshot, share_virtual_time);
+	SNAPSHOT_PUT(snapshot, lottery_tickets);
+	SNAPSHOT_PUT(snapshot, speed_key_sum);
+	SNAPSHOT_PUT(snapshot, speed_key_count);
+	SNAPSHOT_PUT(snapshot, aging_base_min);
+	SNAPSHOT_PUT(snapshot, aging_base_max);
+	SNAPSHOT_PUT(snapshot, ws_next_core);
+	SNAPSHOT_PUT(snapshot, migrations);
+	SNAPSHOT_PUT(snapshot, retired);
+
+	// Jobs, in queue order
+	SNAPSHOT_PUT(snapshot, count);
+	for (int i=0; i<count; i++) {
+		job_t *job = (job_t *)priqueue_at(queue, i);
+		job_record_t record = {
+			job->job_id, job->priority, job->core_id, job->burst_time,
+			job->arrival_time, job->latency_time, job->running_time, job->end_time,
+			job->finished, job->level, job->mlfq_epoch, snapshot_job_number(job->next),
+			job->home_core, job->deadline, job->weight, job->aged_key,
+			job->last_core, job->width, job->expected_end, job->gang_cores != NULL,
+			job->pass, job->share_slot
+		};
+		SNAPSHOT_PUT(snapshot, record);
+	}
+	for (int i=0; i<count; i++) {
+		job_t *job = (job_t *)priqueue_at(queue, i);
+		if (job->gang_cores != NULL)
+			snapshot_put(snapshot, job->gang_cores, job->width * sizeof(int));
+	}
+
+	// Cores and queues
+	snapshot_put(snapshot, available_cores, num_cores * sizeof(int));
+	for (int i=0; i<num_cores; i++) {
+		int job_number = snapshot_job_number(core_jobs[i]);
+		SNAPSHOT_PUT(snapshot, job_number);
+	}
+	for (int level=0; level<mlfq_levels; level++) {
+		int head = snapshot_job_number(mlfq_ready[level].head);
+		int tail = snapshot_job_number(mlfq_ready[level].tail);
+		SNAPSHOT_PUT(snapshot, head);
+		SNAPSHOT_PUT(snapshot, tail);
+	}
+	snapshot_put_queue(snapshot, &ready_queue);
+	snapshot_put_queue(snapshot, &gang_running);
+	SNAPSHOT_PUT(snapshot, has_core_queues);
+	for (int i=0; i<num_cores && has_core_queues; i++) {
+		snapshot_put_queue(snapshot, &core_queues[i]);
+	}
+}
+
+/**
+  Starts the scheduler up from a snapshot, either exactly as it was or,
+  when forking, under scheme with the jobs the snapshot holds.
+*/
+int snapshot_restore(snapshot_t *snapshot, int fork, scheme_t scheme, int time) {
+	int saved_scheme, cores, levels, quanta[MLFQ_MAX_LEVELS], boost, placement, quantum;
+	int window, interval, llc_cores, speeds;
+	unsigned int seed;
+
+	SNAPSHOT_GET(snapshot, saved_scheme);
+	SNAPSHOT_GET(snapshot, cores);
+	SNAPSHOT_GET(snapshot, levels);
+	SNAPSHOT_GET(snapshot, quanta);
+	SNAPSHOT_GET(snapshot, boost);
+	SNAPSHOT_GET(snapshot, placement);
+	SNAPSHOT_GET(snapshot, quantum);
+	SNAPSHOT_GET(snapshot, seed);
+	SNAPSHOT_GET(snapshot, window);
+	SNAPSHOT_GET(snapshot, interval);
+	SNAPSHOT_GET(snapshot, llc_cores);
+	if (snapshot->failed || cores < 1 || levels < 1 || levels > MLFQ_MAX_LEVELS
+		|| saved_scheme < FCFS || saved_scheme > GANG || llc_cores < 0 || llc_cores > cores)
+		return -1;
+
+	int *llc = (int *) malloc((llc_cores + 1) * sizeof(int));
+	int *node = (int *) malloc((llc_cores + 1) * sizeof(int));
+	snapshot_get(snapshot, llc, llc_cores * sizeof(int));
+	snapshot_get(snapshot, node, llc_cores * sizeof(int));
+	SNAPSHOT_GET(snapshot, speeds);
+	if (snapshot->failed || speeds < 0 || speeds > cores) {
+		free(llc);
+		free(node);
+		return -1;
+	}
+	int *speed = (int *) malloc((speeds + 1) * sizeof(int));
+	snapshot_get(snapshot, speed, speeds * sizeof(int));
+
+	// A fork keeps the scheme settings the caller configured
+	if (!fork) {
+		scheme = saved_scheme;
+		scheduler_configure_mlfq(levels, quanta, boost);
+		scheduler_configure_ws(placement, seed);
+		scheduler_configure_share(quantum, seed);
+	}
+	scheduler_configure_affinity(window);
+	scheduler_configure_aging(interval);
+	if (llc_cores > 0)
+		scheduler_configure_topology(llc_cores, llc, node);
+	if (speeds > 0)
+		scheduler_configure_speeds(speeds, speed);
+	free(llc);
+	free(node);
+	free(speed);
+
+	scheduler_start_up(cores, scheme);
+
+	unsigned int state;
+	int epoch, next_boost, tickets, base_min, base_max, next_core, migrated;
+	scheduler_job_totals_t let_go;
+	long long virtual_time, key_sum, key_count;
+
+	SNAPSHOT_GET(snapshot, state);
+	SNAPSHOT_GET(snapshot, epoch);
+	SNAPSHOT_GET(snapshot, next_boost);
+	SNAPSHOT_GET(snapshot, virtual_time);
+	SNAPSHOT_GET(snapshot, tickets);
+	SNAPSHOT_GET(snapshot, key_sum);
+	SNAPSHOT_GET(snapshot, key_count);
+	SNAPSHOT_GET(snapshot, base_min);
+	SNAPSHOT_GET(snapshot, base_max);
+	SNAPSHOT_GET(snapshot, next_core);
+	SNAPSHOT_GET(snapshot, migrated);
+	SNAPSHOT_GET(snapshot, let_go);
+
+	speed_key_sum = key_sum;
+	speed_key_count = key_count;
+	migrations = migrated;
+	retired = let_go;
+	if (!fork) {
+		random_state = state;
+		mlfq_epoch = epoch;
+		mlfq_next_boost = next_boost;
+		share_virtual_time = virtual_time;
+		lottery_tickets = tickets;
+		aging_base_min = base_min;
+		aging_base_max = base_max;
+		ws_next_core = next_core;
+	}
+
+	int count;
+	SNAPSHOT_GET(snapshot, count);
+	if (snapshot->failed || count < 0
+		|| (size_t)count > (snapshot->size - snapshot->offset) / sizeof(job_record_t))
+		return -1;
+
+	job_record_t *records = (job_record_t *) malloc((count + 1) * sizeof(job_record_t));
+	job_t **jobs = (job_t **) malloc((count + 1) * sizeof(job_t *));
+	snapshot_get(snapshot, records, count * sizeof(job_record_t));
+
+	int numbers = 0;
+	for (int i=0; i<count; i++) {
+		if (records[i].job_id < 0 || records[i].width < 1 || records[i].width > cores) {
+			free(records);
+			free(jobs);
+			return -1;
+		}
+		if (records[i].job_id >= numbers)
+			numbers = records[i].job_id + 1;
+	}
+
+	job_t **by_number = (job_t **) calloc(numbers + 1, sizeof(job_t *));
+	int valid = 1;
+	for (int i=0; i<count; i++) {
+		job_record_t *record = &records[i];
+		job_t *job = create_job(record->job_id, record->arrival_time, record->burst_time, record->priority);
+
+		job->core_id = record->core_id;
+		job->latency_time = record->latency_time;
+		job->running_time = record->running_time;
+		job->end_time = record->end_time;
+		job->finished = record->finished;
+		job->level = record->level;
+		job->mlfq_epoch = record->mlfq_epoch;
+		job->home_core = record->home_core;
+		job->deadline = record->deadline;
+		job->weight = record->weight;
+		job->pass = record->pass;
+		job->share_slot = record->share_slot;
+		job->aged_key = record->aged_key;
+		job->last_core = record->last_core;
+		job->width = record->width;
+		job->expected_end = record->expected_end;
+		if (record->gang_cores) {
+			job->gang_cores = (int *) malloc(job->width * sizeof(int));
+			snapshot_get(snapshot, job->gang_cores, job->width * sizeof(int));
+		}
+
+		if (by_number[job->job_id] != NULL)
+			valid = 0;
+		by_number[job->job_id] = job;
+		jobs[i] = job;
+	}
+	for (int i=0; i<count; i++) {
+		jobs[i]->next = snapshot_job(by_number, numbers, records[i].next);
+		if (records[i].level < 0 || records[i].level >= MLFQ_MAX_LEVELS)
+			valid = 0;
+	}
+	free(records);
+
+	if (!valid || snapshot->failed) {
+		free(jobs);
+		free(by_number);
+		return -1;
+	}
+
+	if (!fork) {
+		// Everything goes back where it was, queues in their saved order
+		priqueue_restore(queue, (void **)jobs, NULL, count, 0);
+
+		int *running = (int *) malloc(num_cores * sizeof(int));
+		snapshot_get(snapshot, running, num_cores * sizeof(int));
+		for (int i=0; i<num_cores && !snapshot->failed; i++) {
+			if (running[i] >= 0)
+				core_assign(i, running[i]);
+		}
+		free(running);
+
+		for (int i=0; i<num_cores; i++) {
+			int job_number;
+			SNAPSHOT_GET(snapshot, job_number);
+			core_jobs[i] = snapshot_job(by_number, numbers, job_number);
+		}
+		for (int level=0; level<mlfq_levels; level++) {
+			int head, tail;
+			SNAPSHOT_GET(snapshot, head);
+			SNAPSHOT_GET(snapshot, tail);
+			mlfq_ready[level].head = snapshot_job(by_number, numbers, head);
+			mlfq_ready[level].tail = snapshot_job(by_number, numbers, tail);
+		}
+
+		int has_core_queues;
+		if (snapshot_get_queue(snapshot, &ready_queue, by_number, numbers) != 0
+			|| snapshot_get_queue(snapshot, &gang_running, by_number, numbers) != 0
+			|| SNAPSHOT_GET(snapshot, has_core_queues) != 0
+			|| has_core_queues != (core_queues != NULL))
+			valid = 0;
+		for (int i=0; i<num_cores && valid && has_core_queues; i++) {
+			if (snapshot_get_queue(snapshot, &core_queues[i], by_number, numbers) != 0)
+				valid = 0;
+		}
+
+		// ready_running is ordered by core among equals, so it comes out
+		// the same however it is filled
+		for (int i=0; i<num_cores && (aging_active || current_scheme == EDF); i++) {
+			if (core_jobs[i] != NULL)
+				priqueue_offer(&ready_running, core_jobs[i]);
+		}
+
+		// LOTTERY's waiting jobs go back in the slots they held. Only the
+		// order of the slots matters to a draw, so the tree need not be as
+		// large as it was.
+		if (current_scheme == LOTTERY) {
+			for (int i=0; i<count; i++) {
+				if (jobs[i]->share_slot < 0)
+					valid = 0;
+				else if (!jobs[i]->finished && jobs[i]->share_slot >= lottery_next_slot)
+					lottery_next_slot = jobs[i]->share_slot + 1;
+			}
+			lottery_capacity = 64;
+			while (lottery_capacity < lottery_next_slot)
+				lottery_capacity *= 2;
+			lottery_slot_jobs = (job_t **) calloc(lottery_capacity, sizeof(job_t *));
+			lottery_tree = (int *) calloc(lottery_capacity + 1, sizeof(int));
+
+			for (int i=0; i<count && valid; i++) {
+				job_t *job = jobs[i];
+				if (job->finished || job->core_id >= 0)
+					continue;
+				if (lottery_slot_jobs[job->share_slot] != NULL)
+					valid = 0;
+				lottery_slot_jobs[job->share_slot] = job;
+				lottery_tree_add(job->share_slot, job->weight);
+			}
+		}
+	} else {
+		// Jobs that are done only count towards the averages. The rest give
+		// up their cores and arrive again, in arrival order, under the new
+		// scheme with the time they already ran and waited kept.
+		job_t **waiting = (job_t **) malloc((count + 1) * sizeof(job_t *));
+		int finished = 0, arrived = 0;
+
+		for (int i=0; i<count; i++) {
+			job_t *job = jobs[i];
+
+			job->core_id = -1;
+			job->level = 0;
+			job->mlfq_epoch = 0;
+			job->next = NULL;
+			job->home_core = -1;
+			job->pass = 0;
+			job->aged_key = 0;
+			job->expected_end = 0;
+			free(job->gang_cores);
+			job->gang_cores = NULL;
+
+			if (job->finished)
+				jobs[finished++] = job;
+			else
+				waiting[arrived++] = job;
+		}
+		qsort(waiting, arrived, sizeof(job_t *), SNAPSHOT_ARRIVAL_comparator);
+
+		priqueue_offer_all(queue, (void **)jobs, finished);
+		priqueue_offer_all(queue, (void **)waiting, arrived);
+
+		if (scheme_places_jobs()) {
+			for (int i=0; i<arrived; i++)
+				place_job(waiting[i], time);
+		} else {
+			set_next_job(time);
+		}
+		tick(time);
+		free(waiting);
+	}
+
+	free(jobs);
+	free(by_number);
+	return (valid && !snapshot->failed) ? 0 : -1;
+}
+
+/**
+  Starts the scheduler up exactly as it was when scheduler_snapshot_save()
+  wrote the snapshot, configuration included. Call it instead of
+  scheduler_start_up(), with the snapshot read up to where the scheduler's
+  part begins.
+
+  @param snapshot a snapshot read with snapshot_read()
+  @return 0 on success
+  @return -1 if the snapshot is damaged; the scheduler must not be used
+ */
+int scheduler_snapshot_load(snapshot_t *snapshot)
+{
+	return snapshot_restore(snapshot, 0, FCFS, 0);
+}
+
+/**
+  Starts the scheduler up under scheme from a snapshot taken under any
+  scheme, for what-if runs that share the snapshot's past. The MLFQ, WS
+  and share settings configured before the call apply; topology, speeds,
+  affinity and aging come from the snapshot. Jobs that had finished keep
+  their statistics. The others leave their cores and are admitted again
+  at time in arrival order, keeping their arrival time and, if they had
+  started, their response time; scheduler_core_job() tells the caller
+  where each one runs now.
+
+  @param snapshot a snapshot read with snapshot_read()
+  @param scheme the scheme to go on with
+  @param time the time the snapshot was taken at
+  @return 0 on success
+  @return -1 if the snapshot is damaged; the scheduler must not be used
+ */
+int scheduler_snapshot_fork(snapshot_t *snapshot, scheme_t scheme, int time)
+{
+	return snapshot_restore(snapshot, 1, scheme, time);
 }
 
 
@@ -478,3 +2717,27 @@ void scheduler_show_queue()
 {
 
 }
+
+
+/**
+  Copies the hot-path counters gathered so far into metrics_out.
+
+  When the library was built without SCHEDULER_METRICS, metrics_out is zeroed
+  and metrics_out->enabled is set to 0.
+
+  @param metrics_out destination for the counters
+ */
+void scheduler_get_metrics(scheduler_metrics_t *metrics_out)
+{
+#ifdef SCHEDULER_METRICS
+	*metrics_out = metrics;
+	metrics_out->enabled = 1;
+	metrics_out->comparisons += priqueue_metrics.comparisons;
+	metrics_out->queue_offers = priqueue_metrics.offers;
+	metrics_out->queue_polls = priqueue_metrics.polls;
+	metrics_out->queue_removes = priqueue_metrics.removes;
+	metrics_out->queue_bytes_copied = priqueue_metrics.bytes_copied;
+#else
+	memset(metrics_out, 0, sizeof(scheduler_metrics_t));
+#endif
+}
@@ -4,20 +4,187 @@
 #ifndef LIBSCHEDULER_H_
 #define LIBSCHEDULER_H_
 
+#include "../libsnapshot/libsnapshot.h"
+
 /**
   Constants which represent the different scheduling algorithms
 */
-typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR} scheme_t;
+typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR, MLFQ, WS, EDF, STRIDE, LOTTERY, GANG} scheme_t;
+
+/**
+  How the WS scheme picks the run queue a new job is placed on
+*/
+typedef enum {PLACE_ROUND_ROBIN = 0, PLACE_LEAST_LOADED, PLACE_TWO_CHOICES} placement_t;
+
+// Upper bound on the number of MLFQ levels
+#define MLFQ_MAX_LEVELS 16
+
+// Speed of a nominal core, see scheduler_configure_speeds()
+#define CORE_SPEED_ONE 1000
+
+// STRIDE pass advance per quantum for a job of weight 1
+#define STRIDE_ONE (1 << 20)
+
+/**
+  One entry of a scheduler_new_jobs() batch. deadline is the absolute time
+  the job should finish by, or -1 for none. cores is how many cores the
+  job needs at once, which only GANG reads. core_id is filled in by the
+  scheduler; for a job on several cores it is the lowest of them.
+*/
+typedef struct _scheduler_new_job_t
+{
+  int job_number;
+  int running_time;
+  int priority;
+  int deadline;
+  int cores;
+  int core_id;
 
+} scheduler_new_job_t;
+
+/**
+  Deadline statistics over the jobs that had a deadline. Lateness is the
+  finish time minus the deadline, so early jobs have negative lateness.
+*/
+typedef struct _scheduler_deadline_stats_t
+{
+  int jobs;             // Jobs with a deadline
+  int missed;           // Jobs that finished after their deadline
+  float miss_rate;
+  float lateness_p50;
+  float lateness_p90;
+  float lateness_p99;
+  int max_lateness;
+
+} scheduler_deadline_stats_t;
+
+/**
+  Waiting time statistics over all jobs. overtake_window bounds how much
+  later than a waiting job another job can arrive and still run first; it
+  is -1 when aging is off and later arrivals can overtake indefinitely.
+*/
+typedef struct _scheduler_waiting_stats_t
+{
+  int jobs;
+  float waiting_p50;
+  float waiting_p90;
+  float waiting_p99;
+  int max_waiting;
+  int overtake_window;
+
+} scheduler_waiting_stats_t;
+
+/**
+  The sums the scheduler_average_* functions divide by the job count, so
+  runs over disjoint sets of jobs can be averaged together exactly.
+*/
+typedef struct _scheduler_job_totals_t
+{
+  int jobs;
+  long long waiting_time;
+  long long turnaround_time;
+  long long response_time;
+
+} scheduler_job_totals_t;
+
+/**
+  Call count and accumulated cycles for one scheduler API entry point.
+*/
+typedef struct _scheduler_call_metrics_t
+{
+  unsigned long long calls;
+  unsigned long long cycles;
+
+} scheduler_call_metrics_t;
+
+/**
+  Hot-path counters collected by libscheduler and libpriqueue. The counters
+  are only compiled in when the build defines SCHEDULER_METRICS
+  (make METRICS=1); otherwise scheduler_get_metrics() reports enabled == 0
+  and every field is zero.
+*/
+typedef struct _scheduler_metrics_t
+{
+  int enabled;
+
+  // libpriqueue
+  unsigned long long comparisons;
+  unsigned long long queue_offers;
+  unsigned long long queue_polls;
+  unsigned long long queue_removes;
+  unsigned long long queue_bytes_copied;
+
+  // libscheduler
+  unsigned long long preemptions;
+  unsigned long long context_switches;
+  unsigned long long ticks;
+  unsigned long long tick_jobs_scanned;
+  unsigned long long tick_cycles;
+
+  scheduler_call_metrics_t new_job;
+  scheduler_call_metrics_t new_jobs;
+  scheduler_call_metrics_t job_finished;
+  scheduler_call_metrics_t quantum_expired;
+
+} scheduler_metrics_t;
+
+void  scheduler_configure_mlfq         (int levels, const int *quanta, int boost_period);
+void  scheduler_configure_ws           (placement_t placement, unsigned int seed);
+void  scheduler_configure_share        (int quantum, unsigned int seed);
+void  scheduler_configure_aging        (int interval);
+void  scheduler_configure_affinity     (int window);
+void  scheduler_configure_topology     (int cores, const int *llc, const int *node);
+void  scheduler_configure_speeds       (int cores, const int *speeds);
 void  scheduler_start_up               (int cores, scheme_t scheme);
 int   scheduler_new_job                (int job_number, int time, int running_time, int priority);
+int   scheduler_new_jobs               (scheduler_new_job_t *batch, int count, int time);
+void *scheduler_waiting_job            (int job_number, int time, int running_time, int priority);
+int   scheduler_waiting_job_number     (const void *job);
+int   scheduler_compare_waiting        (const void *job1, const void *job2);
 int   scheduler_job_finished           (int core_id, int job_number, int time);
 int   scheduler_quantum_expired        (int core_id, int time);
+int   scheduler_core_quantum           (int core_id);
+int   scheduler_core_job               (int core_id);
+int   scheduler_share_weight           (int priority);
 float scheduler_average_turnaround_time();
 float scheduler_average_waiting_time   ();
 float scheduler_average_response_time  ();
+int   scheduler_migrations             ();
+void  scheduler_deadline_stats         (scheduler_deadline_stats_t *stats);
+void  scheduler_waiting_stats          (scheduler_waiting_stats_t *stats);
+void  scheduler_job_totals             (scheduler_job_totals_t *totals);
+int   scheduler_retire_finished        (int time);
+int   scheduler_rebase_time            (int time, int keep);
+void  scheduler_snapshot_save          (snapshot_t *snapshot);
+int   scheduler_snapshot_load          (snapshot_t *snapshot);
+int   scheduler_snapshot_fork          (snapshot_t *snapshot, scheme_t scheme, int time);
 void  scheduler_clean_up               ();
 
 void  scheduler_show_queue             ();
 
+void  scheduler_get_metrics            (scheduler_metrics_t *metrics);
+
+#ifdef SCHEDULER_METRICS
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/**
+  Reads a cheap monotonically increasing cycle counter. Falls back to
+  nanoseconds on targets without a time stamp counter.
+*/
+static inline unsigned long long scheduler_metrics_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+#endif
+
 #endif /* LIBSCHEDULER_H_ */
@@ -0,0 +1,375 @@
+/** @file libserver.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+
+#include "libserver.h"
+#include "../libservice/libservice.h"
+
+
+/**
+  State of the scheduler service (-L), shared by every client.
+*/
+typedef struct _server_state_t
+{
+	int cores, scheme, quantum;
+	int32_t wire;	// Latest time unit a message has been stamped with
+	int time;	// The same time unit on the scheduler's clock
+	long long rebased;	// Time units the scheduler's clock has been moved back
+	int *known;	// Job each core was last reported to run
+	char *touched;	// Cores named by the message being answered
+	scheduler_new_job_t *batch;
+	long long messages, arrivals, finished, expired, rejected;
+	long long retire_at;	// Finished jobs that trigger the next retirement
+	long long answer_ns;	// Time spent answering messages
+} server_state_t;
+
+/**
+  One connection to the service and the bytes on their way to and from it.
+*/
+typedef struct _server_client_t
+{
+	int fd;
+	service_buffer_t in, out;
+	int closing;	// The client closed its end, answers still going out
+} server_client_t;
+
+static volatile sig_atomic_t server_stopping = 0;
+
+static void server_stop(int signal_number)
+{
+	server_stopping = 1;
+}
+
+static long long server_clock()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+  Quantum a core's clock is armed with when it is given a job, -1 for
+  schemes that never expire one.
+ */
+static int server_quantum(server_state_t *s, int core_id)
+{
+	if (s->scheme == MLFQ)
+		return scheduler_core_quantum(core_id);
+	if (s->scheme == RR || s->scheme == STRIDE || s->scheme == LOTTERY)
+		return s->quantum;
+	return -1;
+}
+
+/**
+  Hands the records of one message to the scheduler and appends the
+  answer to out: the job now on every core whose job changed, and on every
+  core the message named. A record the scheduler cannot take, such as a
+  completion of a job that is not on the core given, is left out and
+  counted as rejected. Time never goes backwards; a message stamped
+  earlier than one before it happens at the later time.
+
+  Message times are compared as serial numbers, so they may wrap around
+  past the largest int32_t, as long as no message is SERVER_REBASE_TIME
+  or more time units ahead of the one before.
+
+  @return 0 on success, -1 if the message is not a request
+ */
+static int server_answer(server_state_t *s, service_header_t *h, void *records, service_buffer_t *out)
+{
+	int i, n = 0;
+	int32_t step = (int32_t)((uint32_t)h->time - (uint32_t)s->wire);
+
+	if (step >= SERVER_REBASE_TIME)
+		return -1;
+	if (step > 0)
+	{
+		if (s->time > SERVER_REBASE_TIME)
+		{
+			int shift = scheduler_rebase_time(s->time, SERVER_REBASE_TIME / 2);
+			s->time -= shift;
+			s->rebased += shift;
+		}
+		s->time += step;
+		s->wire = h->time;
+	}
+	memset(s->touched, 0, s->cores);
+
+	if (h->type == SERVICE_ARRIVALS)
+	{
+		service_arrival_t *arrival = records;
+
+		for (i = 0; i < h->count; i++)
+		{
+			int32_t until = (int32_t)((uint32_t)arrival[i].deadline - (uint32_t)s->wire);
+
+			if (arrival[i].running_time < 1 || arrival[i].running_time >= SERVER_REBASE_TIME
+					|| arrival[i].cores < 1 || arrival[i].cores > s->cores
+					|| (arrival[i].deadline != -1 && (until <= -SERVER_REBASE_TIME || until >= SERVER_REBASE_TIME)))
+			{
+				s->rejected++;
+				continue;
+			}
+			s->batch[n].job_number = arrival[i].job_number;
+			s->batch[n].running_time = arrival[i].running_time;
+			s->batch[n].priority = arrival[i].priority;
+			if (arrival[i].deadline == -1)
+				s->batch[n].deadline = -1;
+			else
+				s->batch[n].deadline = (s->time + until < 0) ? 0 : s->time + until;
+			s->batch[n].cores = arrival[i].cores;
+			n++;
+		}
+		if (n > 0)
+			scheduler_new_jobs(s->batch, n, s->time);
+		s->arrivals += n;
+	}
+	else if (h->type == SERVICE_FINISHED || h->type == SERVICE_EXPIRED)
+	{
+		service_event_t *event = records;
+
+		for (i = 0; i < h->count; i++)
+		{
+			int core = event[i].core_id;
+			int job = (core >= 0 && core < s->cores) ? scheduler_core_job(core) : -1;
+
+			if (job < 0 || (h->type == SERVICE_FINISHED && job != event[i].job_number)
+					|| (h->type == SERVICE_EXPIRED && server_quantum(s, core) < 0))
+			{
+				s->rejected++;
+				continue;
+			}
+
+			if (h->type == SERVICE_FINISHED)
+			{
+				scheduler_job_finished(core, job, s->time);
+				s->finished++;
+			}
+			else
+			{
+				scheduler_quantum_expired(core, s->time);
+				s->expired++;
+			}
+			s->touched[core] = 1;
+		}
+	}
+	else
+		return -1;
+
+	n = 0;
+	for (i = 0; i < s->cores; i++)
+		if (s->touched[i] || scheduler_core_job(i) != s->known[i])
+			n++;
+
+	service_assignment_t *assignment = service_append(out, SERVICE_ASSIGNMENTS, s->wire, n);
+	for (i = 0; i < s->cores; i++)
+	{
+		int job = scheduler_core_job(i);
+
+		if (!s->touched[i] && job == s->known[i])
+			continue;
+		assignment->core_id = i;
+		assignment->job_number = job;
+		assignment->quantum = (job >= 0) ? server_quantum(s, i) : -1;
+		assignment++;
+		s->known[i] = job;
+	}
+
+	/*
+	 * Finished jobs would otherwise be scanned by every call from here on.
+	 * Retiring once as many have finished as are still held keeps the
+	 * queue under twice the jobs in flight, for a constant cost per job.
+	 */
+	if (s->finished >= s->retire_at)
+	{
+		long long held = s->arrivals - s->finished;
+
+		scheduler_retire_finished(s->time);
+		s->retire_at = s->finished + ((held > SERVER_RETIRE_JOBS) ? held : SERVER_RETIRE_JOBS);
+	}
+
+	s->messages++;
+	return 0;
+}
+
+static void server_close(server_client_t *clients, int *count, int index)
+{
+	close(clients[index].fd);
+	service_buffer_destroy(&clients[index].in);
+	service_buffer_destroy(&clients[index].out);
+	clients[index] = clients[--*count];
+}
+
+/**
+  Serves the scheduler (-L) on a Unix domain socket at path, which the
+  scheduler must already have been started up for, until SIGINT or
+  SIGTERM. Clients send arrivals, completions and quantum expiries as
+  service_header_t messages, as many at once as they like, and get one
+  SERVICE_ASSIGNMENTS message back for each, in order. Every client drives
+  the same scheduler, but only hears of the assignments its own messages
+  led to, so one client normally does the dispatching.
+
+  @return the simulator's exit status
+ */
+int server_run(const char *path, int cores, int scheme, int quantum)
+{
+	server_state_t s;
+	server_client_t *clients = NULL;
+	struct pollfd *fds = NULL;
+	int count = 0, size = 0, connections = 0, i;
+	struct sigaction action;
+
+	int listener = service_listen(path);
+	if (listener < 0)
+	{
+		if (EEXIST == errno)
+			fprintf(stderr, "Unable to listen on \"%s\": it exists and is not a socket.\n", path);
+		else if (EADDRINUSE == errno)
+			fprintf(stderr, "Unable to listen on \"%s\": another service is listening on it.\n", path);
+		else
+			fprintf(stderr, "Unable to listen on \"%s\": %s.\n", path, strerror(errno));
+		return 2;
+	}
+	fcntl(listener, F_SETFL, O_NONBLOCK);
+
+	// No SA_RESTART, so poll() returns when the service is told to stop
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = server_stop;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	memset(&s, 0, sizeof(s));
+	s.cores = cores;
+	s.scheme = scheme;
+	s.quantum = quantum;
+	s.known = malloc(cores * sizeof(int));
+	s.touched = malloc(cores);
+	s.batch = malloc(SERVICE_MAX_RECORDS * sizeof(scheduler_new_job_t));
+	s.retire_at = SERVER_RETIRE_JOBS;
+	for (i = 0; i < cores; i++)
+		s.known[i] = scheduler_core_job(i);
+
+	printf("Listening on \"%s\".\n", path);
+	fflush(stdout);
+	long long start = server_clock();
+
+	while (!server_stopping)
+	{
+		if (count + 1 > size)
+		{
+			size = (size == 0) ? 16 : size * 2;
+			clients = realloc(clients, size * sizeof(server_client_t));
+			fds = realloc(fds, (size + 1) * sizeof(struct pollfd));
+		}
+
+		fds[0].fd = listener;
+		fds[0].events = POLLIN;
+		for (i = 0; i < count; i++)
+		{
+			size_t unsent = service_pending(&clients[i].out);
+
+			fds[i + 1].fd = clients[i].fd;
+			fds[i + 1].events = (unsent < SERVER_BACKLOG && !clients[i].closing ? POLLIN : 0) | (unsent > 0 ? POLLOUT : 0);
+			fds[i + 1].revents = 0;
+		}
+
+		if (poll(fds, count + 1, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+
+		// Clients are visited from the last, so closing one moves a visited one into its place
+		for (i = count - 1; i >= 0; i--)
+		{
+			server_client_t *client = &clients[i];
+			service_header_t *header;
+			void *records;
+			int status = 0;
+
+			if (!client->closing && (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+			{
+				// A client that closed its end is still owed the answers queued for it
+				if (service_fill(&client->in, client->fd) < 0)
+					client->closing = 1;
+
+				long long answer_start = server_clock();
+				while (status >= 0 && (status = service_next(&client->in, &header, &records)) == 1)
+					if (server_answer(&s, header, records, &client->out) != 0)
+						status = -1;
+				s.answer_ns += server_clock() - answer_start;
+
+				if (status < 0 && service_pending(&client->in) > 0)
+					fprintf(stderr, "Dropping a client that sent a malformed message.\n");
+			}
+
+			int flushed = service_flush(&client->out, client->fd);
+			if (status < 0 || flushed < 0 || (client->closing && flushed == 0))
+				server_close(clients, &count, i);
+		}
+
+		if (fds[0].revents & POLLIN)
+		{
+			int fd;
+
+			while (count < size && (fd = accept(listener, NULL, NULL)) >= 0)
+			{
+				service_hello_t *hello;
+
+				fcntl(fd, F_SETFL, O_NONBLOCK);
+				clients[count].fd = fd;
+				clients[count].closing = 0;
+				service_buffer_init(&clients[count].in);
+				service_buffer_init(&clients[count].out);
+
+				hello = service_append(&clients[count].out, SERVICE_HELLO, s.wire, 1);
+				hello->cores = cores;
+				hello->scheme = scheme;
+				hello->quantum = quantum;
+				count++;
+				connections++;
+			}
+		}
+	}
+
+	double seconds = (server_clock() - start) / 1e9;
+	long long decisions = s.arrivals + s.finished + s.expired;
+
+	printf("\nSERVICE SUMMARY (%d connection(s), %.3f s):\n", connections, seconds);
+	printf("  Messages answered: %lld over %lld time units\n", s.messages, s.rebased + s.time);
+	printf("  Arrivals: %lld, completions: %lld, quantum expiries: %lld, records rejected: %lld\n",
+			s.arrivals, s.finished, s.expired, s.rejected);
+	printf("  Time answering: %.3f s, %.2f us per record\n", s.answer_ns / 1e9,
+			decisions > 0 ? s.answer_ns / 1e3 / decisions : 0.0);
+	if (s.arrivals > 0 && s.arrivals == s.finished)
+	{
+		printf("\n");
+		printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
+		printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
+		printf("Average Response Time: %.2f\n", scheduler_average_response_time());
+	}
+
+	while (count > 0)
+		server_close(clients, &count, count - 1);
+	close(listener);
+	unlink(path);
+	scheduler_clean_up();
+
+	free(clients);
+	free(fds);
+	free(s.known);
+	free(s.touched);
+	free(s.batch);
+	return 0;
+}
@@ -0,0 +1,24 @@
+/** @file libserver.h
+ */
+
+#ifndef LIBSERVER_H_
+#define LIBSERVER_H_
+
+#include "../libscheduler/libscheduler.h"
+
+// Scheduler time the service (-L) moves its clock back from (see
+// scheduler_rebase_time()), and the most one message may move it forward
+// by or a job may run for, so time stays well inside an int
+#define SERVER_REBASE_TIME (1 << 29)
+
+// Fewest jobs the service (-L) lets finish between calls to scheduler_retire_finished()
+#define SERVER_RETIRE_JOBS 64
+
+// Bytes of answers a service client can have unread before the service
+// stops reading its requests
+#define SERVER_BACKLOG (1 << 22)
+
+
+int server_run(const char *path, int cores, int scheme, int quantum);
+
+#endif /* LIBSERVER_H_ */
@@ -0,0 +1,276 @@
+/** @file libservice.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "libservice.h"
+
+// Bytes a buffer starts with, and reads at least this many at a time
+#define SERVICE_BUFFER_MIN 65536
+
+
+/**
+  Makes room for count more bytes at the end of b, first moving what is
+  left down to the start.
+ */
+static void service_reserve(service_buffer_t *b, size_t count)
+{
+	if (b->start > 0 && b->length + count > b->size) {
+		memmove(b->data, b->data + b->start, b->length - b->start);
+		b->length -= b->start;
+		b->start = 0;
+	}
+
+	if (b->length + count > b->size) {
+		size_t size = (0 == b->size) ? SERVICE_BUFFER_MIN : b->size;
+		while (size < b->length + count)
+			size *= 2;
+		b->data = realloc(b->data, size);
+		b->size = size;
+	}
+}
+
+
+/**
+  Sets up an empty buffer.
+
+  @param b a pointer to an instance of the service_buffer_t data structure
+ */
+void service_buffer_init(service_buffer_t *b)
+{
+	memset(b, 0, sizeof(service_buffer_t));
+}
+
+
+/**
+  @param type a service_message_type_t
+  @return bytes in each record of a message of type, 0 for an unknown type
+ */
+size_t service_record_size(int type)
+{
+	switch (type) {
+		case SERVICE_HELLO: return sizeof(service_hello_t);
+		case SERVICE_ARRIVALS: return sizeof(service_arrival_t);
+		case SERVICE_FINISHED:
+		case SERVICE_EXPIRED: return sizeof(service_event_t);
+		case SERVICE_ASSIGNMENTS: return sizeof(service_assignment_t);
+	}
+	return 0;
+}
+
+
+/**
+  Appends a message to b.
+
+  @param b a pointer to an instance of the service_buffer_t data structure
+  @param type a service_message_type_t
+  @param time the time unit the records happen in
+  @param count records in the message, at most SERVICE_MAX_RECORDS
+  @return where the caller fills in the count records
+ */
+void *service_append(service_buffer_t *b, int type, int time, int count)
+{
+	size_t length = sizeof(service_header_t) + count * service_record_size(type);
+
+	service_reserve(b, length);
+	service_header_t *header = (service_header_t *)(b->data + b->length);
+	header->length = length;
+	header->type = type;
+	header->count = count;
+	header->time = time;
+	b->length += length;
+
+	return header + 1;
+}
+
+
+/**
+  Takes the next whole message off the start of b. The message stays
+  valid until b is next added to.
+
+  @param b a pointer to an instance of the service_buffer_t data structure
+  @param header set to the message's header
+  @param records set to its records
+  @return 1 if a message was taken
+  @return 0 if the next message has not all come in yet
+  @return -1 if the next message is malformed
+ */
+int service_next(service_buffer_t *b, service_header_t **header, void **records)
+{
+	size_t held = b->length - b->start;
+
+	if (held < sizeof(service_header_t))
+		return 0;
+
+	service_header_t *h = (service_header_t *)(b->data + b->start);
+	size_t record_size = service_record_size(h->type);
+	if (0 == record_size || h->count > SERVICE_MAX_RECORDS
+			|| h->length != sizeof(service_header_t) + h->count * record_size)
+		return -1;
+	if (held < h->length)
+		return 0;
+
+	*header = h;
+	*records = h + 1;
+	b->start += h->length;
+	return 1;
+}
+
+
+/**
+  Reads whatever fd has ready onto the end of b.
+
+  @param b a pointer to an instance of the service_buffer_t data structure
+  @param fd a socket, blocking or not
+  @return bytes read, 0 if a non-blocking fd had nothing ready
+  @return -1 if the peer closed the connection or the read failed
+ */
+int service_fill(service_buffer_t *b, int fd)
+{
+	service_reserve(b, SERVICE_BUFFER_MIN);
+
+	ssize_t got = read(fd, b->data + b->length, b->size - b->length);
+	if (got < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno))
+		return 0;
+	if (got <= 0)
+		return -1;
+
+	b->length += got;
+	return got;
+}
+
+
+/**
+  Writes as much of b to fd as fd takes.
+
+  @param b a pointer to an instance of the service_buffer_t data structure
+  @param fd a socket, blocking or not
+  @return 0 once b is empty
+  @return 1 if a non-blocking fd took only part of it
+  @return -1 if the write failed
+ */
+int service_flush(service_buffer_t *b, int fd)
+{
+	while (b->start < b->length) {
+		ssize_t written = send(fd, b->data + b->start, b->length - b->start, MSG_NOSIGNAL);
+		if (written < 0 && EINTR == errno)
+			continue;
+		if (written < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+			return 1;
+		if (written <= 0)
+			return -1;
+		b->start += written;
+	}
+
+	b->start = b->length = 0;
+	return 0;
+}
+
+
+/**
+  @param b a pointer to an instance of the service_buffer_t data structure
+  @return bytes held in b
+ */
+size_t service_pending(service_buffer_t *b)
+{
+	return b->length - b->start;
+}
+
+
+/**
+  Frees the memory held by b.
+
+  @param b a pointer to an instance of the service_buffer_t data structure
+ */
+void service_buffer_destroy(service_buffer_t *b)
+{
+	free(b->data);
+	memset(b, 0, sizeof(service_buffer_t));
+}
+
+
+static int service_address(const char *path, struct sockaddr_un *address)
+{
+	memset(address, 0, sizeof(struct sockaddr_un));
+	address->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address->sun_path))
+		return -1;
+	strcpy(address->sun_path, path);
+	return 0;
+}
+
+
+/**
+  Listens on a Unix domain socket at path, replacing a socket left there
+  by a service that did not clean up after itself. Anything else at path,
+  including a socket a live service still accepts on, is left alone.
+
+  @param path where the socket goes in the file system
+  @return the listening socket
+  @return -1 if it could not be set up, with errno EEXIST if path is not
+    a socket and EADDRINUSE if a service is listening on it
+ */
+int service_listen(const char *path)
+{
+	struct sockaddr_un address;
+	struct stat st;
+	int fd;
+
+	if (service_address(path, &address) != 0) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			errno = EEXIST;
+			return -1;
+		}
+		if ((fd = service_connect(path)) >= 0) {
+			close(fd);
+			errno = EADDRINUSE;
+			return -1;
+		}
+		if (unlink(path) != 0 && errno != ENOENT)
+			return -1;
+	}
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return -1;
+	if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+		int error = errno;
+		close(fd);
+		errno = error;
+		return -1;
+	}
+	return fd;
+}
+
+
+/**
+  Connects to the service listening at path.
+
+  @param path the service's socket in the file system
+  @return the connected socket, blocking
+  @return -1 if the service could not be reached
+ */
+int service_connect(const char *path)
+{
+	struct sockaddr_un address;
+	int fd;
+
+	if (service_address(path, &address) != 0 || (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
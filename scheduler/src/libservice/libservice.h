@@ -0,0 +1,104 @@
+/** @file libservice.h
+ */
+
+#ifndef LIBSERVICE_H_
+#define LIBSERVICE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Most records one message may carry
+#define SERVICE_MAX_RECORDS 4096
+
+/**
+  Kinds of messages exchanged with the scheduler service.
+
+  - SERVICE_HELLO: sent by the service when a client connects, one
+    service_hello_t record.
+  - SERVICE_ARRIVALS: jobs arriving at time, service_arrival_t records.
+  - SERVICE_FINISHED: jobs that finished at time, service_event_t records
+    naming each job and the core it ran on.
+  - SERVICE_EXPIRED: cores whose quantum expired at time, service_event_t
+    records (job_number is ignored).
+  - SERVICE_ASSIGNMENTS: the service's answer to each of the three above,
+    sent in the order they came in. One service_assignment_t record for
+    every core whose job changed, and for every core the message named.
+*/
+typedef enum {SERVICE_HELLO = 1, SERVICE_ARRIVALS, SERVICE_FINISHED, SERVICE_EXPIRED, SERVICE_ASSIGNMENTS} service_message_type_t;
+
+/**
+  Header at the start of every message. length counts the whole message,
+  header included. Fields are stored in host byte order, since the socket
+  is local. time wraps around past the largest int32_t, so a long-running
+  client can count time in a wider type and send it truncated.
+*/
+typedef struct _service_header_t
+{
+  uint32_t length;
+  uint16_t type;
+  uint16_t count;  // Records following the header
+  int32_t time;    // Time unit the records happen in
+
+} service_header_t;
+
+typedef struct _service_hello_t
+{
+  int32_t cores;
+  int32_t scheme;
+  int32_t quantum;
+
+} service_hello_t;
+
+typedef struct _service_arrival_t
+{
+  int32_t job_number;  // Unique among the jobs the service has not seen finish
+  int32_t running_time;
+  int32_t priority;
+  int32_t deadline;    // Absolute time unit, or -1 for none
+  int32_t cores;       // Cores needed at once, only read by GANG
+
+} service_arrival_t;
+
+typedef struct _service_event_t
+{
+  int32_t core_id;
+  int32_t job_number;
+
+} service_event_t;
+
+typedef struct _service_assignment_t
+{
+  int32_t core_id;
+  int32_t job_number;  // Job now on the core, -1 for none
+  int32_t quantum;     // Time units until its quantum expires, -1 for none
+
+} service_assignment_t;
+
+/**
+  Bytes on their way into or out of a socket. Messages are appended at
+  the end and taken from start, so many can be sent or parsed per system
+  call.
+*/
+typedef struct _service_buffer_t
+{
+  char *data;
+  size_t start;   // First byte not yet taken
+  size_t length;  // End of the bytes held
+  size_t size;    // Bytes allocated
+
+} service_buffer_t;
+
+
+void   service_buffer_init   (service_buffer_t *b);
+size_t service_record_size   (int type);
+void * service_append        (service_buffer_t *b, int type, int time, int count);
+int    service_next          (service_buffer_t *b, service_header_t **header, void **records);
+int    service_fill          (service_buffer_t *b, int fd);
+int    service_flush         (service_buffer_t *b, int fd);
+size_t service_pending       (service_buffer_t *b);
+void   service_buffer_destroy(service_buffer_t *b);
+
+int    service_listen        (const char *path);
+int    service_connect       (const char *path);
+
+#endif /* LIBSERVICE_H_ */
@@ -0,0 +1,156 @@
+/** @file libsnapshot.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libsnapshot.h"
+
+
+/**
+  Starts an empty snapshot holding only the magic number and version.
+
+  @param s a pointer to an instance of the snapshot_t data structure
+ */
+void snapshot_init(snapshot_t *s)
+{
+	s->data = NULL;
+	s->size = 0;
+	s->capacity = 0;
+	s->offset = 0;
+	s->failed = 0;
+
+	uint32_t header[2] = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION};
+	snapshot_put(s, header, sizeof(header));
+}
+
+
+/**
+  Appends size bytes, doubling the buffer as needed.
+
+  @param s a pointer to an initialized snapshot_t
+  @param data the bytes to append
+  @param size number of bytes
+ */
+void snapshot_put(snapshot_t *s, const void *data, size_t size)
+{
+	if (s->size + size > s->capacity) {
+		size_t capacity = (0 == s->capacity) ? 4096 : s->capacity;
+		while (capacity < s->size + size) {
+			capacity *= 2;
+		}
+		s->data = realloc(s->data, capacity);
+		s->capacity = capacity;
+	}
+
+	memcpy(s->data + s->size, data, size);
+	s->size += size;
+}
+
+
+/**
+  Reads the next size bytes back out.
+
+  @param s a pointer to a snapshot_t filled by snapshot_read()
+  @param data where to copy the bytes
+  @param size number of bytes
+  @return 0 on success
+  @return -1 if fewer than size bytes are left; data is zeroed and the
+    snapshot marked failed
+ */
+int snapshot_get(snapshot_t *s, void *data, size_t size)
+{
+	if (s->failed || size > s->size - s->offset) {
+		memset(data, 0, size);
+		s->failed = 1;
+		return -1;
+	}
+
+	memcpy(data, s->data + s->offset, size);
+	s->offset += size;
+	return 0;
+}
+
+
+/**
+  Saves the snapshot to path with a single write.
+
+  @param s a pointer to an initialized snapshot_t
+  @param path file to create
+  @return 0 on success
+  @return -1 if the file could not be written completely
+ */
+int snapshot_write(snapshot_t *s, const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	if (NULL == file) {
+		return -1;
+	}
+
+	size_t written = fwrite(s->data, 1, s->size, file);
+	if (0 != fclose(file) || written != s->size) {
+		return -1;
+	}
+	return 0;
+}
+
+
+/**
+  Loads a snapshot saved by snapshot_write() with a single read and checks
+  its magic number and version. Reading starts after them.
+
+  @param s a pointer to an instance of the snapshot_t data structure
+  @param path file to read
+  @return 0 on success
+  @return -1 if the file could not be read or is not a snapshot of this
+    version
+ */
+int snapshot_read(snapshot_t *s, const char *path)
+{
+	s->data = NULL;
+	s->size = 0;
+	s->capacity = 0;
+	s->offset = 0;
+	s->failed = 0;
+
+	FILE *file = fopen(path, "rb");
+	if (NULL == file) {
+		return -1;
+	}
+
+	long size = -1;
+	if (0 == fseek(file, 0, SEEK_END)) {
+		size = ftell(file);
+	}
+	if (size <= 0 || 0 != fseek(file, 0, SEEK_SET)) {
+		fclose(file);
+		return -1;
+	}
+
+	s->data = malloc(size);
+	s->capacity = size;
+	s->size = fread(s->data, 1, size, file);
+	fclose(file);
+
+	uint32_t header[2];
+	if (s->size != (size_t)size || 0 != snapshot_get(s, header, sizeof(header))
+		|| SNAPSHOT_MAGIC != header[0] || SNAPSHOT_VERSION != header[1]) {
+		return -1;
+	}
+	return 0;
+}
+
+
+/**
+  Frees the snapshot's buffer.
+
+  @param s a pointer to an initialized snapshot_t
+ */
+void snapshot_destroy(snapshot_t *s)
+{
+	free(s->data);
+	s->data = NULL;
+	s->size = 0;
+	s->capacity = 0;
+}
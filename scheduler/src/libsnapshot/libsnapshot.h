@@ -0,0 +1,41 @@
+/** @file libsnapshot.h
+ */
+
+#ifndef LIBSNAPSHOT_H_
+#define LIBSNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAPSHOT_MAGIC 0x50534353 // "SCSP"
+#define SNAPSHOT_VERSION 3
+
+/**
+  A checkpoint held in memory. Whoever saves state appends its fields with
+  snapshot_put() and the whole buffer goes to disk in one write; a restore
+  reads the whole file in one read and takes the fields back out in the
+  same order with snapshot_get(). Fields are stored in host byte order.
+*/
+typedef struct _snapshot_t
+{
+  char *data;
+  size_t size;      // Bytes held
+  size_t capacity;  // Bytes allocated
+  size_t offset;    // Next byte snapshot_get() reads
+  int failed;       // Set once a read ran past the end
+
+} snapshot_t;
+
+// Appends or reads back one variable, which must not be a pointer
+#define SNAPSHOT_PUT(s, var) snapshot_put((s), &(var), sizeof(var))
+#define SNAPSHOT_GET(s, var) snapshot_get((s), &(var), sizeof(var))
+
+
+void snapshot_init   (snapshot_t *s);
+void snapshot_put    (snapshot_t *s, const void *data, size_t size);
+int  snapshot_get    (snapshot_t *s, void *data, size_t size);
+int  snapshot_write  (snapshot_t *s, const char *path);
+int  snapshot_read   (snapshot_t *s, const char *path);
+void snapshot_destroy(snapshot_t *s);
+
+#endif /* LIBSNAPSHOT_H_ */
@@ -0,0 +1,302 @@
+/** @file libstats.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "libstats.h"
+
+
+static long long stats_clock()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+/**
+  @param cores cores the page reports on
+  @return bytes in a stats page for cores
+ */
+size_t stats_page_size(int cores)
+{
+	return sizeof(stats_page_t) + cores * sizeof(int64_t);
+}
+
+
+/**
+  Creates the stats page at path and maps it. A page left at path by an
+  earlier run is unlinked rather than truncated, so a tool still reading
+  it keeps its copy.
+
+  @param w a pointer to an instance of the stats_writer_t data structure
+  @param path where the page goes in the file system
+  @param cores cores the page reports on
+  @param interval_ns least time between snapshots
+  @return 0 on success, -1 if the page could not be created
+ */
+int stats_writer_init(stats_writer_t *w, const char *path, int cores, long long interval_ns)
+{
+	memset(w, 0, sizeof(stats_writer_t));
+	w->size = stats_page_size(cores);
+
+	unlink(path);
+	int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+		return -1;
+	if (ftruncate(fd, w->size) != 0) {
+		close(fd);
+		return -1;
+	}
+	void *page = mmap(NULL, w->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == page)
+		return -1;
+
+	w->page = page;
+	w->page->version = STATS_VERSION;
+	w->page->cores = cores;
+	w->page->pid = getpid();
+	w->page->state = STATS_RUNNING;
+	atomic_thread_fence(memory_order_release);
+	w->page->magic = STATS_MAGIC;
+
+	w->interval_ns = interval_ns;
+	w->start_ns = w->last_ns = w->checked_ns = stats_clock();
+	w->countdown = w->check_every = STATS_CHECK_EVERY;
+	return 0;
+}
+
+
+static int stats_bucket(long long value)
+{
+	if (value < STATS_SUB_BUCKETS)
+		return (value < 0) ? 0 : value;
+
+	int shift = 63 - __builtin_clzll(value) - STATS_SUB_BITS;
+	int bucket = STATS_SUB_BUCKETS * (shift + 1) + (int)(value >> shift) - STATS_SUB_BUCKETS;
+	return (bucket < STATS_BUCKETS) ? bucket : STATS_BUCKETS - 1;
+}
+
+
+/**
+  Counts value in h. Negative values count as 0.
+
+  @param h a pointer to an instance of the stats_histogram_t data structure
+  @param value the value to count
+ */
+void stats_histogram_add(stats_histogram_t *h, long long value)
+{
+	h->bucket[stats_bucket(value)]++;
+	h->count++;
+	if (value > h->max)
+		h->max = value;
+}
+
+
+/**
+  @param h a pointer to an instance of the stats_histogram_t data structure
+  @param percent the percentile wanted, 0 to 100
+  @return the least value in the bucket holding the percentile, 0 if h
+    is empty
+ */
+float stats_histogram_percentile(const stats_histogram_t *h, int percent)
+{
+	int64_t rank = (h->count * percent + 99) / 100, seen = 0;
+	int bucket;
+
+	if (0 == h->count)
+		return 0;
+	if (rank < 1)
+		rank = 1;
+
+	for (bucket = 0; bucket < STATS_BUCKETS - 1; bucket++) {
+		seen += h->bucket[bucket];
+		if (seen >= rank)
+			break;
+	}
+
+	if (bucket < STATS_SUB_BUCKETS)
+		return bucket;
+	int shift = bucket / STATS_SUB_BUCKETS - 1;
+	long long least = (long long)(STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS) << shift;
+	return (least < h->max) ? least : h->max;
+}
+
+
+/**
+  Counts a finished job towards the waiting and turnaround percentiles.
+
+  @param w a pointer to an instance of the stats_writer_t data structure
+  @param waiting the job's waiting time
+  @param turnaround the job's turnaround time
+ */
+void stats_job_done(stats_writer_t *w, long long waiting, long long turnaround)
+{
+	stats_histogram_add(&w->waiting, waiting);
+	stats_histogram_add(&w->turnaround, turnaround);
+}
+
+
+/**
+  The slow path of stats_due(): reads the clock, and adjusts how many
+  calls go by before the next read so reads come a few times an interval.
+
+  @param w a pointer to an instance of the stats_writer_t data structure
+  @return 1 if a snapshot is due, 0 otherwise
+ */
+int stats_check(stats_writer_t *w)
+{
+	long long now = stats_clock();
+
+	if (now - w->checked_ns > w->interval_ns / 4 && w->check_every > 1)
+		w->check_every /= 2;
+	else if (now - w->checked_ns < w->interval_ns / 64 && w->check_every < (1u << 20))
+		w->check_every *= 2;
+	w->checked_ns = now;
+	w->countdown = w->check_every;
+
+	return now - w->last_ns >= w->interval_ns;
+}
+
+
+/**
+  Publishes a snapshot. Readers never wait on the writer, and the writer
+  never waits on readers: a reader that overlaps an update sees seq
+  change and copies the page again.
+
+  @param w a pointer to an instance of the stats_writer_t data structure
+  @param sample the simulation's counts
+  @param core_busy time units each core has been busy
+  @param done whether this is the run's last snapshot
+ */
+void stats_publish(stats_writer_t *w, const stats_sample_t *sample, const int *core_busy, int done)
+{
+	stats_page_t *page = w->page;
+	long long now = stats_clock();
+	double seconds = (now - w->last_ns) / 1e9;
+
+	// Worked out before the update, to keep readers' retry window short
+	float waiting_p50 = stats_histogram_percentile(&w->waiting, 50);
+	float waiting_p90 = stats_histogram_percentile(&w->waiting, 90);
+	float waiting_p99 = stats_histogram_percentile(&w->waiting, 99);
+	float turnaround_p50 = stats_histogram_percentile(&w->turnaround, 50);
+	float turnaround_p90 = stats_histogram_percentile(&w->turnaround, 90);
+	float turnaround_p99 = stats_histogram_percentile(&w->turnaround, 99);
+
+	unsigned int seq = atomic_load_explicit(&page->seq, memory_order_relaxed);
+	atomic_store_explicit(&page->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	page->sample = *sample;
+	page->wall_ns = now - w->start_ns;
+	page->snapshots++;
+	page->events_per_second = (seconds > 0) ? (sample->events - w->last_events) / seconds : 0;
+	page->waiting_p50 = waiting_p50;
+	page->waiting_p90 = waiting_p90;
+	page->waiting_p99 = waiting_p99;
+	page->waiting_max = w->waiting.max;
+	page->turnaround_p50 = turnaround_p50;
+	page->turnaround_p90 = turnaround_p90;
+	page->turnaround_p99 = turnaround_p99;
+	page->turnaround_max = w->turnaround.max;
+	for (int i = 0; i < page->cores; i++)
+		page->core_busy[i] = core_busy[i];
+	if (done)
+		page->state = STATS_DONE;
+
+	atomic_store_explicit(&page->seq, seq + 2, memory_order_release);
+
+	w->last_ns = now;
+	w->last_events = sample->events;
+}
+
+
+/**
+  Unmaps the page. The file stays, holding the last snapshot.
+
+  @param w a pointer to an instance of the stats_writer_t data structure
+ */
+void stats_writer_close(stats_writer_t *w)
+{
+	munmap(w->page, w->size);
+	memset(w, 0, sizeof(stats_writer_t));
+}
+
+
+/**
+  Maps the stats page at path read-only.
+
+  @param r a pointer to an instance of the stats_reader_t data structure
+  @param path the page in the file system
+  @return 0 on success, -1 if there is no stats page at path
+ */
+int stats_reader_open(stats_reader_t *r, const char *path)
+{
+	struct stat st;
+
+	memset(r, 0, sizeof(stats_reader_t));
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(stats_page_t)) {
+		close(fd);
+		return -1;
+	}
+	void *page = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == page)
+		return -1;
+
+	r->page = page;
+	r->size = st.st_size;
+	if (r->page->magic != STATS_MAGIC || r->page->version != STATS_VERSION
+			|| r->page->cores < 0 || stats_page_size(r->page->cores) > r->size) {
+		stats_reader_close(r);
+		return -1;
+	}
+	return 0;
+}
+
+
+/**
+  Copies a consistent snapshot of the page.
+
+  @param r a pointer to an instance of the stats_reader_t data structure
+  @param copy stats_page_size() bytes for the page's cores
+  @return the number of times the page changed mid-copy
+ */
+int stats_read(stats_reader_t *r, stats_page_t *copy)
+{
+	size_t size = stats_page_size(r->page->cores);
+	int retries = 0;
+
+	for (;;) {
+		unsigned int before = atomic_load_explicit(&r->page->seq, memory_order_acquire);
+		if (!(before & 1)) {
+			memcpy(copy, r->page, size);
+			atomic_thread_fence(memory_order_acquire);
+			if (atomic_load_explicit(&r->page->seq, memory_order_relaxed) == before)
+				return retries;
+		}
+		retries++;
+	}
+}
+
+
+/**
+  Unmaps the page.
+
+  @param r a pointer to an instance of the stats_reader_t data structure
+ */
+void stats_reader_close(stats_reader_t *r)
+{
+	munmap(r->page, r->size);
+	memset(r, 0, sizeof(stats_reader_t));
+}
@@ -0,0 +1,139 @@
+/** @file libstats.h
+ */
+
+#ifndef LIBSTATS_H_
+#define LIBSTATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// First bytes of a stats page, "STAT"
+#define STATS_MAGIC 0x54415453
+#define STATS_VERSION 1
+
+// Exact buckets below STATS_SUB_BUCKETS, then that many buckets per power
+// of two, up to 2^32
+#define STATS_SUB_BITS 4
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS (STATS_SUB_BUCKETS * (33 - STATS_SUB_BITS))
+
+// Calls to stats_due() between clock reads at first; adapts to the interval
+#define STATS_CHECK_EVERY 64
+
+typedef enum {STATS_RUNNING = 0, STATS_DONE} stats_state_t;
+
+/**
+  What one snapshot holds, filled in by the simulator for stats_publish().
+  Every count is cumulative, so a reader can take rates between any two
+  snapshots it saw.
+*/
+typedef struct _stats_sample_t
+{
+  int64_t time;            // Simulated time unit
+  int64_t events;          // Arrivals, completions and quantum expiries so far
+  int64_t finished;        // Jobs finished
+  int64_t alive;           // Jobs arrived and not yet finished
+  int64_t queued;          // Alive jobs not on a core
+  int64_t running;         // Jobs on a core
+
+} stats_sample_t;
+
+/**
+  The shared page, a file an external tool maps read-only. The writer
+  makes seq odd, updates the page, then makes it even again; a reader
+  copies the page between two reads of seq and keeps the copy only if
+  both were the same even number (see stats_read()).
+*/
+typedef struct _stats_page_t
+{
+  uint32_t magic;
+  uint32_t version;
+  int32_t cores;
+  int32_t pid;               // Process writing the page
+  atomic_uint seq;
+  int32_t state;             // stats_state_t
+
+  stats_sample_t sample;
+  int64_t wall_ns;           // Since the page was created
+  int64_t snapshots;
+  double events_per_second;  // Since the snapshot before
+
+  // Over every job finished so far, in time units
+  float waiting_p50, waiting_p90, waiting_p99;
+  float turnaround_p50, turnaround_p90, turnaround_p99;
+  int64_t waiting_max, turnaround_max;
+
+  int64_t core_busy[];       // Time units each core has been busy
+
+} stats_page_t;
+
+/**
+  Log-linear histogram: exact below STATS_SUB_BUCKETS, then within 1 part
+  in STATS_SUB_BUCKETS.
+*/
+typedef struct _stats_histogram_t
+{
+  int64_t count;
+  int64_t max;
+  int64_t bucket[STATS_BUCKETS];
+
+} stats_histogram_t;
+
+/**
+  The simulator's side of a stats page, with the histograms the page's
+  percentiles are taken from.
+*/
+typedef struct _stats_writer_t
+{
+  stats_page_t *page;
+  size_t size;               // Bytes mapped
+  long long interval_ns;     // Least time between snapshots
+  long long start_ns;
+  long long last_ns;         // When the last snapshot was published
+  long long checked_ns;      // When the clock was last read
+  int64_t last_events;
+  unsigned int countdown;    // Calls to stats_due() until the clock is read
+  unsigned int check_every;
+
+  stats_histogram_t waiting, turnaround;
+
+} stats_writer_t;
+
+/**
+  A tool's read-only mapping of a stats page.
+*/
+typedef struct _stats_reader_t
+{
+  stats_page_t *page;     // Mapped read-only
+  size_t size;
+
+} stats_reader_t;
+
+
+int    stats_writer_init (stats_writer_t *w, const char *path, int cores, long long interval_ns);
+void   stats_job_done    (stats_writer_t *w, long long waiting, long long turnaround);
+int    stats_check       (stats_writer_t *w);
+void   stats_publish     (stats_writer_t *w, const stats_sample_t *sample, const int *core_busy, int done);
+void   stats_writer_close(stats_writer_t *w);
+
+void   stats_histogram_add       (stats_histogram_t *h, long long value);
+float  stats_histogram_percentile(const stats_histogram_t *h, int percent);
+
+int    stats_reader_open (stats_reader_t *r, const char *path);
+size_t stats_page_size   (int cores);
+int    stats_read        (stats_reader_t *r, stats_page_t *copy);
+void   stats_reader_close(stats_reader_t *r);
+
+/**
+  Whether a snapshot is due. Only reads the clock every so many calls, so
+  it can sit in a loop that runs once per time unit or event.
+*/
+static inline int stats_due(stats_writer_t *w)
+{
+  if (--w->countdown > 0)
+    return 0;
+  return stats_check(w);
+}
+
+#endif /* LIBSTATS_H_ */
@@ -0,0 +1,263 @@
+/** @file libtrace.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libtrace.h"
+
+
+/**
+  Writer thread body. Writes full buffers in the order they were handed
+  over until the writer is closed and every buffer has been flushed.
+ */
+static void *trace_writer_thread(void *arg)
+{
+	trace_writer_t *w = (trace_writer_t *)arg;
+
+	pthread_mutex_lock(&w->lock);
+	while (1) {
+		while (0 == w->pending && !w->closing)
+			pthread_cond_wait(&w->full, &w->lock);
+
+		if (0 == w->pending)
+			break;
+
+		int index = w->tail;
+		pthread_mutex_unlock(&w->lock);
+
+		// The caller never touches a pending buffer, so write it unlocked
+		if (fwrite(w->buffers[index], sizeof(trace_event_t), w->lengths[index], w->file) != (size_t)w->lengths[index])
+			w->error = 1;
+
+		pthread_mutex_lock(&w->lock);
+		w->tail = (w->tail + 1) % TRACE_BUFFERS;
+		w->pending--;
+		pthread_cond_signal(&w->empty);
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+
+/**
+  Hands the head buffer to the writer thread and moves on to the next free
+  buffer, blocking only if every buffer is still waiting to be written.
+ */
+static void trace_flush_head(trace_writer_t *w)
+{
+	pthread_mutex_lock(&w->lock);
+	w->lengths[w->head] = w->fill;
+	w->pending++;
+	pthread_cond_signal(&w->full);
+
+	while (TRACE_BUFFERS == w->pending)
+		pthread_cond_wait(&w->empty, &w->lock);
+
+	w->head = (w->head + 1) % TRACE_BUFFERS;
+	w->fill = 0;
+	pthread_mutex_unlock(&w->lock);
+}
+
+
+/**
+  Opens path for writing, writes the trace header and starts the writer
+  thread.
+
+  @param w a pointer to an instance of the trace_writer_t data structure
+  @param path file to create
+  @param jobs number of jobs in the simulated trace
+  @param cores number of cores being simulated
+  @param scheme the scheme_t in use
+  @param quantum the RR quantum (0 for other schemes)
+  @return 0 on success
+  @return -1 if the file could not be created
+ */
+int trace_writer_init(trace_writer_t *w, const char *path, int jobs, int cores, int scheme, int quantum)
+{
+	memset(w, 0, sizeof(trace_writer_t));
+
+	w->file = fopen(path, "wb");
+	if (NULL == w->file) {
+		return -1;
+	}
+
+	trace_header_t header = {TRACE_MAGIC, TRACE_VERSION, jobs, cores, scheme, quantum};
+	fwrite(&header, sizeof(trace_header_t), 1, w->file);
+
+	for (int i = 0; i < TRACE_BUFFERS; i++) {
+		w->buffers[i] = malloc(TRACE_BUFFER_EVENTS * sizeof(trace_event_t));
+	}
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->full, NULL);
+	pthread_cond_init(&w->empty, NULL);
+	pthread_create(&w->thread, NULL, trace_writer_thread, w);
+
+	return 0;
+}
+
+
+/**
+  Appends one event to the trace. See trace_event_t for the meaning of
+  arg0, arg1 and arg2 for each type.
+
+  @param w a pointer to an initialized trace_writer_t
+  @param type a trace_event_type_t value
+  @param time the current time of the simulator
+  @param job_id job the event refers to
+  @param core_id core the event refers to, or -1
+  @param arg0 type specific value
+  @param arg1 type specific value
+  @param arg2 type specific value
+ */
+void trace_record(trace_writer_t *w, int type, int time, int job_id, int core_id, int arg0, int arg1, int arg2)
+{
+	trace_event_t *ev = &w->buffers[w->head][w->fill];
+
+	ev->time = time;
+	ev->job_id = job_id;
+	ev->arg0 = arg0;
+	ev->arg1 = arg1;
+	ev->arg2 = arg2;
+	ev->core_id = core_id;
+	ev->type = type;
+	ev->reserved = 0;
+
+	if (++w->fill == TRACE_BUFFER_EVENTS) {
+		trace_flush_head(w);
+	}
+}
+
+
+/**
+  Flushes every buffered event, writes the end marker and the averages,
+  stops the writer thread and closes the file.
+
+  @param w a pointer to an initialized trace_writer_t
+  @param waiting_time average waiting time of the run
+  @param turnaround_time average turnaround time of the run
+  @param response_time average response time of the run
+  @return 0 on success
+  @return -1 if any write failed
+ */
+int trace_writer_close(trace_writer_t *w, float waiting_time, float turnaround_time, float response_time)
+{
+	if (w->fill > 0) {
+		trace_flush_head(w);
+	}
+
+	pthread_mutex_lock(&w->lock);
+	w->closing = 1;
+	pthread_cond_signal(&w->full);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+
+	trace_event_t end;
+	memset(&end, 0, sizeof(trace_event_t));
+	end.type = TRACE_END;
+	trace_summary_t summary = {waiting_time, turnaround_time, response_time};
+
+	if (fwrite(&end, sizeof(trace_event_t), 1, w->file) != 1
+		|| fwrite(&summary, sizeof(trace_summary_t), 1, w->file) != 1) {
+		w->error = 1;
+	}
+	if (0 != fclose(w->file)) {
+		w->error = 1;
+	}
+
+	for (int i = 0; i < TRACE_BUFFERS; i++) {
+		free(w->buffers[i]);
+	}
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->full);
+	pthread_cond_destroy(&w->empty);
+
+	return w->error ? -1 : 0;
+}
+
+
+/**
+  Opens a trace file and validates its header.
+
+  @param r a pointer to an instance of the trace_reader_t data structure
+  @param path trace file to read
+  @return 0 on success
+  @return -1 if the file cannot be opened or is not a trace file
+ */
+int trace_reader_init(trace_reader_t *r, const char *path)
+{
+	memset(r, 0, sizeof(trace_reader_t));
+
+	r->file = fopen(path, "rb");
+	if (NULL == r->file) {
+		return -1;
+	}
+
+	if (fread(&r->header, sizeof(trace_header_t), 1, r->file) != 1
+		|| TRACE_MAGIC != r->header.magic || TRACE_VERSION != r->header.version) {
+		fclose(r->file);
+		r->file = NULL;
+		return -1;
+	}
+
+	r->buffer = malloc(TRACE_BUFFER_EVENTS * sizeof(trace_event_t));
+	return 0;
+}
+
+
+/**
+  Reads the next event. The TRACE_END record is consumed internally; once
+  it has been seen r->summary holds the averages of the run.
+
+  @param r a pointer to an initialized trace_reader_t
+  @param ev destination for the event
+  @return 1 if an event was read
+  @return 0 at the end of the trace
+ */
+int trace_reader_next(trace_reader_t *r, trace_event_t *ev)
+{
+	if (r->next == r->length) {
+		if (r->at_end) {
+			return 0;
+		}
+		r->length = fread(r->buffer, sizeof(trace_event_t), TRACE_BUFFER_EVENTS, r->file);
+		r->next = 0;
+		if (0 == r->length) {
+			r->at_end = 1;
+			return 0;
+		}
+	}
+
+	*ev = r->buffer[r->next++];
+	r->consumed++;
+
+	if (TRACE_END == ev->type) {
+		// The summary directly follows the end marker
+		fseek(r->file, sizeof(trace_header_t) + r->consumed * sizeof(trace_event_t), SEEK_SET);
+		if (fread(&r->summary, sizeof(trace_summary_t), 1, r->file) == 1) {
+			r->has_summary = 1;
+		}
+		r->length = r->next = 0;
+		r->at_end = 1;
+		return 0;
+	}
+
+	return 1;
+}
+
+
+/**
+  Closes the trace file and frees the reader's memory.
+
+  @param r a pointer to an initialized trace_reader_t
+ */
+void trace_reader_destroy(trace_reader_t *r)
+{
+	if (NULL != r->file) {
+		fclose(r->file);
+	}
+	free(r->buffer);
+}
@@ -0,0 +1,124 @@
+/** @file libtrace.h
+ */
+
+#ifndef LIBTRACE_H_
+#define LIBTRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define TRACE_MAGIC 0x54484353 // "SCHT"
+#define TRACE_VERSION 2
+
+// Number of buffers cycled between the simulator and the writer thread
+#define TRACE_BUFFERS 4
+// Events held by each buffer
+#define TRACE_BUFFER_EVENTS 8192
+
+/**
+  Kinds of events recorded in a trace file.
+*/
+typedef enum {TRACE_ARRIVAL = 0, TRACE_DISPATCH, TRACE_PREEMPT, TRACE_QUANTUM_EXPIRE, TRACE_FINISH, TRACE_END} trace_event_type_t;
+
+/**
+  Header at the start of every trace file. Fields are stored in host byte
+  order.
+*/
+typedef struct _trace_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  int32_t jobs;
+  int32_t cores;
+  int32_t scheme;
+  int32_t quantum;
+
+} trace_header_t;
+
+/**
+  One fixed size trace record.
+
+  - TRACE_ARRIVAL: core_id is the core returned by scheduler_new_job (or -1),
+    arg0 is the running time, arg1 the priority and arg2 the absolute
+    deadline (or -1).
+  - TRACE_DISPATCH: job_id starts running on core_id.
+  - TRACE_PREEMPT: job_id was taken off core_id by an arriving job.
+  - TRACE_QUANTUM_EXPIRE, TRACE_FINISH: job_id left core_id, arg0 is the job
+    now running on core_id (or -1).
+*/
+typedef struct _trace_event_t
+{
+  int32_t time;
+  int32_t job_id;
+  int32_t arg0;
+  int32_t arg1;
+  int32_t arg2;
+  int16_t core_id;
+  uint8_t type;
+  uint8_t reserved;
+
+} trace_event_t;
+
+/**
+  Averages written after the TRACE_END record.
+*/
+typedef struct _trace_summary_t
+{
+  float waiting_time;
+  float turnaround_time;
+  float response_time;
+
+} trace_summary_t;
+
+/**
+  Buffered trace writer. Events are appended to the current buffer by the
+  caller and full buffers are written out by a background thread.
+*/
+typedef struct _trace_writer_t
+{
+  FILE *file;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t full;   // Signalled when a buffer is handed to the thread
+  pthread_cond_t empty;  // Signalled when the thread releases a buffer
+
+  trace_event_t *buffers[TRACE_BUFFERS];
+  int lengths[TRACE_BUFFERS];
+  int head;     // Buffer the caller is filling
+  int fill;     // Events in the head buffer
+  int tail;     // Oldest buffer waiting to be written
+  int pending;  // Buffers waiting to be written
+  int closing;
+  int error;
+
+} trace_writer_t;
+
+/**
+  Sequential trace file reader.
+*/
+typedef struct _trace_reader_t
+{
+  FILE *file;
+  trace_header_t header;
+  trace_summary_t summary;
+  int has_summary;  // Set once the summary after TRACE_END has been read
+  int at_end;
+
+  trace_event_t *buffer;
+  int length;
+  int next;
+  long consumed;    // Events returned so far, including TRACE_END
+
+} trace_reader_t;
+
+
+int  trace_writer_init   (trace_writer_t *w, const char *path, int jobs, int cores, int scheme, int quantum);
+void trace_record        (trace_writer_t *w, int type, int time, int job_id, int core_id, int arg0, int arg1, int arg2);
+int  trace_writer_close  (trace_writer_t *w, float waiting_time, float turnaround_time, float response_time);
+
+int  trace_reader_init   (trace_reader_t *r, const char *path);
+int  trace_reader_next   (trace_reader_t *r, trace_event_t *ev);
+void trace_reader_destroy(trace_reader_t *r);
+
+#endif /* LIBTRACE_H_ */
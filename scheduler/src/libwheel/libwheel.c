@@ -0,0 +1,176 @@
+/** @file libwheel.c
+ */
+
+#include <stdlib.h>
+
+#include "libwheel.h"
+
+
+/**
+  Links t at the tail of the list headed by head.
+ */
+static void wheel_link(wheel_timer_t *head, wheel_timer_t *t)
+{
+	t->prev = head->prev;
+	t->next = head;
+	head->prev->next = t;
+	head->prev = t;
+}
+
+static void wheel_unlink(wheel_timer_t *t)
+{
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	t->next = NULL;
+	t->prev = NULL;
+}
+
+/**
+  Puts t in the slot it belongs to given how far off it is: the lowest
+  level whose span reaches it, in the slot its expiry time falls in.
+ */
+static void wheel_place(timer_wheel_t *w, wheel_timer_t *t)
+{
+	unsigned int delta = (unsigned int)(t->expires - w->now);
+	unsigned int when = (unsigned int)t->expires;
+	int level = 0;
+
+	while (level < WHEEL_LEVELS - 1 && delta >= (1U << (WHEEL_BITS * (level + 1))))
+		level++;
+
+	// Past the top level's span, park in its farthest slot
+	if (level == WHEEL_LEVELS - 1 && delta >= (1U << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+		when = (unsigned int)w->now + (1U << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+	wheel_link(&w->slots[level][(when >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)], t);
+}
+
+
+/**
+  Initializes the wheel with time starting at now.
+
+  @param w a pointer to an instance of the timer_wheel_t data structure
+  @param now the first time unit wheel_expire() will be called for
+ */
+void wheel_init(timer_wheel_t *w, int now)
+{
+	for (int level = 0; level < WHEEL_LEVELS; level++)
+		for (int slot = 0; slot < WHEEL_SLOTS; slot++)
+			w->slots[level][slot].next = w->slots[level][slot].prev = &w->slots[level][slot];
+
+	w->now = now;
+	w->pending = 0;
+}
+
+
+/**
+  Initializes a timer that is not pending.
+
+  @param t the timer
+  @param id a tag for the caller, returned with the timer when it fires
+ */
+void wheel_timer_init(wheel_timer_t *t, int id)
+{
+	t->next = NULL;
+	t->prev = NULL;
+	t->expires = 0;
+	t->id = id;
+}
+
+
+/**
+  @return non-zero if t is waiting in a wheel
+ */
+int wheel_timer_pending(wheel_timer_t *t)
+{
+	return t->prev != NULL;
+}
+
+
+/**
+  Arms t to fire in time unit expires, moving it if it is already pending.
+  A time that has already been expired fires in the next call to
+  wheel_expire().
+
+  @param w a pointer to an instance of the timer_wheel_t data structure
+  @param t the timer
+  @param expires the time unit to fire in
+ */
+void wheel_add(timer_wheel_t *w, wheel_timer_t *t, int expires)
+{
+	if (wheel_timer_pending(t))
+		wheel_cancel(w, t);
+
+	t->expires = (expires < w->now) ? w->now : expires;
+	wheel_place(w, t);
+	w->pending++;
+}
+
+
+/**
+  Disarms t. Does nothing if it is not pending.
+
+  @param w a pointer to an instance of the timer_wheel_t data structure
+  @param t the timer
+ */
+void wheel_cancel(timer_wheel_t *w, wheel_timer_t *t)
+{
+	if (!wheel_timer_pending(t))
+		return;
+
+	wheel_unlink(t);
+	w->pending--;
+}
+
+
+/**
+  Advances the wheel through time unit time and takes out every timer
+  that fires up to and including it. Calling this once per time unit
+  costs O(1) plus the timers that fire or move down a level.
+
+  @param w a pointer to an instance of the timer_wheel_t data structure
+  @param time the last time unit to expire
+  @return the fired timers, no longer pending, chained through next in
+    the order they fire, or NULL if none did. Read a timer's next before
+    adding it again.
+ */
+wheel_timer_t *wheel_expire(timer_wheel_t *w, int time)
+{
+	wheel_timer_t fired;
+	fired.next = fired.prev = &fired;
+
+	for (; w->now <= time; w->now++) {
+		unsigned int now = (unsigned int)w->now;
+
+		// Spill the slots whose span starts now, highest level first
+		int level = 0;
+		while (level < WHEEL_LEVELS - 1 && (now & ((1U << (WHEEL_BITS * (level + 1))) - 1)) == 0)
+			level++;
+
+		for (; level > 0; level--) {
+			wheel_timer_t *head = &w->slots[level][(now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+			while (head->next != head) {
+				wheel_timer_t *t = head->next;
+				wheel_unlink(t);
+				wheel_place(w, t);
+			}
+		}
+
+		wheel_timer_t *head = &w->slots[0][now & (WHEEL_SLOTS - 1)];
+		while (head->next != head) {
+			wheel_timer_t *t = head->next;
+			wheel_unlink(t);
+			wheel_link(&fired, t);
+			w->pending--;
+		}
+	}
+
+	if (fired.next == &fired)
+		return NULL;
+
+	fired.prev->next = NULL;
+	fired.next->prev = NULL;
+	for (wheel_timer_t *t = fired.next; t != NULL; t = t->next)
+		t->prev = NULL;
+	return fired.next;
+}
@@ -0,0 +1,51 @@
+/** @file libwheel.h
+ */
+
+#ifndef LIBWHEEL_H_
+#define LIBWHEEL_H_
+
+// Slots per level are 1 << WHEEL_BITS
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+// Levels of slots; timers further out than WHEEL_SLOTS^WHEEL_LEVELS time
+// units wait in the farthest slot and are placed again when it comes up
+#define WHEEL_LEVELS 4
+
+/**
+  A timer, embedded by the caller in whatever it times. The wheel links
+  pending timers into its slots, so a timer must not move in memory while
+  it is pending.
+*/
+typedef struct _wheel_timer_t
+{
+  struct _wheel_timer_t *next;
+  struct _wheel_timer_t *prev;
+  int expires;  // Time unit the timer fires in
+  int id;       // Caller's tag, untouched by the wheel
+
+} wheel_timer_t;
+
+/**
+  Hierarchical timing wheel. Level 0 has one slot per time unit; each slot
+  of level l covers WHEEL_SLOTS^l time units and is spilled into the
+  levels below when time reaches it. Adding and cancelling a timer are
+  O(1); each timer is moved at most once per level before it fires.
+*/
+typedef struct _timer_wheel_t
+{
+  wheel_timer_t slots[WHEEL_LEVELS][WHEEL_SLOTS];  // List heads
+  int now;      // Next time unit to expire; every earlier one has fired
+  int pending;  // Timers in the wheel
+
+} timer_wheel_t;
+
+
+void            wheel_init        (timer_wheel_t *w, int now);
+void            wheel_timer_init  (wheel_timer_t *t, int id);
+int             wheel_timer_pending(wheel_timer_t *t);
+
+void            wheel_add         (timer_wheel_t *w, wheel_timer_t *t, int expires);
+void            wheel_cancel      (timer_wheel_t *w, wheel_timer_t *t);
+wheel_timer_t * wheel_expire      (timer_wheel_t *w, int time);
+
+#endif /* LIBWHEEL_H_ */
@@ -3,9 +3,34 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "libpriqueue/libpriqueue.h"
 
+// Values each thread offers and polls in the relaxed queue test
+#define MULTI_VALUES 50000
+
+// Queue size the rank error and throughput benchmarks hold steady at, and
+// operations they run
+#define BENCH_SIZE (1 << 14)
+#define BENCH_OPS (1 << 18)
+
+typedef struct _multi_thread_t
+{
+  priqueue_multi_t *m;      // NULL to use q under lock instead
+  priqueue_t *q;
+  pthread_mutex_t *lock;
+  int *values;
+  int first;
+  int count;
+  unsigned int seed;
+  int *polled;              // Values this thread polled
+  int polls;
+
+} multi_thread_t;
+
 int compare1(const void * a, const void * b)
 {
 	return ( *(int*)a - *(int*)b );
@@ -16,6 +41,208 @@ int compare2(const void * a, const void * b)
 	return ( *(int*)b - *(int*)a );
 }
 
+double elapsed(struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+  Offers count values and polls after each offer, from values[first] on.
+ */
+void *multi_thread(void *arg)
+{
+	multi_thread_t *t = (multi_thread_t *)arg;
+
+	for (int i = 0; i < t->count; i++) {
+		int *value = &t->values[t->first + i], *head;
+
+		if (t->m != NULL) {
+			priqueue_multi_offer(t->m, value, &t->seed);
+			head = priqueue_multi_poll(t->m, &t->seed);
+		} else {
+			pthread_mutex_lock(t->lock);
+			priqueue_offer(t->q, value);
+			head = priqueue_poll(t->q);
+			pthread_mutex_unlock(t->lock);
+		}
+		if (head != NULL && t->polled != NULL)
+			t->polled[t->polls++] = *head;
+	}
+	return NULL;
+}
+
+/**
+  Offers and polls from 4 threads at once, then drains the queue, checking
+  every value came out exactly once.
+ */
+void test_multi()
+{
+	priqueue_multi_t m;
+	multi_thread_t t[4];
+	pthread_t threads[4];
+	int total = 4 * MULTI_VALUES, *values = malloc(total * sizeof(int));
+	char *seen = calloc(total, 1);
+	int bad = 0, i, j, *head;
+	unsigned int seed = 1;
+
+	for (i = 0; i < total; i++)
+		values[i] = (i * 7919) % total;
+
+	priqueue_multi_init(&m, compare1, 4, 2);
+	for (i = 0; i < 4; i++) {
+		memset(&t[i], 0, sizeof(multi_thread_t));
+		t[i].m = &m;
+		t[i].values = values;
+		t[i].first = i * MULTI_VALUES;
+		t[i].count = MULTI_VALUES;
+		t[i].seed = i + 1;
+		t[i].polled = malloc(MULTI_VALUES * sizeof(int));
+		pthread_create(&threads[i], NULL, multi_thread, &t[i]);
+	}
+	for (i = 0; i < 4; i++) {
+		pthread_join(threads[i], NULL);
+		for (j = 0; j < t[i].polls; j++) {
+			bad += seen[t[i].polled[j]];
+			seen[t[i].polled[j]] = 1;
+		}
+		free(t[i].polled);
+	}
+	while ((head = priqueue_multi_poll(&m, &seed)) != NULL) {
+		bad += seen[*head];
+		seen[*head] = 1;
+	}
+	for (i = 0; i < total; i++)
+		bad += !seen[i];
+
+	printf("Relaxed queue values lost or duplicated across 4 threads (expected 0): %d\n", bad);
+	printf("Relaxed queue size after draining (expected 0): %d\n", priqueue_multi_size(&m));
+	priqueue_multi_destroy(&m);
+
+	// With one heap nothing is relaxed
+	int sorted = 1, prev = -1;
+	priqueue_multi_init(&m, compare1, 1, 1);
+	for (i = 0; i < 100; i++)
+		priqueue_multi_offer(&m, &values[i], &seed);
+	for (i = 0; (head = priqueue_multi_poll(&m, &seed)) != NULL; i++) {
+		if (*head < prev)
+			sorted = 0;
+		prev = *head;
+	}
+	printf("Single heap relaxed queue polled in order (expected 1 100): %d %d\n", sorted, i);
+
+	head = priqueue_multi_swap(&m, &values[0], &seed);
+	printf("Swap into an empty relaxed queue (expected 1 0): %d %d\n", head == &values[0], priqueue_multi_size(&m));
+	priqueue_multi_offer(&m, &values[1], &seed);
+	head = priqueue_multi_swap(&m, &values[2], &seed);
+	printf("Swap with a better head (expected 7919 1): %d %d\n", *head, priqueue_multi_size(&m));
+	priqueue_multi_destroy(&m);
+
+	free(values);
+	free(seen);
+}
+
+/**
+  Rank error of a relaxed queue with heaps heaps, held at BENCH_SIZE
+  elements by polling once per offer, on one thread: how many smaller
+  values were in the queue when each value was polled. Counted with a
+  Fenwick tree over the values, which are all distinct.
+ */
+void bench_rank(int heaps, double *mean, int *max)
+{
+	int total = BENCH_SIZE + BENCH_OPS, *values = malloc(total * sizeof(int));
+	int *tree = calloc(total + 1, sizeof(int)), i, k;
+	priqueue_multi_t m;
+	unsigned int seed = 7;
+	long long sum = 0;
+
+	// A shuffle of 0 .. total - 1
+	for (i = 0; i < total; i++)
+		values[i] = i;
+	for (i = total - 1; i > 0; i--) {
+		int j = rand_r(&seed) % (i + 1), v = values[i];
+		values[i] = values[j];
+		values[j] = v;
+	}
+
+	*max = 0;
+	priqueue_multi_init(&m, compare1, heaps, 1);
+	for (i = 0; i < total; i++) {
+		priqueue_multi_offer(&m, &values[i], &seed);
+		for (k = values[i] + 1; k <= total; k += k & -k)
+			tree[k]++;
+		if (i < BENCH_SIZE)
+			continue;
+
+		int value = *(int *)priqueue_multi_poll(&m, &seed), rank = 0;
+		for (k = value; k > 0; k -= k & -k)
+			rank += tree[k];
+		for (k = value + 1; k <= total; k += k & -k)
+			tree[k]--;
+
+		sum += rank;
+		if (rank > *max)
+			*max = rank;
+	}
+	*mean = (double)sum / BENCH_OPS;
+
+	priqueue_multi_destroy(&m);
+	free(values);
+	free(tree);
+}
+
+/**
+  Operations (offers and polls) per second from threads threads sharing a
+  relaxed queue with factor heaps per thread, or a heap under one lock if
+  factor is 0.
+ */
+double bench_throughput(int threads, int factor)
+{
+	int total = BENCH_SIZE + BENCH_OPS, *values = malloc(total * sizeof(int)), i;
+	multi_thread_t *t = calloc(threads, sizeof(multi_thread_t));
+	pthread_t *ids = malloc(threads * sizeof(pthread_t));
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	priqueue_multi_t m;
+	priqueue_t q;
+	unsigned int seed = 11;
+	struct timespec start;
+
+	for (i = 0; i < total; i++)
+		values[i] = rand_r(&seed) % total;
+
+	priqueue_multi_init(&m, compare1, threads, factor);
+	priqueue_init_heap(&q, compare1, PRIQUEUE_CACHE_ARITY);
+	for (i = 0; i < BENCH_SIZE; i++) {
+		if (factor > 0)
+			priqueue_multi_offer(&m, &values[i], &seed);
+		else
+			priqueue_offer(&q, &values[i]);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < threads; i++) {
+		t[i].m = (factor > 0) ? &m : NULL;
+		t[i].q = &q;
+		t[i].lock = &lock;
+		t[i].values = values;
+		t[i].first = BENCH_SIZE + i * (BENCH_OPS / threads);
+		t[i].count = BENCH_OPS / threads;
+		t[i].seed = i + 1;
+		pthread_create(&ids[i], NULL, multi_thread, &t[i]);
+	}
+	for (i = 0; i < threads; i++)
+		pthread_join(ids[i], NULL);
+	double seconds = elapsed(&start);
+
+	priqueue_multi_destroy(&m);
+	priqueue_destroy(&q);
+	free(values);
+	free(t);
+	free(ids);
+	return 2.0 * BENCH_OPS / seconds;
+}
+
 int main()
 {
 	priqueue_t q, q2;
@@ -65,10 +292,93 @@ int main()
 		printf("%d ", *((int *)priqueue_at(&q2, i)) );
 	printf("\n");
 
+	void *batch[3] = { &values[25], &values[11], &values[40] };
+	priqueue_offer_all(&q, batch, 3);
+
+	printf("Elements after batch offer (expected 10 11 13 14 20 25 30 40): ");
+	for (i = 0; i < priqueue_size(&q); i++)
+		printf("%d ", *((int *)priqueue_at(&q, i)) );
+	printf("\n");
+
+	void *backlog[6] = { &values[50], &values[5], &values[70], &values[5], &values[60], &values[1] };
+	priqueue_t q3, q4;
+	priqueue_init_from_array(&q3, compare1, 0, backlog, 6);
+
+	printf("Elements built from an array (expected 1 5 5 50 60 70): ");
+	for (i = 0; i < priqueue_size(&q3); i++)
+		printf("%d ", *((int *)priqueue_at(&q3, i)) );
+	printf("\n");
+
+	printf("Equal elements keep their order (expected 1): %d\n", priqueue_at(&q3, 1) == backlog[1]);
+
+	printf("Size after meld (expected 14): %d\n", priqueue_meld(&q, &q3));
+	printf("Melded queue emptied (expected 0): %d\n", priqueue_size(&q3));
+
+	printf("Elements after meld (expected 1 5 5 10 11 13 14 20 25 30 40 50 60 70): ");
+	for (i = 0; i < priqueue_size(&q); i++)
+		printf("%d ", *((int *)priqueue_at(&q, i)) );
+	printf("\n");
+
+	/* The same queue as a 4-ary heap. */
+	priqueue_init_heap(&q4, compare1, PRIQUEUE_CACHE_ARITY);
+	for (i = 0; i < 60; i++)
+		priqueue_offer(&q4, &values[(i * 37) % 60]);
+	priqueue_offer(&q4, &values[12]);
+	int dups[3] = { 7, 7, 7 };
+	for (i = 0; i < 3; i++)
+		priqueue_offer(&q4, &dups[i]);
+	printf("Heap elements removed: %d (expected 2).\n", priqueue_remove(&q4, &values[12]));
+	priqueue_init_from_array(&q3, compare1, PRIQUEUE_CACHE_ARITY, backlog, 6);
+	printf("Heap size after meld (expected 68): %d\n", priqueue_meld(&q4, &q3));
+	printf("Meld of differently backed queues (expected -1): %d\n", priqueue_meld(&q, &q4));
+
+	int first[5];
+	printf("Heap's first elements (expected 5 0 1 1 2 3): %d ", priqueue_first_indexes(&q4, first, 5));
+	for (i = 0; i < 5; i++)
+		printf("%d ", *((int *)priqueue_at(&q4, first[i])) );
+	printf("\n");
+
+	int sorted = 1, prev = -1, next_dup = 0;
+	for (i = 0; priqueue_size(&q4) > 0; i++)
+	{
+		int *head = (int *)priqueue_poll(&q4);
+		if (*head < prev)
+			sorted = 0;
+		if (head >= dups && head < dups + 3 && head == &dups[next_dup])
+			next_dup++;
+		prev = *head;
+	}
+	printf("Heap polled in order (expected 1 68): %d %d\n", sorted, i);
+	printf("Equal heap elements polled in offer order (expected 3): %d\n", next_dup);
+
+	priqueue_destroy(&q4);
+	priqueue_destroy(&q3);
 	priqueue_destroy(&q2);
 	priqueue_destroy(&q);
 
 	free(values);
 
+	test_multi();
+
+	int threads[] = {1, 2, 4}, factors[] = {0, 1, 2, 4, 8};
+
+	printf("\nRelaxed queue rank error and throughput, %d elements queued, %d polls:\n", BENCH_SIZE, BENCH_OPS);
+	printf("  %7s %6s %5s %16s %14s %10s\n", "threads", "factor", "heaps", "mean rank error", "max rank error", "ops/s");
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 5; j++) {
+			double mean = 0.0;
+			int max = 0;
+			char factor[8] = "locked";
+
+			// A heap under one lock is never out of order
+			if (factors[j] > 0) {
+				bench_rank(threads[i] * factors[j], &mean, &max);
+				snprintf(factor, sizeof(factor), "%d", factors[j]);
+			}
+			printf("  %7d %6s %5d %16.2f %14d %10.0f\n", threads[i], factor,
+					factors[j] > 0 ? threads[i] * factors[j] : 1, mean, max, bench_throughput(threads[i], factors[j]));
+		}
+	}
+
 	return 0;
 }
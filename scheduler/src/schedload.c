@@ -0,0 +1,356 @@
+/** @file schedload.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "libservice/libservice.h"
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-n <jobs>] [-a <arrivals>] [-l <mean run time>] [-p <priorities>] [-b <records>]\n", program_name);
+	fprintf(stderr, "       %*s [-S <seed>] [-o <jobs file>] <socket>\n", (int)strlen(program_name), "");
+	fprintf(stderr, "Acts as a dispatcher for a scheduler service started with simulator -L <socket>: sends it jobs\n");
+	fprintf(stderr, "arriving at random, runs whatever it puts on each core for its run time in simulated time, and\n");
+	fprintf(stderr, "reports how many decisions per second it answered.\n");
+	fprintf(stderr, "  -n  jobs to send (default 200000)\n");
+	fprintf(stderr, "  -a  jobs arriving per time unit on average (default 90%% of what the cores can take)\n");
+	fprintf(stderr, "  -l  mean run time, run times are uniform from 1 to twice this less 1 (default 8)\n");
+	fprintf(stderr, "  -p  priorities, drawn uniformly from 0 up (default 8)\n");
+	fprintf(stderr, "  -b  most records per message (default 64, at most %d)\n", SERVICE_MAX_RECORDS);
+	fprintf(stderr, "  -S  seed for the arrivals (default 1)\n");
+	fprintf(stderr, "  -o  also write the jobs in the simulator's input format, to run them through it for comparison\n");
+}
+
+long long clock_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int compare_long_long(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+  Where the dispatcher stands: what the service has put on each core, and
+  how much of each job is left.
+*/
+typedef struct _dispatcher_t
+{
+	int cores;
+	int *core_job;	// Job on each core, -1 for none
+	long long *core_since;	// Time unit the job went on the core
+	long long *core_expiry;	// Time unit its quantum expires, -1 for none
+
+	long long *arrival;
+	int *run_time, *remaining;
+	long long *start;	// Time unit each job first ran, -1 until then
+	int done;
+	long long waiting, turnaround, response;
+} dispatcher_t;
+
+/**
+  Applies a SERVICE_ASSIGNMENTS message. Jobs taken off a core are charged
+  for the time they ran first, so a job moved from one core to another in
+  the same message is charged before it starts again. Messages carry time
+  truncated to 32 bits, so the answers are applied at time, the time unit
+  the dispatcher is in.
+ */
+void apply_assignments(dispatcher_t *d, long long time, service_header_t *h, service_assignment_t *assignment)
+{
+	int i;
+
+	for (i = 0; i < h->count; i++)
+	{
+		int core = assignment[i].core_id, job = d->core_job[core];
+
+		if (job < 0)
+			continue;
+		d->remaining[job] -= time - d->core_since[core];
+		d->core_job[core] = -1;
+		if (0 == d->remaining[job])
+		{
+			d->done++;
+			d->turnaround += time - d->arrival[job];
+			d->waiting += time - d->arrival[job] - d->run_time[job];
+			d->response += d->start[job] - d->arrival[job];
+		}
+	}
+
+	for (i = 0; i < h->count; i++)
+	{
+		int core = assignment[i].core_id, job = assignment[i].job_number;
+
+		d->core_job[core] = job;
+		d->core_since[core] = time;
+		d->core_expiry[core] = (job >= 0 && assignment[i].quantum > 0) ? time + assignment[i].quantum : -1;
+		if (job >= 0 && d->start[job] < 0)
+			d->start[job] = time;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int c, jobs = 200000, mean = 8, priorities = 8, per_message = 64;
+	double rate = 0.0;
+	unsigned int seed = 1;
+	char *jobs_file_name = NULL;
+	int i;
+
+	while ((c = getopt(argc, argv, "n:a:l:p:b:S:o:")) != -1)
+	{
+		switch (c)
+		{
+			case 'n': jobs = atoi(optarg); break;
+			case 'a': rate = atof(optarg); break;
+			case 'l': mean = atoi(optarg); break;
+			case 'p': priorities = atoi(optarg); break;
+			case 'b': per_message = atoi(optarg); break;
+			case 'S': seed = strtoul(optarg, NULL, 10); break;
+			case 'o': jobs_file_name = optarg; break;
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind != argc - 1 || jobs < 1 || mean < 1 || priorities < 1 || per_message < 1
+			|| per_message > SERVICE_MAX_RECORDS || rate < 0.0)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	int fd = service_connect(argv[optind]);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Unable to connect to \"%s\".\n", argv[optind]);
+		return 2;
+	}
+
+	service_buffer_t in, out;
+	service_header_t *header;
+	void *records;
+	int status;
+
+	service_buffer_init(&in);
+	service_buffer_init(&out);
+	while ((status = service_next(&in, &header, &records)) == 0 && service_fill(&in, fd) > 0)
+		;
+	if (status != 1 || header->type != SERVICE_HELLO)
+	{
+		fprintf(stderr, "The service at \"%s\" did not say hello.\n", argv[optind]);
+		return 2;
+	}
+
+	service_hello_t hello = *(service_hello_t *)records;
+	if (rate == 0.0)
+		rate = 0.9 * hello.cores / mean;
+	printf("Connected to \"%s\": %d core(s), scheme %d, %.2f job(s) arriving per time unit.\n",
+			argv[optind], hello.cores, hello.scheme, rate);
+
+	dispatcher_t d;
+	memset(&d, 0, sizeof(d));
+	d.cores = hello.cores;
+	d.core_job = malloc(d.cores * sizeof(int));
+	d.core_since = malloc(d.cores * sizeof(long long));
+	d.core_expiry = malloc(d.cores * sizeof(long long));
+	for (i = 0; i < d.cores; i++)
+		d.core_job[i] = d.core_expiry[i] = -1;
+
+	// Every job is drawn up front, so the same seed sends the same jobs
+	d.arrival = malloc(jobs * sizeof(long long));
+	d.run_time = malloc(jobs * sizeof(int));
+	d.remaining = malloc(jobs * sizeof(int));
+	d.start = malloc(jobs * sizeof(long long));
+	int *priority = malloc(jobs * sizeof(int));
+	for (i = 0; i < jobs; i++)
+	{
+		d.arrival[i] = (long long)(i / rate);
+		d.run_time[i] = d.remaining[i] = 1 + rand_r(&seed) % (2 * mean - 1);
+		priority[i] = rand_r(&seed) % priorities;
+		d.start[i] = -1;
+	}
+
+	if (jobs_file_name != NULL)
+	{
+		FILE *file = fopen(jobs_file_name, "w");
+		if (file == NULL)
+		{
+			fprintf(stderr, "Unable to create \"%s\".\n", jobs_file_name);
+			return 2;
+		}
+		for (i = 0; i < jobs; i++)
+			fprintf(file, "%lld,%d,%d\n", d.arrival[i], d.run_time[i], priority[i]);
+		fclose(file);
+	}
+
+	service_event_t *finished = malloc(d.cores * sizeof(service_event_t));
+	service_event_t *expired = malloc(d.cores * sizeof(service_event_t));
+	long long *round_trip = malloc(sizeof(long long) * 1024);
+	int round_trips = 0, round_trip_size = 1024;
+	long long messages = 0, records_sent = 0;
+	long long time = 0;
+	int next = 0, stalled = 0;
+	long long start = clock_ns();
+
+	/*
+	 * Each time unit the completions and quantum expiries due are sent,
+	 * then the arrivals, all back to back; the answers to all of them are
+	 * read before moving on, so the dispatcher always knows what every
+	 * core runs.
+	 */
+	while (d.done < jobs)
+	{
+		int finishing = 0, expiring = 0, arriving, sent = 0;
+
+		for (i = 0; i < d.cores; i++)
+		{
+			int job = d.core_job[i];
+
+			if (job < 0)
+				continue;
+			if (d.core_since[i] + d.remaining[job] == time)
+			{
+				finished[finishing].core_id = i;
+				finished[finishing++].job_number = job;
+			}
+			else if (d.core_expiry[i] == time)
+			{
+				expired[expiring].core_id = i;
+				expired[expiring++].job_number = job;
+			}
+		}
+		for (arriving = 0; next + arriving < jobs && d.arrival[next + arriving] == time; arriving++)
+			;
+
+		for (i = 0; i < finishing; i += per_message, sent++)
+		{
+			int count = (finishing - i < per_message) ? finishing - i : per_message;
+			memcpy(service_append(&out, SERVICE_FINISHED, (int32_t)time, count), &finished[i], count * sizeof(service_event_t));
+		}
+		for (i = 0; i < expiring; i += per_message, sent++)
+		{
+			int count = (expiring - i < per_message) ? expiring - i : per_message;
+			memcpy(service_append(&out, SERVICE_EXPIRED, (int32_t)time, count), &expired[i], count * sizeof(service_event_t));
+		}
+		for (i = 0; i < arriving; i += per_message, sent++)
+		{
+			int count = (arriving - i < per_message) ? arriving - i : per_message;
+			service_arrival_t *arrival = service_append(&out, SERVICE_ARRIVALS, (int32_t)time, count);
+
+			for (int j = 0; j < count; j++, next++)
+			{
+				arrival[j].job_number = next;
+				arrival[j].running_time = d.run_time[next];
+				arrival[j].priority = priority[next];
+				arrival[j].deadline = -1;
+				arrival[j].cores = 1;
+			}
+		}
+
+		if (sent > 0)
+		{
+			long long sent_at = clock_ns();
+
+			if (service_flush(&out, fd) != 0)
+			{
+				fprintf(stderr, "The service closed the connection.\n");
+				return 2;
+			}
+			for (int received = 0; received < sent; )
+			{
+				while (received < sent && (status = service_next(&in, &header, &records)) == 1)
+				{
+					if (header->type == SERVICE_ASSIGNMENTS)
+					{
+						apply_assignments(&d, time, header, records);
+						received++;
+					}
+				}
+				if (received < sent && (status < 0 || service_fill(&in, fd) < 0))
+				{
+					fprintf(stderr, "The service closed the connection.\n");
+					return 2;
+				}
+			}
+
+			if (round_trips == round_trip_size)
+			{
+				round_trip_size *= 2;
+				round_trip = realloc(round_trip, round_trip_size * sizeof(long long));
+			}
+			round_trip[round_trips++] = clock_ns() - sent_at;
+			messages += sent;
+			records_sent += finishing + expiring + arriving;
+		}
+
+		// Skip ahead to the next time unit anything happens in
+		long long upcoming = (next < jobs) ? d.arrival[next] : -1;
+		for (i = 0; i < d.cores; i++)
+		{
+			int job = d.core_job[i];
+			long long due;
+
+			if (job < 0)
+				continue;
+			due = d.core_since[i] + d.remaining[job];
+			if (d.core_expiry[i] > time && d.core_expiry[i] < due)
+				due = d.core_expiry[i];
+			if (upcoming < 0 || due < upcoming)
+				upcoming = due;
+		}
+		if (upcoming <= time)
+		{
+			stalled = d.done < jobs;
+			break;
+		}
+		time = upcoming;
+	}
+
+	double seconds = (clock_ns() - start) / 1e9;
+	qsort(round_trip, round_trips, sizeof(long long), compare_long_long);
+
+	printf("Sent %d job(s) over %lld time unit(s) in %.3f s.\n", next, time, seconds);
+	printf("  Messages: %lld, %lld records (arrivals, completions and quantum expiries)\n", messages, records_sent);
+	printf("  Decisions: %.0f/s\n", seconds > 0 ? records_sent / seconds : 0.0);
+	if (round_trips > 0)
+		printf("  Round trip per time unit p50/p90/p99/max: %.1f/%.1f/%.1f/%.1f us\n",
+				round_trip[(round_trips - 1) * 50 / 100] / 1e3, round_trip[(round_trips - 1) * 90 / 100] / 1e3,
+				round_trip[(round_trips - 1) * 99 / 100] / 1e3, round_trip[round_trips - 1] / 1e3);
+
+	if (stalled)
+	{
+		printf("All cores are idle and %d job(s) remain unscheduled.\n", jobs - d.done);
+		return 3;
+	}
+
+	printf("\n");
+	printf("Average Waiting Time: %.2f\n", (double)d.waiting / jobs);
+	printf("Average Turnaround Time: %.2f\n", (double)d.turnaround / jobs);
+	printf("Average Response Time: %.2f\n", (double)d.response / jobs);
+
+	close(fd);
+	service_buffer_destroy(&in);
+	service_buffer_destroy(&out);
+	free(d.core_job);
+	free(d.core_since);
+	free(d.core_expiry);
+	free(d.arrival);
+	free(d.run_time);
+	free(d.remaining);
+	free(d.start);
+	free(priority);
+	free(finished);
+	free(expired);
+	free(round_trip);
+	return 0;
+}
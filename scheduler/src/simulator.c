@@ -8,22 +8,1001 @@
 #include <unistd.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <sys/wait.h>
 
 #include "libscheduler/libscheduler.h"
+#include "libpriqueue/libpriqueue.h"
+#include "libtrace/libtrace.h"
+#include "libreplay/libreplay.h"
+#include "libwheel/libwheel.h"
+#include "libsnapshot/libsnapshot.h"
+#include "libexecutor/libexecutor.h"
+#include "libservice/libservice.h"
+#include "libserver/libserver.h"
+#include "libstats/libstats.h"
+
+// Least time between snapshots on the stats page (-M)
+#define STATS_INTERVAL_NS 100000000LL
 
 
 typedef struct _simulator_job_list_t
 {
-	int job_id, arrival_time, run_time, priority;
+	int job_id, arrival_time, run_time, priority, deadline;
 	int core_id, arrived;
+	int last_core;
+	int stall;	// Switch and migration overhead left before the job progresses
+	int last_time;	// Last time unit the job ran in
+	int progress;	// Work done towards the next unit of run time, in CORE_SPEED_ONE units
+	int width;	// Cores the job needs at once (gang)
 } simulator_job_list_t;
 
+/**
+  Order of the serial simulation's job list, which loses a finished job by
+  moving its last job into the gap. Jobs finishing or arriving in the same
+  time unit reach the scheduler in list order, so a worker simulating busy
+  periods on their own (-j) keeps its jobs' serial positions here.
+*/
+typedef struct _job_order_t
+{
+	int *job;	// Job at each position
+	int *position;	// Position of each job
+	int length;
+} job_order_t;
+
+/**
+  What a worker hands back after simulating a run of busy periods. It is
+  followed on the pipe by the worker's core_busy and core_work, by each
+  core's timing diagram as a length and that many characters, and by the
+  run's jobs in the order they left the job list.
+*/
+typedef struct _period_result_t
+{
+	scheduler_job_totals_t totals;
+	int core_changes, resumes, cross_llc, cross_node;
+	int time;	// Time unit the worker stopped in
+} period_result_t;
+
+#define PERIOD_WAITING 0
+#define PERIOD_RUNNING 1
+#define PERIOD_DONE 2
+
+// Runs of busy periods per worker, so workers rarely wait on each other
+#define PERIOD_RUNS_PER_WORKER 4
+
+/**
+  A run of busy periods simulated by one worker, and the worker's results.
+*/
+typedef struct _busy_period_t
+{
+	int start, end;	// Arrival times covered, end 0 for no limit
+	int jobs_before, jobs;	// Jobs arriving before start, and from start up to end
+	int state;
+	pid_t pid;
+	int fd;	// Worker's pipe, the write end in the worker itself
+	period_result_t result;
+	int *counts;	// core_busy followed by core_work
+	char **diagram;
+	int *finished;	// Jobs in the order they left the job list
+} busy_period_t;
+
 void print_usage(char *program_name)
 {
-	fprintf(stderr, "Usage: %s -c <cores> -s <scheme> <input file>\n", program_name);
+	fprintf(stderr, "Usage: %s -c <cores> -s <scheme> [-m] [-q] [-t <trace file>] [-r <decision log>]\n", program_name);
+	fprintf(stderr, "       %*s [-l <quanta>] [-b <boost period>] [-p <placement>] [-S <seed>] [-u] [-f] [-a <interval>]\n", (int)strlen(program_name), "");
+	fprintf(stderr, "       %*s [-w <switch cost>] [-x <migration cost>] [-A <window>] [-T <topology file>] [-K <speeds>] [-j <workers>]\n", (int)strlen(program_name), "");
+	fprintf(stderr, "       %*s [-D] [-C <time>,<checkpoint>] [-E <microseconds>] [-M <stats file>] <input file>\n", (int)strlen(program_name), "");
+	fprintf(stderr, "       %s -R <checkpoint> [-s <scheme>] [-l <quanta>] [-b <boost period>] [-p <placement>] [-S <seed>]\n", program_name);
+	fprintf(stderr, "       %*s [-C <time>,<checkpoint>] [-u] [-f] [-m] [-q] [-D]\n", (int)strlen(program_name), "");
+	fprintf(stderr, "       %s -V <decision log>\n", program_name);
+	fprintf(stderr, "       %s -L <socket> -c <cores> -s <scheme> [-l <quanta>] [-b <boost period>] [-p <placement>] [-S <seed>]\n", program_name);
+	fprintf(stderr, "       %*s [-a <interval>] [-A <window>] [-T <topology file>] [-K <speeds>]\n", (int)strlen(program_name), "");
 	fprintf(stderr, "       %s -c 2 -s fcfs examples/proc1.csv\n", program_name);
 	fprintf(stderr, "\n");
-	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#\n");
+	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#, mlfq, ws, edf, stride#, lottery#, gang\n");
+	fprintf(stderr, "Input rows are: arrival time, run time, priority[, absolute deadline[, cores]]\n");
+	fprintf(stderr, "  -l  comma separated MLFQ quanta, one per level (default 2,4,8)\n");
+	fprintf(stderr, "  -b  MLFQ priority boost period, 0 to disable (default 100)\n");
+	fprintf(stderr, "  -p  WS run queue placement: rr, least or p2c (default rr)\n");
+	fprintf(stderr, "  -S  seed for p2c placement and lottery draws (default 1)\n");
+	fprintf(stderr, "  -u  report per-core utilization and migrations\n");
+	fprintf(stderr, "  -f  report each priority's CPU share against its share weight\n");
+	fprintf(stderr, "  -a  age waiting pri, ppri, sjf and psjf jobs one step per interval and report the starvation bound\n");
+	fprintf(stderr, "  -w  time units a core spends switching to a different job (default 0)\n");
+	fprintf(stderr, "  -x  extra time units a job spends resuming on a different core (default 0)\n");
+	fprintf(stderr, "  -A  let a core pick one of the next <window> queued jobs that last ran on it\n");
+	fprintf(stderr, "  -T  file of \"core llc node\" lines placing every core in a cache domain and NUMA node\n");
+	fprintf(stderr, "  -K  comma separated speed of each core, 1 for nominal (Eg: -K 2,2,1,1)\n");
+	fprintf(stderr, "  -j  simulate independent busy periods in up to <workers> processes (-q runs of fcfs, sjf, psjf,\n");
+	fprintf(stderr, "      pri, ppri, edf and gang without deadlines, -t, -r, -m, -f, -a, -w, -x, -K, -C or -R)\n");
+	fprintf(stderr, "  -D  leave out the final timing diagram\n");
+	fprintf(stderr, "  -C  save the whole simulation to a checkpoint at the start of time unit <time> and carry on\n");
+	fprintf(stderr, "  -R  carry on from a checkpoint; with -s the jobs left are scheduled again under that scheme\n");
+	fprintf(stderr, "  -E  run the jobs for real, one pinned worker thread per core spinning <microseconds> per time\n");
+	fprintf(stderr, "      unit, and report wall-clock dispatch latency and throughput (not with gang, -j, -t, -r,\n");
+	fprintf(stderr, "      -u, -f, -w, -x, -K, -C or -R)\n");
+	fprintf(stderr, "  -L  take jobs from clients of a Unix domain socket instead of a file and answer with core\n");
+	fprintf(stderr, "      assignments until interrupted (see schedload)\n");
+	fprintf(stderr, "  -M  keep a shared-memory stats page of the run up to date for other tools to poll, about ten\n");
+	fprintf(stderr, "      times a second (see statwatch; not with -j, -E, -L or -R)\n");
+	fprintf(stderr, "  -m  dump hot-path metrics to stderr (requires a METRICS=1 build)\n");
+	fprintf(stderr, "  -q  do not print the per-time-unit output\n");
+	fprintf(stderr, "  -t  record a binary event trace (see tracetool)\n");
+	fprintf(stderr, "  -r  record every scheduler call and its result\n");
+	fprintf(stderr, "  -V  replay a decision log through the scheduler and report the first difference\n");
+}
+
+const char *replay_call_name(int call)
+{
+	switch (call)
+	{
+		case REPLAY_START_UP: return "scheduler_start_up";
+		case REPLAY_CONFIGURE_MLFQ: return "scheduler_configure_mlfq";
+		case REPLAY_CONFIGURE_WS: return "scheduler_configure_ws";
+		case REPLAY_CONFIGURE_SHARE: return "scheduler_configure_share";
+		case REPLAY_CONFIGURE_AGING: return "scheduler_configure_aging";
+		case REPLAY_CONFIGURE_AFFINITY: return "scheduler_configure_affinity";
+		case REPLAY_CONFIGURE_TOPOLOGY: return "scheduler_configure_topology";
+		case REPLAY_CONFIGURE_SPEEDS: return "scheduler_configure_speeds";
+		case REPLAY_NEW_JOB: return "scheduler_new_job";
+		case REPLAY_NEW_JOBS: return "scheduler_new_jobs";
+		case REPLAY_JOB_FINISHED: return "scheduler_job_finished";
+		case REPLAY_QUANTUM_EXPIRED: return "scheduler_quantum_expired";
+		case REPLAY_AVERAGE_WAITING: return "scheduler_average_waiting_time";
+		case REPLAY_AVERAGE_TURNAROUND: return "scheduler_average_turnaround_time";
+		case REPLAY_AVERAGE_RESPONSE: return "scheduler_average_response_time";
+	}
+	return "unknown";
+}
+
+int verify_decision_log(char *log_name)
+{
+	replay_log_t log;
+	replay_record_t actual;
+
+	if (replay_log_load(&log, log_name) != 0)
+	{
+		fprintf(stderr, "Unable to read decision log \"%s\".\n", log_name);
+		return 2;
+	}
+
+	long index = replay_verify(&log, &actual);
+
+	if (index == -1)
+	{
+		printf("Replayed %ld scheduler calls, all decisions match.\n", log.count);
+		replay_log_destroy(&log);
+		return 0;
+	}
+
+	replay_record_t *expected = &log.records[index];
+	if (expected->call == REPLAY_NEW_JOBS && index + expected->args[0] >= log.count)
+	{
+		printf("Decision %ld: the log ends inside its batch of %d job(s).\n", index, expected->args[0]);
+		replay_log_destroy(&log);
+		return 4;
+	}
+	printf("Decision %ld differs: %s(%d, %d, %d, %d, %d) recorded %d, replayed %d.\n", index,
+			replay_call_name(expected->call), expected->args[0], expected->args[1], expected->args[2], expected->args[3],
+			expected->args[4], expected->result, actual.result);
+
+	replay_log_destroy(&log);
+	return 4;
+}
+
+void print_metrics(unsigned long long sim_cycles, unsigned long long sim_jobs_scanned)
+{
+	scheduler_metrics_t m;
+	scheduler_get_metrics(&m);
+
+	if (!m.enabled)
+	{
+		fprintf(stderr, "Metrics are not compiled in; rebuild with `make clean && make METRICS=1`.\n");
+		return;
+	}
+
+	unsigned long long api_cycles = m.new_job.cycles + m.new_jobs.cycles + m.job_finished.cycles + m.quantum_expired.cycles;
+
+	fprintf(stderr, "\nMETRICS:\n");
+	fprintf(stderr, "  comparisons:        %llu\n", m.comparisons);
+	fprintf(stderr, "  queue offers:       %llu\n", m.queue_offers);
+	fprintf(stderr, "  queue polls:        %llu\n", m.queue_polls);
+	fprintf(stderr, "  queue removes:      %llu\n", m.queue_removes);
+	fprintf(stderr, "  queue bytes copied: %llu\n", m.queue_bytes_copied);
+	fprintf(stderr, "  preemptions:        %llu\n", m.preemptions);
+	fprintf(stderr, "  context switches:   %llu\n", m.context_switches);
+	fprintf(stderr, "  tick sweeps:        %llu (%llu jobs scanned, %llu cycles)\n", m.ticks, m.tick_jobs_scanned, m.tick_cycles);
+	fprintf(stderr, "  new_job:            %llu calls, %.1f cycles/call\n", m.new_job.calls,
+			m.new_job.calls ? (double)m.new_job.cycles / m.new_job.calls : 0.0);
+	fprintf(stderr, "  new_jobs:           %llu calls, %.1f cycles/call\n", m.new_jobs.calls,
+			m.new_jobs.calls ? (double)m.new_jobs.cycles / m.new_jobs.calls : 0.0);
+	fprintf(stderr, "  job_finished:       %llu calls, %.1f cycles/call\n", m.job_finished.calls,
+			m.job_finished.calls ? (double)m.job_finished.cycles / m.job_finished.calls : 0.0);
+	fprintf(stderr, "  quantum_expired:    %llu calls, %.1f cycles/call\n", m.quantum_expired.calls,
+			m.quantum_expired.calls ? (double)m.quantum_expired.cycles / m.quantum_expired.calls : 0.0);
+	fprintf(stderr, "  simulator:          %llu cycles total, %llu outside the scheduler, %llu jobs scanned\n",
+			sim_cycles, sim_cycles > api_cycles ? sim_cycles - api_cycles : 0, sim_jobs_scanned);
+}
+
+const char *placement_name(int placement)
+{
+	switch (placement)
+	{
+		case PLACE_ROUND_ROBIN: return "round-robin";
+		case PLACE_LEAST_LOADED: return "least-loaded";
+		case PLACE_TWO_CHOICES: return "power-of-two-choices";
+	}
+	return "unknown";
+}
+
+/**
+  Whether the scheme expects scheduler_quantum_expired() calls.
+ */
+int uses_quantum(int scheme)
+{
+	return scheme == RR || scheme == MLFQ || scheme == STRIDE || scheme == LOTTERY;
+}
+
+/**
+  Quantum to arm a core's clock with after it was given a new job.
+ */
+int core_quantum(int scheme, int quantum, int core_id)
+{
+	if (scheme == MLFQ)
+		return scheduler_core_quantum(core_id);
+	return quantum;
+}
+
+/**
+  Reads a topology file. Each line is a core id, its last-level cache
+  domain and its NUMA node, separated by spaces; blank lines and lines
+  starting with '#' are skipped. Every core must be listed.
+
+  @return 0 on success, otherwise an error has been printed
+ */
+int load_topology(const char *path, int cores, int *llc, int *node)
+{
+	FILE *file = fopen(path, "r");
+	char line[256];
+	int line_number = 0, listed = 0, core, core_llc, core_node;
+
+	if (file == NULL)
+	{
+		fprintf(stderr, "Unable to open topology file \"%s\".\n", path);
+		return 1;
+	}
+
+	for (core = 0; core < cores; core++)
+		llc[core] = -1;
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		line_number++;
+		if (line[strspn(line, " \t\r\n")] == '\0' || line[strspn(line, " \t")] == '#')
+			continue;
+
+		if (sscanf(line, "%d %d %d", &core, &core_llc, &core_node) != 3 || core < 0 || core_llc < 0 || core_node < 0)
+		{
+			fprintf(stderr, "%s:%d: expected \"core llc node\".\n", path, line_number);
+			fclose(file);
+			return 1;
+		}
+		if (core >= cores)
+			continue;
+
+		if (llc[core] == -1)
+			listed++;
+		llc[core] = core_llc;
+		node[core] = core_node;
+	}
+	fclose(file);
+
+	if (listed != cores)
+	{
+		fprintf(stderr, "Topology file \"%s\" lists %d of the %d cores.\n", path, listed, cores);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+  Writes the timing diagram symbol of a job: 0-9, then a-z, then A-Z,
+  then the id in parentheses.
+ */
+void job_symbol(char *buf, size_t size, int job_id)
+{
+	if (job_id < 10)
+		snprintf(buf, size, "%d", job_id);
+	else if (job_id < 10 + 26)
+		snprintf(buf, size, "%c", job_id - 10 + 'a');
+	else if (job_id < 10 + 26 + 26)
+		snprintf(buf, size, "%c", job_id - 10 - 26 + 'A');
+	else
+		snprintf(buf, size, "(%d)", job_id);
+}
+
+/**
+  Brings the record of which job runs on each core in line with the
+  scheduler after a gang scheduling call, which can start several jobs,
+  each on several cores, at once. A job's core_id is the lowest core it
+  holds.
+ */
+void gang_sync(int *core_job, int cores, simulator_job_list_t *jobs, int active_jobs,
+		trace_writer_t *trace, int quiet, int time)
+{
+	for (int core = 0; core < cores; core++)
+	{
+		int job_id = scheduler_core_job(core);
+		if (job_id == core_job[core])
+			continue;
+
+		core_job[core] = job_id;
+		for (int i = 0; i < active_jobs && job_id != -1; i++)
+		{
+			if (jobs[i].job_id != job_id || !jobs[i].arrived)
+				continue;
+
+			if (jobs[i].core_id == -1)
+			{
+				if (trace != NULL)
+					trace_record(trace, TRACE_DISPATCH, time, job_id, core, 0, 0, 0);
+				if (!quiet)
+					printf("Job %d is now running on %d core(s) from core %d.\n\n", job_id, jobs[i].width, core);
+			}
+			if (jobs[i].core_id == -1 || jobs[i].core_id > core)
+				jobs[i].core_id = core;
+			break;
+		}
+	}
+}
+
+/**
+  Takes on the cores a scheduler forked from a checkpoint (-R with -s)
+  gave the jobs. A job that lost or changed its core stops its completion
+  timer, as if preempted, and every core starts a fresh quantum if the new
+  scheme has one.
+ */
+void fork_sync(int scheme, int quantum, int cores, simulator_job_list_t *jobs, int active_jobs, int *job_index,
+		int *gang_core_job, timer_wheel_t *finish_wheel, wheel_timer_t *finish_timer,
+		timer_wheel_t *quantum_wheel, wheel_timer_t *quantum_timer, int *quantum_length)
+{
+	int i, core;
+	int *old_core = malloc((active_jobs + 1) * sizeof(int));
+
+	for (i = 0; i < active_jobs; i++)
+	{
+		old_core[i] = jobs[i].core_id;
+		jobs[i].core_id = -1;
+	}
+
+	// A job's core_id is the lowest core it holds
+	for (core = 0; core < cores; core++)
+	{
+		int job_id = scheduler_core_job(core);
+
+		gang_core_job[core] = (scheme == GANG) ? job_id : -1;
+		if (job_id != -1 && jobs[job_index[job_id]].core_id == -1)
+			jobs[job_index[job_id]].core_id = core;
+
+		wheel_cancel(quantum_wheel, &quantum_timer[core]);
+		quantum_length[core] = uses_quantum(scheme) ? core_quantum(scheme, quantum, core) : -1;
+	}
+
+	for (i = 0; i < active_jobs; i++)
+		if (jobs[i].core_id != old_core[i])
+			wheel_cancel(finish_wheel, &finish_timer[jobs[i].job_id]);
+	free(old_core);
+}
+
+void job_order_init(job_order_t *order, int jobs)
+{
+	order->job = malloc(jobs * sizeof(int));
+	order->position = malloc(jobs * sizeof(int));
+	order->length = jobs;
+	for (int i = 0; i < jobs; i++)
+		order->job[i] = order->position[i] = i;
+}
+
+void job_order_remove(job_order_t *order, int job_id)
+{
+	int position = order->position[job_id];
+	int last = order->job[--order->length];
+
+	order->job[position] = last;
+	order->position[last] = position;
+}
+
+void job_order_destroy(job_order_t *order)
+{
+	free(order->job);
+	free(order->position);
+}
+
+int compare_key(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+  Sorts job list indices by the position of their jobs in order.
+ */
+void sort_by_position(int *index, int count, simulator_job_list_t *jobs, job_order_t *order)
+{
+	long long *keys = malloc(count * sizeof(long long));
+	int k;
+
+	for (k = 0; k < count; k++)
+		keys[k] = (long long)order->position[jobs[index[k]].job_id] << 32 | index[k];
+	qsort(keys, count, sizeof(long long), compare_key);
+	for (k = 0; k < count; k++)
+		index[k] = (int)(keys[k] & 0xffffffff);
+
+	free(keys);
+}
+
+/**
+  Whether the scheme keeps no state from one busy period to the next, so
+  periods can be simulated apart and give the same results.
+ */
+int busy_periods_independent(int scheme)
+{
+	return scheme == FCFS || scheme == SJF || scheme == PSJF || scheme == PRI || scheme == PPRI
+		|| scheme == EDF || scheme == GANG;
+}
+
+int compare_arrival(const void *a, const void *b)
+{
+	return ((simulator_job_list_t *)a)->arrival_time - ((simulator_job_list_t *)b)->arrival_time;
+}
+
+/**
+  Splits the trace at busy period boundaries into at most chunks runs of
+  about equal work. While work is left at least one core is busy (the
+  simulation fails otherwise), so the work left falls by at least one unit
+  per time unit and every job is done no later than it would be on a
+  single core. Wherever that single core's backlog has drained before the
+  next arrival, all cores are idle with nothing queued, whatever the core
+  count.
+
+  @return the number of runs; run k holds the jobs arriving from cut[k]
+    up to cut[k + 1], the last one every job from cut[runs - 1] on
+ */
+int busy_period_cuts(simulator_job_list_t *jobs, int count, int chunks, int *cut)
+{
+	simulator_job_list_t *sorted = malloc(count * sizeof(simulator_job_list_t));
+	long long total_work = 0, work = 0;
+	int backlog_end = 0, runs = 1;
+
+	memcpy(sorted, jobs, count * sizeof(simulator_job_list_t));
+	qsort(sorted, count, sizeof(simulator_job_list_t), compare_arrival);
+	for (int i = 0; i < count; i++)
+		total_work += sorted[i].run_time;
+
+	cut[0] = 0;
+	for (int i = 0; i < count; )
+	{
+		int time = sorted[i].arrival_time;
+		if (i > 0 && backlog_end <= time && runs < chunks && work * chunks >= total_work * runs)
+			cut[runs++] = time;
+
+		for (; i < count && sorted[i].arrival_time == time; i++)
+		{
+			backlog_end = (backlog_end > time ? backlog_end : time) + sorted[i].run_time;
+			work += sorted[i].run_time;
+		}
+	}
+
+	free(sorted);
+	return runs;
+}
+
+int write_all(int fd, const void *buffer, size_t size)
+{
+	for (const char *next = buffer; size > 0; )
+	{
+		ssize_t written = write(fd, next, size);
+		if (written <= 0)
+			return -1;
+		next += written;
+		size -= written;
+	}
+	return 0;
+}
+
+int read_all(int fd, void *buffer, size_t size)
+{
+	for (char *next = buffer; size > 0; )
+	{
+		ssize_t got = read(fd, next, size);
+		if (got <= 0)
+			return -1;
+		next += got;
+		size -= got;
+	}
+	return 0;
+}
+
+/**
+  Sends a worker's results to the parent.
+
+  @return 0 on success
+ */
+int send_period_result(int fd, period_result_t *result, int cores, int *core_busy, int *core_work,
+		char **diagram, int *finished)
+{
+	if (write_all(fd, result, sizeof(period_result_t)) != 0
+		|| write_all(fd, core_busy, cores * sizeof(int)) != 0
+		|| write_all(fd, core_work, cores * sizeof(int)) != 0)
+		return -1;
+
+	for (int core = 0; core < cores; core++)
+	{
+		int length = strlen(diagram[core]);
+		if (write_all(fd, &length, sizeof(int)) != 0 || write_all(fd, diagram[core], length) != 0)
+			return -1;
+	}
+
+	return write_all(fd, finished, result->totals.jobs * sizeof(int));
+}
+
+/**
+  Receives the results of the worker simulating period.
+
+  @return 0 on success
+ */
+int receive_period_result(busy_period_t *period, int cores)
+{
+	period->counts = malloc(2 * cores * sizeof(int));
+	period->diagram = calloc(cores, sizeof(char *));
+	period->finished = malloc(period->jobs * sizeof(int));
+
+	if (read_all(period->fd, &period->result, sizeof(period_result_t)) != 0
+		|| period->result.totals.jobs != period->jobs
+		|| read_all(period->fd, period->counts, 2 * cores * sizeof(int)) != 0)
+		return -1;
+
+	for (int core = 0; core < cores; core++)
+	{
+		int length;
+		if (read_all(period->fd, &length, sizeof(int)) != 0)
+			return -1;
+
+		period->diagram[core] = malloc(length + 1);
+		if (read_all(period->fd, period->diagram[core], length) != 0)
+			return -1;
+		period->diagram[core][length] = '\0';
+	}
+
+	return read_all(period->fd, period->finished, period->jobs * sizeof(int));
+}
+
+/**
+  Simulates runs of busy periods in worker processes, at most workers at a
+  time, each worker with a scheduler of its own. A run only starts once
+  its jobs have their final positions in the serial job list at the start
+  of the run: until then an earlier run may still move them to the gap of
+  a finished job. Every job of the runs before has finished by then, so
+  the earliest run not yet started can always go.
+
+  @return -1 in a worker, with *worker set to the run to simulate; 0 in the
+    parent once every run has reported; or the exit status of a failed
+    worker
+ */
+int run_busy_periods(busy_period_t *periods, int runs, int workers, simulator_job_list_t *jobs, int count,
+		job_order_t *order, int cores, int *worker)
+{
+	int *run_of = malloc(count * sizeof(int));
+	int *ready = malloc(runs * sizeof(int));
+	int applied = 0, running = 0, failed = 0;
+	int i, k;
+
+	for (i = 0; i < count; i++)
+		for (run_of[i] = runs - 1; periods[run_of[i]].start > jobs[i].arrival_time; run_of[i]--)
+			;
+
+	while (applied < runs && !failed)
+	{
+		for (k = 0; k < runs; k++)
+			ready[k] = periods[k].state == PERIOD_WAITING;
+		for (i = 0; i < count; i++)
+			if (order->position[i] >= count - periods[run_of[i]].jobs_before)
+				ready[run_of[i]] = 0;
+
+		for (k = 0; k < runs && running < workers; k++)
+		{
+			int fds[2];
+			pid_t pid = -1;
+
+			if (!ready[k])
+				continue;
+
+			fflush(stdout);
+			if (pipe(fds) != 0 || (pid = fork()) < 0)
+			{
+				fprintf(stderr, "Unable to start a worker process.\n");
+				failed = 2;
+				break;
+			}
+
+			if (pid == 0)
+			{
+				for (i = 0; i < runs; i++)
+					if (periods[i].state == PERIOD_RUNNING)
+						close(periods[i].fd);
+				close(fds[0]);
+				periods[k].fd = fds[1];
+				*worker = k;
+				free(run_of);
+				free(ready);
+				return -1;
+			}
+
+			close(fds[1]);
+			periods[k].pid = pid;
+			periods[k].fd = fds[0];
+			periods[k].state = PERIOD_RUNNING;
+			running++;
+		}
+
+		// Collect the earliest run still going, then bring the job list
+		// up to date with every run reported in order
+		for (k = applied; k < runs && periods[k].state != PERIOD_RUNNING; k++)
+			;
+		if (k == runs)
+			break;
+
+		int status;
+		if (receive_period_result(&periods[k], cores) != 0)
+			failed = 2;
+		close(periods[k].fd);
+		waitpid(periods[k].pid, &status, 0);
+		if (!failed && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+			failed = WIFEXITED(status) ? WEXITSTATUS(status) : 3;
+		periods[k].state = PERIOD_DONE;
+		running--;
+
+		for (; applied < runs && periods[applied].state == PERIOD_DONE; applied++)
+			for (i = 0; i < periods[applied].jobs; i++)
+				job_order_remove(order, periods[applied].finished[i]);
+	}
+
+	// Leave no worker behind after a failure
+	for (k = 0; k < runs; k++)
+	{
+		if (periods[k].state == PERIOD_RUNNING)
+		{
+			close(periods[k].fd);
+			waitpid(periods[k].pid, NULL, 0);
+		}
+	}
+
+	free(run_of);
+	free(ready);
+	return failed;
+}
+
+int compare_int(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/**
+  Publishes a snapshot of the run to the stats page (-M). Jobs not yet
+  arrived are in neither arrived nor finished.
+ */
+void publish_stats(stats_writer_t *stats, int time, int arrived, int finished, long long expiries,
+		int queued, int running, const int *core_busy, int done)
+{
+	stats_sample_t sample;
+
+	sample.time = time;
+	sample.events = arrived + finished + expiries;
+	sample.finished = finished;
+	sample.alive = arrived - finished;
+	sample.queued = queued;
+	sample.running = running;
+	stats_publish(stats, &sample, core_busy, done);
+}
+
+/**
+  Whether fast_forward() can stand in for the simulation: the scheme never
+  takes a job off its core, and every job arrives, runs and fits on a
+  single core. PRI runs also need priorities of 0 or more, where finished
+  jobs (left in the queue at priority 0) never get ahead of waiting ones.
+ */
+int fast_forward_applies(int scheme, simulator_job_list_t *jobs, int count)
+{
+	if (scheme != FCFS && scheme != SJF && scheme != PRI)
+		return 0;
+
+	for (int i = 0; i < count; i++)
+		if (jobs[i].arrival_time < 0 || jobs[i].run_time <= 0 || jobs[i].width != 1
+			|| (scheme == PRI && jobs[i].priority < 0))
+			return 0;
+
+	return 1;
+}
+
+/**
+  Appends count copies of symbol to a timing diagram holding *length
+  characters in *size bytes.
+ */
+void diagram_append(char **diagram, size_t *length, size_t *size, const char *symbol, int count)
+{
+	size_t symbol_length = strlen(symbol);
+
+	if (*length + symbol_length * count >= *size)
+	{
+		while (*length + symbol_length * count >= *size)
+			*size = *size ? 2 * *size : 1024;
+		*diagram = realloc(*diagram, *size);
+	}
+
+	for (; count > 0; count--, *length += symbol_length)
+		memcpy(*diagram + *length, symbol, symbol_length);
+	(*diagram)[*length] = '\0';
+}
+
+/**
+  Starts job on core at time for fast_forward(), filling in the core's
+  timing diagram, if any, up to when the job will be done.
+ */
+void fast_forward_start(simulator_job_list_t *job, int core, int time, priqueue_t *running, int *core_end,
+		int *core_job, char **diagram, size_t *diagram_length, size_t *diagram_size)
+{
+	if (diagram != NULL)
+	{
+		char symbol[11];
+		job_symbol(symbol, sizeof(symbol), job->job_id);
+		diagram_append(&diagram[core], &diagram_length[core], &diagram_size[core], "-", time - core_end[core]);
+		diagram_append(&diagram[core], &diagram_length[core], &diagram_size[core], symbol, job->run_time);
+	}
+
+	job->core_id = core;
+	core_job[core] = job->job_id;
+	core_end[core] = time + job->run_time;
+	priqueue_offer(running, &core_end[core]);
+}
+
+/**
+  Takes the first job waiting for a core in fast_forward().
+ */
+simulator_job_list_t *fast_forward_poll(priqueue_t *waiting, simulator_job_list_t *jobs)
+{
+	void *waiting_job = priqueue_poll(waiting);
+	simulator_job_list_t *job = &jobs[scheduler_waiting_job_number(waiting_job)];
+
+	free(waiting_job);
+	return job;
+}
+
+/**
+  Simulates fcfs, sjf or pri (see fast_forward_applies()) from one arrival
+  or completion to the next instead of one time unit at a time. A job
+  keeps its core from dispatch to completion, so its dispatch fixes its
+  completion and nothing happens in between.
+
+  The decisions are libscheduler's: a freed core takes the first waiting
+  job in queue order, and arrivals fill the idle cores lowest first.
+  Waiting jobs are ranked by the scheme's own queue comparator (see
+  scheduler_compare_waiting()), so the scheduler must have been started
+  up for scheme. Jobs finishing or arriving in the same time unit go in
+  job list order, as the simulation loop hands them over.
+
+  @param diagram each core's timing diagram, or NULL to leave them out
+  @param stats the stats page to keep up to date, or NULL for none; cores
+    are counted busy as their jobs finish
+  @return the time unit the simulation loop would stop in
+ */
+int fast_forward(simulator_job_list_t *jobs, int count, int cores, int scheme, job_order_t *order,
+		int *core_busy, int *core_work, char **diagram, scheduler_job_totals_t *totals, stats_writer_t *stats)
+{
+	long long *keys = malloc(count * sizeof(long long));
+	int *arrived = malloc(count * sizeof(int));
+	int *finished = malloc(cores * sizeof(int));
+	int *core_end = calloc(cores, sizeof(int));
+	int *core_job = malloc(cores * sizeof(int));
+	int *core_ids = malloc(cores * sizeof(int));
+	size_t *diagram_length = calloc(cores, sizeof(size_t));
+	size_t *diagram_size = calloc(cores, sizeof(size_t));
+	long long waiting_time = 0, turnaround_time = 0, response_time = 0;
+	priqueue_t waiting, running, idle;
+	int time = 0, next = 0, jobs_done = 0, i, k;
+
+	// Jobs by arrival time; ties go in job list order further down
+	for (i = 0; i < count; i++)
+		keys[i] = (long long)jobs[i].arrival_time << 32 | i;
+	qsort(keys, count, sizeof(long long), compare_key);
+
+	priqueue_init_heap(&waiting, scheduler_compare_waiting, PRIQUEUE_CACHE_ARITY);
+	priqueue_init_heap(&running, compare_int, PRIQUEUE_CACHE_ARITY);
+	priqueue_init_heap(&idle, compare_int, PRIQUEUE_CACHE_ARITY);
+	for (i = 0; i < cores; i++)
+	{
+		core_ids[i] = i;
+		priqueue_offer(&idle, &core_ids[i]);
+		if (diagram != NULL)
+			diagram[i][0] = '\0';
+	}
+
+	while (next < count || priqueue_size(&running) > 0)
+	{
+		time = next < count ? jobs[keys[next] & 0xffffffff].arrival_time : *(int *)priqueue_peek(&running);
+		if (priqueue_size(&running) > 0 && *(int *)priqueue_peek(&running) < time)
+			time = *(int *)priqueue_peek(&running);
+
+		// Completions, each freeing its core for the first waiting job
+		int done = 0;
+		while (priqueue_size(&running) > 0 && *(int *)priqueue_peek(&running) == time)
+		{
+			int core = (int *)priqueue_poll(&running) - core_end;
+			finished[done++] = core_job[core];
+		}
+		while (done > 0)
+		{
+			int first = 0;
+			for (k = 1; k < done; k++)
+				if (order->position[finished[k]] < order->position[finished[first]])
+					first = k;
+			simulator_job_list_t *job = &jobs[finished[first]];
+			finished[first] = finished[--done];
+
+			waiting_time += time - job->arrival_time - job->run_time;
+			turnaround_time += time - job->arrival_time;
+			jobs_done++;
+			if (stats != NULL)
+				stats_job_done(stats, time - job->arrival_time - job->run_time, time - job->arrival_time);
+			core_busy[job->core_id] += job->run_time;
+			core_work[job->core_id] += job->run_time;
+			job_order_remove(order, job->job_id);
+
+			if (priqueue_size(&waiting) > 0)
+			{
+				simulator_job_list_t *started = fast_forward_poll(&waiting, jobs);
+				response_time += time - started->arrival_time;
+				fast_forward_start(started, job->core_id, time, &running, core_end, core_job,
+						diagram, diagram_length, diagram_size);
+			}
+			else
+				priqueue_offer(&idle, &core_ids[job->core_id]);
+			job->core_id = -1;
+		}
+
+		// Arrivals, taking the idle cores
+		int count_arrived = 0;
+		for (; next < count && jobs[keys[next] & 0xffffffff].arrival_time == time; next++)
+			arrived[count_arrived++] = keys[next] & 0xffffffff;
+		if (count_arrived > 1)
+			sort_by_position(arrived, count_arrived, jobs, order);
+		for (k = 0; k < count_arrived; k++)
+		{
+			simulator_job_list_t *job = &jobs[arrived[k]];
+			priqueue_offer(&waiting, scheduler_waiting_job(job->job_id, job->arrival_time, job->run_time, job->priority));
+		}
+
+		while (priqueue_size(&waiting) > 0 && priqueue_size(&idle) > 0)
+		{
+			simulator_job_list_t *started = fast_forward_poll(&waiting, jobs);
+			response_time += time - started->arrival_time;
+			fast_forward_start(started, *(int *)priqueue_poll(&idle), time, &running, core_end, core_job,
+					diagram, diagram_length, diagram_size);
+		}
+
+		if (stats != NULL && stats_due(stats))
+			publish_stats(stats, time, next, jobs_done, 0, priqueue_size(&waiting), cores - priqueue_size(&idle), core_busy, 0);
+	}
+
+	// Idle to the end
+	for (i = 0; i < cores && diagram != NULL; i++)
+		diagram_append(&diagram[i], &diagram_length[i], &diagram_size[i], "-", time - core_end[i]);
+
+	totals->jobs = count;
+	totals->waiting_time = waiting_time;
+	totals->turnaround_time = turnaround_time;
+	totals->response_time = response_time;
+
+	priqueue_destroy(&waiting);
+	priqueue_destroy(&running);
+	priqueue_destroy(&idle);
+	free(keys);
+	free(arrived);
+	free(finished);
+	free(core_end);
+	free(core_job);
+	free(core_ids);
+	free(diagram_length);
+	free(diagram_size);
+	return time;
+}
+
+int compare_live_arrival(const void *a, const void *b)
+{
+	const simulator_job_list_t *x = *(simulator_job_list_t * const *)a, *y = *(simulator_job_list_t * const *)b;
+
+	if (x->arrival_time != y->arrival_time)
+		return x->arrival_time - y->arrival_time;
+	return x->job_id - y->job_id;
+}
+
+/**
+  Runs the jobs for real (-E) on one worker thread per core, each unit of
+  run time a spin loop calibrated to unit_us microseconds. Jobs arriving
+  together are submitted as one batch once their arrival time has come on
+  the wall clock, and the scheduler is handed wall-clock time units.
+
+  @return the time unit the last job finished in, or -1 if the scheduler
+    left every core idle with jobs waiting
+ */
+int run_live(simulator_job_list_t *jobs, int count, int cores, int scheme, int quantum, int unit_us)
+{
+	long long unit_ns = unit_us * 1000LL;
+	executor_job_t *live = calloc(count, sizeof(executor_job_t));
+	simulator_job_list_t **sorted = malloc(count * sizeof(simulator_job_list_t *));
+	int *batch = malloc(count * sizeof(int));
+	executor_t executor;
+	executor_stats_t stats;
+	int i, j;
+
+	for (i = 0; i < count; i++)
+	{
+		live[i].running_time = jobs[i].run_time;
+		live[i].priority = jobs[i].priority;
+		live[i].deadline = jobs[i].deadline;
+		sorted[i] = &jobs[i];
+	}
+	qsort(sorted, count, sizeof(simulator_job_list_t *), compare_live_arrival);
+
+	long long spin = executor_calibrate(unit_ns);
+	if (executor_init(&executor, EXECUTOR_LOCKED, cores, scheme, quantum, unit_ns, spin, live, count) != 0)
+	{
+		fprintf(stderr, "Unable to start %d worker threads.\n", cores);
+		exit(2);
+	}
+
+	for (i = 0; i < count; i = j)
+	{
+		long long wait = sorted[i]->arrival_time * unit_ns - executor_now(&executor);
+		if (wait > 0)
+		{
+			struct timespec ts = { wait / 1000000000LL, wait % 1000000000LL };
+			nanosleep(&ts, NULL);
+		}
+
+		for (j = i; j < count && sorted[j]->arrival_time == sorted[i]->arrival_time; j++)
+			batch[j - i] = sorted[j]->job_id;
+		executor_submit(&executor, batch, j - i);
+	}
+
+	int stalled = executor_wait(&executor) != 0;
+	executor_stats(&executor, &stats);
+
+	double seconds = stats.wall_ns / 1e9;
+	printf("LIVE EXECUTION (%d worker threads, %d pinned, %d us per time unit):\n", cores, stats.pinned, unit_us);
+	printf("  Wall time: %.3f s over %d time units\n", seconds, stats.time);
+	printf("  Throughput: %.1f jobs/s, %.1f units of work/s\n", seconds > 0 ? stats.finished / seconds : 0.0,
+			seconds > 0 ? stats.units / seconds : 0.0);
+	printf("  Dispatches: %lld, %lld of them preempting a running job\n", stats.dispatches, stats.preemptions);
+	printf("  Dispatch latency p50/p90/p99/max: %.1f/%.1f/%.1f/%.1f us\n", stats.dispatch_p50,
+			stats.dispatch_p90, stats.dispatch_p99, stats.dispatch_max);
+	printf("  Response latency p50/p90/p99/max: %.1f/%.1f/%.1f/%.1f us\n", stats.response_p50,
+			stats.response_p90, stats.response_p99, stats.response_max);
+	printf("  Scheduler calls: %lld, %.2f us each\n", stats.scheduler_calls, stats.scheduler_average);
+	for (i = 0; i < cores; i++)
+		printf("  Core %2d: %.1f%% busy\n", i, executor_core_busy(&executor, i));
+	printf("\n");
+
+	executor_destroy(&executor);
+	free(live);
+	free(sorted);
+	free(batch);
+
+	if (stalled)
+	{
+		printf("All cores are idle and at least one job remains unscheduled.\n");
+		return -1;
+	}
+	return stats.time;
 }
 
 int set_active_job(int job_id, int core_id, simulator_job_list_t *jobs, int active_jobs)
@@ -64,31 +1043,160 @@ void print_available_jobs(simulator_job_list_t *jobs, int active_jobs)
 		printf("\n");
 }
 
-void print_available_cores(int cores)
+void print_available_cores(int cores)
+{
+	printf("Active cores are: ");
+
+	int i;
+	for (i = 0; i < cores; i++)
+	{
+		if (i == cores - 1)
+			printf("%d\n", i);
+		else
+			printf("%d, ", i);
+	}
+}
+
+
+/**
+  Reads the input file into a new job list.
+
+  @return 0 on success, otherwise an error has been printed and the value
+    is the exit status
+ */
+int read_jobs(const char *file_name, int cores, simulator_job_list_t **jobs_out, int *count, int *has_deadlines)
+{
+	FILE *file = fopen(file_name, "r");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+		return 2;
+	}
+
+	int job_id = 0;
+	int jobs_ct = 10;
+	simulator_job_list_t* jobs = malloc(jobs_ct * sizeof(simulator_job_list_t));
+
+	char line[1024 + 1];
+	fgets(line, 1024, file);  // Ignore the first (header) line
+	while (fgets(line, 1024, file) != NULL)
+	{
+		// strsep keeps empty fields, so a row can skip the deadline but give cores
+		char *rest = line;
+		char *arrival_time = strsep(&rest, ",");
+		char *run_time = strsep(&rest, ",");
+		char *priority = strsep(&rest, ",");
+		char *deadline = strsep(&rest, ",");
+		char *width = strsep(&rest, ",");
+
+		if (arrival_time != NULL && run_time != NULL && priority != NULL)
+		{
+			if (job_id == jobs_ct)
+			{
+				jobs_ct *= 2;
+				jobs = realloc(jobs, jobs_ct * sizeof(simulator_job_list_t));
+
+				if (!jobs)
+				{
+					fprintf(stderr, "Out of memory.\n");
+					return 2;
+				}
+			}
+
+			jobs[job_id].job_id = job_id;
+			jobs[job_id].arrival_time = atoi(arrival_time);
+			jobs[job_id].run_time = atoi(run_time);
+			jobs[job_id].priority = atoi(priority);
+			jobs[job_id].deadline = -1;
+
+			// The deadline column is optional
+			if (deadline != NULL && strspn(deadline, " \t\r\n") != strlen(deadline))
+			{
+				jobs[job_id].deadline = atoi(deadline);
+				*has_deadlines = 1;
+			}
+
+			// So is the cores column
+			jobs[job_id].width = 1;
+			if (width != NULL && strspn(width, " \t\r\n") != strlen(width))
+			{
+				jobs[job_id].width = atoi(width);
+				if (jobs[job_id].width < 1 || jobs[job_id].width > cores)
+				{
+					fprintf(stderr, "Job %d needs %d cores; between 1 and %d are available.\n", job_id, jobs[job_id].width, cores);
+					return 2;
+				}
+			}
+			jobs[job_id].core_id = -1;
+			jobs[job_id].arrived = 0;
+			jobs[job_id].last_core = -1;
+			jobs[job_id].stall = 0;
+			jobs[job_id].last_time = -1;
+			jobs[job_id].progress = 0;
+
+			job_id++;
+		}
+		else
+		{
+			fprintf(stderr, "Illegal file format.\n");
+			return 2;
+		}
+	}
+
+	fclose(file);
+
+	*jobs_out = jobs;
+	*count = job_id;
+	return 0;
+}
+
+
+/**
+  Writes out the trace and decision log of a run stopping on an error, so
+  the events leading up to it are not lost. The trace ends with averages
+  of 0 and the log without any. A NULL name means that one is not open.
+ */
+void close_logs(trace_writer_t *trace, char *trace_file_name, replay_writer_t *decision_log, char *decision_log_name)
 {
-	printf("Active cores are: ");
-
-	int i;
-	for (i = 0; i < cores; i++)
-	{
-		if (i == cores - 1)
-			printf("%d\n", i);
-		else
-			printf("%d, ", i);
-	}
+	if (trace_file_name != NULL && trace_writer_close(trace, 0, 0, 0) != 0)
+		fprintf(stderr, "Failed to write trace file \"%s\".\n", trace_file_name);
+	if (decision_log_name != NULL && replay_writer_close(decision_log) != 0)
+		fprintf(stderr, "Failed to write decision log \"%s\".\n", decision_log_name);
 }
 
 
 int main(int argc, char **argv)
 {
 	int c;
-	int cores = 0, scheme = -1, quantum = 0;
-	char *file_name;
+	int cores = 0, scheme = -1, quantum = 0, show_metrics = 0, quiet = 0;
+	int mlfq_levels = 3, mlfq_quanta[MLFQ_MAX_LEVELS] = {2, 4, 8}, mlfq_boost = 100;
+	int placement = PLACE_ROUND_ROBIN, show_utilization = 0, show_fairness = 0;
+	int aging_interval = 0;
+	int switch_cost = 0, migration_cost = 0, show_overhead = 0;
+	int affinity_window = 0, workers = 1, show_diagram = 1;
+	char *topology_file_name = NULL;
+	int *topology_llc = NULL, *topology_node = NULL;
+	char *speed_list = NULL;
+	int *core_speed = NULL, custom_speeds = 0;
+	unsigned int seed = 1;
+	char *file_name, *trace_file_name = NULL, *decision_log_name = NULL;
+	char *checkpoint_out = NULL, *checkpoint_in = NULL;
+	int checkpoint_time = -1, checkpoint_fork = 0;
+	int live_unit = 0;
+	char *service_path = NULL;
+	char *stats_file_name = NULL;
+	stats_writer_t stats_page, *stats = NULL;
+	snapshot_t checkpoint;
+	int job_id = 0, has_deadlines = 0, min_priority = 0, max_priority = 0;
+	simulator_job_list_t *jobs = NULL;
+	trace_writer_t trace;
+	replay_writer_t decision_log;
+	unsigned long long sim_cycles = 0, sim_jobs_scanned = 0;
 
 	/*
 	 * Parse command line options.
 	 */
-	while ((c = getopt(argc, argv, "c:s:")) != -1)
+	while ((c = getopt(argc, argv, "c:s:mqt:r:V:l:b:p:uS:fa:w:x:A:T:K:j:DC:R:E:L:M:")) != -1)
 	{
 		switch (c)
 		{
@@ -109,6 +1217,22 @@ int main(int argc, char **argv)
 				else if (strcasecmp(optarg, "PSJF") == 0) { scheme = PSJF; }
 				else if (strcasecmp(optarg, "PRI") == 0) { scheme = PRI; }
 				else if (strcasecmp(optarg, "PPRI") == 0) { scheme = PPRI; }
+				else if (strcasecmp(optarg, "MLFQ") == 0) { scheme = MLFQ; }
+				else if (strcasecmp(optarg, "WS") == 0) { scheme = WS; }
+				else if (strcasecmp(optarg, "EDF") == 0) { scheme = EDF; }
+				else if (strcasecmp(optarg, "GANG") == 0) { scheme = GANG; }
+				else if (strncasecmp(optarg, "STRIDE", 6) == 0 || strncasecmp(optarg, "LOTTERY", 7) == 0)
+				{
+					scheme = (strncasecmp(optarg, "STRIDE", 6) == 0) ? STRIDE : LOTTERY;
+					quantum = atoi(optarg + (scheme == STRIDE ? 6 : 7));
+
+					if (quantum <= 0)
+					{
+						fprintf(stderr, "Option -s <scheme> requires a positive number for the quantum of STRIDE and LOTTERY. (Eg: -s stride2)\n");
+						print_usage(argv[0]);
+						return 1;
+					}
+				}
 				else if (strncasecmp(optarg, "RR", 2) == 0)
 				{
 					scheme = RR;
@@ -123,6 +1247,165 @@ int main(int argc, char **argv)
 				}
 				break;
 
+			case 'l':
+			{
+				char *quantum_str = strtok(optarg, ",");
+				for (mlfq_levels = 0; quantum_str != NULL; quantum_str = strtok(NULL, ","))
+				{
+					if (mlfq_levels == MLFQ_MAX_LEVELS || atoi(quantum_str) <= 0)
+					{
+						fprintf(stderr, "Option -l <quanta> requires 1 to %d positive numbers. (Eg: -l 2,4,8)\n", MLFQ_MAX_LEVELS);
+						print_usage(argv[0]);
+						return 1;
+					}
+					mlfq_quanta[mlfq_levels++] = atoi(quantum_str);
+				}
+				break;
+			}
+
+			case 'b':
+				mlfq_boost = atoi(optarg);
+				break;
+
+			case 'p':
+				if (strcasecmp(optarg, "rr") == 0) { placement = PLACE_ROUND_ROBIN; }
+				else if (strcasecmp(optarg, "least") == 0) { placement = PLACE_LEAST_LOADED; }
+				else if (strcasecmp(optarg, "p2c") == 0) { placement = PLACE_TWO_CHOICES; }
+				else
+				{
+					fprintf(stderr, "Option -p <placement> must be rr, least or p2c.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'u':
+				show_utilization = 1;
+				break;
+
+			case 'S':
+				seed = strtoul(optarg, NULL, 10);
+				break;
+
+			case 'f':
+				show_fairness = 1;
+				break;
+
+			case 'a':
+				aging_interval = atoi(optarg);
+
+				if (aging_interval <= 0)
+				{
+					fprintf(stderr, "Option -a <interval> requires a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'w':
+			case 'x':
+				if (atoi(optarg) < 0)
+				{
+					fprintf(stderr, "Option -%c <cost> requires a non-negative number.\n", c);
+					print_usage(argv[0]);
+					return 1;
+				}
+				if (c == 'w')
+					switch_cost = atoi(optarg);
+				else
+					migration_cost = atoi(optarg);
+				show_overhead = 1;
+				break;
+
+			case 'A':
+				affinity_window = atoi(optarg);
+
+				if (affinity_window < 0)
+				{
+					fprintf(stderr, "Option -A <window> requires a non-negative number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'T':
+				topology_file_name = optarg;
+				break;
+
+			case 'K':
+				speed_list = optarg;
+				break;
+
+			case 'j':
+				workers = atoi(optarg);
+
+				if (workers <= 0)
+				{
+					fprintf(stderr, "Option -j <workers> requires a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'm':
+				show_metrics = 1;
+				break;
+
+			case 'q':
+				quiet = 1;
+				break;
+
+			case 'D':
+				show_diagram = 0;
+				break;
+
+			case 'C':
+				checkpoint_time = atoi(optarg);
+				checkpoint_out = strchr(optarg, ',');
+
+				if (checkpoint_time < 0 || checkpoint_out == NULL || checkpoint_out[1] == '\0')
+				{
+					fprintf(stderr, "Option -C <time>,<checkpoint> requires a non-negative time and a file name. (Eg: -C 100,run.ckpt)\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				checkpoint_out++;
+				break;
+
+			case 'R':
+				checkpoint_in = optarg;
+				break;
+
+			case 'E':
+				live_unit = atoi(optarg);
+
+				if (live_unit <= 0)
+				{
+					fprintf(stderr, "Option -E <microseconds> requires a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'L':
+				service_path = optarg;
+				break;
+
+			case 'M':
+				stats_file_name = optarg;
+				break;
+
+			case 't':
+				trace_file_name = optarg;
+				break;
+
+			case 'r':
+				decision_log_name = optarg;
+				break;
+
+			case 'V':
+				return verify_decision_log(optarg);
+
 			case '?':
 				print_usage(argv[0]);
 				return 1;
@@ -133,6 +1416,79 @@ int main(int argc, char **argv)
 		}
 	}
 
+	// A resumed run takes its jobs, cores and costs from the checkpoint, and
+	// its scheme too unless -s forks it
+	if (checkpoint_in != NULL)
+	{
+		int saved_scheme, saved_quantum, saved_levels, saved_quanta[MLFQ_MAX_LEVELS], saved_boost, saved_placement;
+		unsigned int saved_seed;
+		int has_topology;
+
+		if (cores != 0 || optind != argc || workers > 1 || trace_file_name != NULL || decision_log_name != NULL
+				|| aging_interval > 0 || show_overhead || affinity_window > 0 || topology_file_name != NULL || speed_list != NULL)
+		{
+			fprintf(stderr, "Option -R <checkpoint> takes the jobs, cores and costs from the checkpoint and cannot be given an input file, -c, -j, -t, -r, -a, -w, -x, -A, -T or -K.\n");
+			print_usage(argv[0]);
+			return 1;
+		}
+
+		if (snapshot_read(&checkpoint, checkpoint_in) != 0)
+		{
+			fprintf(stderr, "Unable to read checkpoint \"%s\".\n", checkpoint_in);
+			return 2;
+		}
+
+		SNAPSHOT_GET(&checkpoint, cores);
+		SNAPSHOT_GET(&checkpoint, saved_scheme);
+		SNAPSHOT_GET(&checkpoint, saved_quantum);
+		SNAPSHOT_GET(&checkpoint, saved_levels);
+		SNAPSHOT_GET(&checkpoint, saved_quanta);
+		SNAPSHOT_GET(&checkpoint, saved_boost);
+		SNAPSHOT_GET(&checkpoint, saved_placement);
+		SNAPSHOT_GET(&checkpoint, saved_seed);
+		SNAPSHOT_GET(&checkpoint, aging_interval);
+		SNAPSHOT_GET(&checkpoint, switch_cost);
+		SNAPSHOT_GET(&checkpoint, migration_cost);
+		SNAPSHOT_GET(&checkpoint, show_overhead);
+		SNAPSHOT_GET(&checkpoint, affinity_window);
+		SNAPSHOT_GET(&checkpoint, has_topology);
+		SNAPSHOT_GET(&checkpoint, custom_speeds);
+		SNAPSHOT_GET(&checkpoint, job_id);
+		SNAPSHOT_GET(&checkpoint, has_deadlines);
+		SNAPSHOT_GET(&checkpoint, min_priority);
+		SNAPSHOT_GET(&checkpoint, max_priority);
+
+		if (checkpoint.failed || cores <= 0 || job_id < 0 || saved_levels < 1 || saved_levels > MLFQ_MAX_LEVELS
+				|| min_priority > max_priority)
+		{
+			fprintf(stderr, "Checkpoint \"%s\" is damaged.\n", checkpoint_in);
+			return 2;
+		}
+
+		checkpoint_fork = (scheme != -1);
+		if (!checkpoint_fork)
+		{
+			scheme = saved_scheme;
+			quantum = saved_quantum;
+			mlfq_levels = saved_levels;
+			memcpy(mlfq_quanta, saved_quanta, sizeof(mlfq_quanta));
+			mlfq_boost = saved_boost;
+			placement = saved_placement;
+			seed = saved_seed;
+		}
+
+		core_speed = malloc(cores * sizeof(int));
+		snapshot_get(&checkpoint, core_speed, cores * sizeof(int));
+		if (has_topology)
+		{
+			topology_llc = malloc(cores * sizeof(int));
+			topology_node = malloc(cores * sizeof(int));
+			snapshot_get(&checkpoint, topology_llc, cores * sizeof(int));
+			snapshot_get(&checkpoint, topology_node, cores * sizeof(int));
+		}
+		jobs = malloc((job_id + 1) * sizeof(simulator_job_list_t));
+	}
+
 	if (cores == 0)
 	{
 		fprintf(stderr, "Required option -c <cores> is not present.\n");
@@ -147,9 +1503,56 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	if (topology_file_name != NULL)
+	{
+		topology_llc = malloc(cores * sizeof(int));
+		topology_node = malloc(cores * sizeof(int));
+
+		if (load_topology(topology_file_name, cores, topology_llc, topology_node) != 0)
+			return 2;
+	}
+
+	// Core speeds need the core count, so they are parsed after the options
+	if (core_speed == NULL)
+	{
+		core_speed = malloc(cores * sizeof(int));
+		for (int core = 0; core < cores; core++)
+			core_speed[core] = CORE_SPEED_ONE;
+	}
+
+	if (speed_list != NULL)
+	{
+		int core = 0;
+		char *speed_str = strtok(speed_list, ",");
+		for (; speed_str != NULL && core < cores; speed_str = strtok(NULL, ","), core++)
+		{
+			if (strtod(speed_str, NULL) * CORE_SPEED_ONE < 1)
+				break;
+			core_speed[core] = (int)(strtod(speed_str, NULL) * CORE_SPEED_ONE + 0.5);
+		}
+
+		if (core != cores || speed_str != NULL)
+		{
+			fprintf(stderr, "Option -K <speeds> requires one positive speed per core. (Eg: -K 2,2,1,1)\n");
+			print_usage(argv[0]);
+			return 1;
+		}
+		custom_speeds = 1;
+	}
+
+	if (service_path != NULL && (optind != argc || cores > SERVICE_MAX_RECORDS || workers > 1
+			|| trace_file_name != NULL || decision_log_name != NULL || show_utilization || show_fairness
+			|| show_overhead || checkpoint_out != NULL || checkpoint_in != NULL || live_unit > 0))
+	{
+		fprintf(stderr, "Option -L <socket> takes its jobs from clients and cannot be given an input file, more than %d cores, -j, -t, -r, -u, -f, -w, -x, -C, -R or -E.\n",
+				SERVICE_MAX_RECORDS);
+		print_usage(argv[0]);
+		return 1;
+	}
+
 	if (optind == argc - 1)
 		file_name = argv[optind];
-	else
+	else if (checkpoint_in == NULL && service_path == NULL)
 	{
 		fprintf(stderr, "A single input file is required.\n");
 		print_usage(argv[0]);
@@ -160,173 +1563,638 @@ int main(int argc, char **argv)
 	/*
 	 * Open the file, read the file, and populate the jobs data structure.
 	 */
-	FILE *file = fopen(file_name, "r");
-	if (file == NULL)
+	if (checkpoint_in == NULL && service_path == NULL)
 	{
-		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+		int status = read_jobs(file_name, cores, &jobs, &job_id, &has_deadlines);
+		if (status != 0)
+			return status;
+	}
+
+	if (workers > 1 && (!quiet || !busy_periods_independent(scheme) || has_deadlines || trace_file_name != NULL
+			|| decision_log_name != NULL || show_metrics || show_fairness || show_overhead
+			|| aging_interval > 0 || speed_list != NULL || checkpoint_out != NULL || checkpoint_in != NULL))
+	{
+		fprintf(stderr, "Option -j <workers> requires -q and fcfs, sjf, psjf, pri, ppri, edf or gang, without deadlines, -t, -r, -m, -f, -a, -w, -x, -K, -C or -R.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (live_unit > 0 && (scheme == GANG || workers > 1 || trace_file_name != NULL || decision_log_name != NULL
+			|| show_utilization || show_fairness || show_overhead || speed_list != NULL
+			|| checkpoint_out != NULL || checkpoint_in != NULL))
+	{
+		fprintf(stderr, "Option -E <microseconds> runs the jobs on worker threads and cannot be combined with gang, -j, -t, -r, -u, -f, -w, -x, -K, -C or -R.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+	if (live_unit > 0)
+		show_diagram = 0;
+
+	// Waiting times need each job's whole run time, which a checkpoint no longer has
+	if (stats_file_name != NULL && (workers > 1 || live_unit > 0 || service_path != NULL || checkpoint_in != NULL))
+	{
+		fprintf(stderr, "Option -M <stats file> cannot be combined with -j, -E, -L or -R.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	// Unless the run is wanted one time unit at a time, non-preemptive
+	// schemes can jump from one dispatch or completion to the next
+	int fast = quiet && fast_forward_applies(scheme, jobs, job_id) && !has_deadlines && trace_file_name == NULL
+		&& decision_log_name == NULL && !show_metrics && !show_fairness && !show_overhead
+		&& aging_interval == 0 && speed_list == NULL && affinity_window == 0 && checkpoint_out == NULL && checkpoint_in == NULL && live_unit == 0;
+	if (fast)
+		workers = 1;
+
+
+	/*
+	 * Run the simulation.
+	 */
+
+	if (service_path != NULL)
+		printf("Serving %d core(s) using ", cores);
+	else
+		printf("Loaded %d core(s) and %d job(s) using ", cores, job_id);
+	if (scheme == FCFS) { printf("First Come First Served (FCFS)"); }
+	else if (scheme == SJF) { printf("Non-preemptive Shortest Job First (SJF)"); }
+	else if (scheme == PSJF) { printf("Preemptive Shortest Job First (PSJF)"); }
+	else if (scheme == PRI) { printf("Non-preemptive Priority (PRI)"); }
+	else if (scheme == PPRI) { printf("Preemptive Priority (PPRI)"); }
+	else if (scheme == RR) { printf("Round Robin (RR) with a quantum of %d", quantum); }
+	else if (scheme == MLFQ) { printf("Multi-level Feedback Queue (MLFQ) with %d levels", mlfq_levels); }
+	else if (scheme == WS) { printf("Per-core Work Stealing (WS) with %s placement", placement_name(placement)); }
+	else if (scheme == EDF) { printf("Preemptive Earliest Deadline First (EDF)"); }
+	else if (scheme == STRIDE) { printf("Stride Scheduling (STRIDE) with a quantum of %d", quantum); }
+	else if (scheme == LOTTERY) { printf("Lottery Scheduling (LOTTERY) with a quantum of %d", quantum); }
+	else if (scheme == GANG) { printf("Gang Scheduling (GANG) with EASY backfilling"); }
+	printf(" scheduling...\n\n");
+
+	// With -j, worker processes each simulate a run of busy periods with a
+	// scheduler of their own, and this process puts their results together
+	// in time order. A worker keeps only its own jobs.
+	job_order_t order;
+	busy_period_t *periods = NULL, *period = NULL;
+	int period_runs = 0, i, j, k;
+
+	job_order_init(&order, job_id);
+	if (workers > 1)
+	{
+		int *cut = malloc(workers * PERIOD_RUNS_PER_WORKER * sizeof(int));
+		int runs = busy_period_cuts(jobs, job_id, workers * PERIOD_RUNS_PER_WORKER, cut);
+
+		if (runs > 1)
+		{
+			periods = calloc(runs, sizeof(busy_period_t));
+			for (k = 0; k < runs; k++)
+			{
+				periods[k].start = cut[k];
+				periods[k].end = k + 1 < runs ? cut[k + 1] : 0;
+			}
+			for (i = 0; i < job_id; i++)
+			{
+				for (k = runs - 1; periods[k].start > jobs[i].arrival_time; k--)
+					periods[k].jobs_before++;
+				periods[k].jobs++;
+			}
+
+			int worker = -1;
+			int status = run_busy_periods(periods, runs, workers, jobs, job_id, &order, cores, &worker);
+
+			if (status > 0)
+				return status;
+			if (status < 0)
+				period = &periods[worker];
+			else
+				period_runs = runs;
+		}
+		free(cut);
+	}
+
+	if (scheme == MLFQ)
+	{
+		// Levels stand in for the quantum in traces
+		quantum = mlfq_levels;
+		scheduler_configure_mlfq(mlfq_levels, mlfq_quanta, mlfq_boost);
+	}
+
+	if (scheme == WS)
+	{
+		// Placement stands in for the quantum in traces
+		quantum = placement;
+		scheduler_configure_ws(placement, seed);
+	}
+
+	if (scheme == STRIDE || scheme == LOTTERY)
+		scheduler_configure_share(quantum, seed);
+
+	if (aging_interval > 0)
+		scheduler_configure_aging(aging_interval);
+
+	if (affinity_window > 0)
+		scheduler_configure_affinity(affinity_window);
+
+	if (topology_llc != NULL)
+		scheduler_configure_topology(cores, topology_llc, topology_node);
+
+	if (custom_speeds)
+		scheduler_configure_speeds(cores, core_speed);
+
+	// A resumed run starts the scheduler up from the checkpoint instead
+	if (checkpoint_in == NULL)
+		scheduler_start_up(cores, scheme);
+
+	if (service_path != NULL)
+		return server_run(service_path, cores, scheme, quantum);
+
+	if (decision_log_name != NULL)
+	{
+		if (replay_writer_init(&decision_log, decision_log_name) != 0)
+		{
+			fprintf(stderr, "Unable to create decision log \"%s\".\n", decision_log_name);
+			return 2;
+		}
+		if (scheme == MLFQ)
+			for (int level = 0; level < mlfq_levels; level++)
+				replay_record(&decision_log, REPLAY_CONFIGURE_MLFQ, level, mlfq_quanta[level], mlfq_levels, mlfq_boost, 0, 0);
+		if (scheme == WS)
+			replay_record(&decision_log, REPLAY_CONFIGURE_WS, placement, seed, 0, 0, 0, 0);
+		if (scheme == STRIDE || scheme == LOTTERY)
+			replay_record(&decision_log, REPLAY_CONFIGURE_SHARE, quantum, seed, 0, 0, 0, 0);
+		if (aging_interval > 0)
+			replay_record(&decision_log, REPLAY_CONFIGURE_AGING, aging_interval, 0, 0, 0, 0, 0);
+		if (affinity_window > 0)
+			replay_record(&decision_log, REPLAY_CONFIGURE_AFFINITY, affinity_window, 0, 0, 0, 0, 0);
+		if (topology_llc != NULL)
+			for (int core = 0; core < cores; core++)
+				replay_record(&decision_log, REPLAY_CONFIGURE_TOPOLOGY, core, topology_llc[core], topology_node[core], cores, 0, 0);
+		if (custom_speeds)
+			for (int core = 0; core < cores; core++)
+				replay_record(&decision_log, REPLAY_CONFIGURE_SPEEDS, core, core_speed[core], cores, 0, 0, 0);
+		replay_record(&decision_log, REPLAY_START_UP, cores, scheme, 0, 0, 0, 0);
+	}
+
+	if (trace_file_name != NULL && trace_writer_init(&trace, trace_file_name, job_id, cores, scheme, quantum) != 0)
+	{
+		fprintf(stderr, "Unable to create trace file \"%s\".\n", trace_file_name);
+		close_logs(&trace, NULL, &decision_log, decision_log_name);
 		return 2;
 	}
 
+	// Run time of each job, before the simulation counts it down, for the stats page's waiting times
+	int *stats_run_time = NULL;
+	if (stats_file_name != NULL)
+	{
+		if (stats_writer_init(&stats_page, stats_file_name, cores, STATS_INTERVAL_NS) != 0)
+		{
+			fprintf(stderr, "Unable to create stats file \"%s\".\n", stats_file_name);
+			close_logs(&trace, trace_file_name, &decision_log, decision_log_name);
+			return 2;
+		}
+		stats = &stats_page;
+
+		stats_run_time = malloc(job_id * sizeof(int));
+		for (i = 0; i < job_id; i++)
+			stats_run_time[jobs[i].job_id] = jobs[i].run_time;
+	}
+	long long quantum_expiries = 0;
+
 
-	int job_id = 0;
-	int jobs_ct = 10;
-	simulator_job_list_t* jobs = malloc(jobs_ct * sizeof(simulator_job_list_t));
+	int time = 0, active_jobs = job_id, jobs_alive = 0;
+	int *period_finished = NULL, period_finished_count = 0;
+	scheduler_job_totals_t period_totals = { 0, 0, 0, 0 };
 
-	char line[1024 + 1];
-	fgets(line, 1024, file);  // Ignore the first (header) line
-	while (fgets(line, 1024, file) != NULL)
+	// Keep only the jobs arriving in this worker's busy periods, the parent
+	// keeps none, nor does a fast forward; a resumed run reads its own from
+	// the checkpoint further down; a live run hands them to its workers
+	if (period_runs > 0 || fast || checkpoint_in != NULL || live_unit > 0)
+		active_jobs = 0;
+	else if (period != NULL)
+	{
+		time = period->start;
+		order.length = job_id - period->jobs_before;
+		period_finished = malloc(period->jobs * sizeof(int));
+
+		active_jobs = 0;
+		for (i = 0; i < job_id; i++)
+			if (jobs[i].arrival_time >= period->start && (period->end == 0 || jobs[i].arrival_time < period->end))
+				jobs[active_jobs++] = jobs[i];
+	}
+
+	// Completions and quantum expiries are timers that fire in the time unit
+	// they are due in, so steps 1 and 2 only visit the jobs and cores they
+	// concern. A core's fresh quantum waits in quantum_length until the core
+	// runs and the timer can account for switch overhead.
+	timer_wheel_t finish_wheel, quantum_wheel;
+	wheel_timer_t *finish_timer = malloc(job_id * sizeof(wheel_timer_t));
+	wheel_timer_t *quantum_timer = malloc(cores * sizeof(wheel_timer_t));
+	int *quantum_length = malloc(cores * sizeof(int));
+	int *quantum_job = malloc(cores * sizeof(int));
+	int *job_index = malloc(job_id * sizeof(int));	// Position of each job in jobs
+	int *finished_jobs = malloc(job_id * sizeof(int));
+	int *expired_cores = malloc(cores * sizeof(int));
+	int *core_busy = calloc(cores, sizeof(int));
+	int *core_work = calloc(cores, sizeof(int));
+
+	// Job on each core as last reported by the scheduler, for gang jobs on several cores
+	int *gang_core_job = malloc(cores * sizeof(int));
+	int core_changes = 0;
+
+	// Switch and migration costs, for -w and -x
+	int *core_last_job = malloc(cores * sizeof(int));
+	int switches = 0, switch_overhead = 0, migration_overhead = 0;
+	int resumes = 0, cross_llc = 0, cross_node = 0;
+
+	// CPU time received and entitled to per priority, for -f
+	for (i = 0; i < job_id && checkpoint_in == NULL; i++)
+	{
+		if (i == 0 || jobs[i].priority < min_priority)
+			min_priority = jobs[i].priority;
+		if (i == 0 || jobs[i].priority > max_priority)
+			max_priority = jobs[i].priority;
+	}
+	int priorities = max_priority - min_priority + 1;
+	long *share_weight_alive = calloc(priorities, sizeof(long));
+	long *share_received = calloc(priorities, sizeof(long));
+	double *share_entitled = calloc(priorities, sizeof(double));
+	long total_weight_alive = 0;
+	scheduler_new_job_t *arrivals = malloc(job_id * sizeof(scheduler_new_job_t));
+	int *arrival_index = malloc(job_id * sizeof(int));
+	char **core_timing_diagram = malloc(cores * sizeof(char *));
+	int core_timing_diagram_size = 1024;
+
+	wheel_init(&finish_wheel, time);
+	wheel_init(&quantum_wheel, time);
+	for (i = 0; i < job_id; i++)
+		wheel_timer_init(&finish_timer[i], i);
+	for (i = 0; i < active_jobs; i++)
+		job_index[jobs[i].job_id] = i;
+
+	for (i = 0; i < cores; i++)
+	{
+		wheel_timer_init(&quantum_timer[i], i);
+		quantum_length[i] = -1;
+		quantum_job[i] = -1;
+		core_last_job[i] = -1;
+		gang_core_job[i] = -1;
+		core_timing_diagram[i] = malloc(core_timing_diagram_size + 1);
+		core_timing_diagram[i][0] = '\0';
+	}
+
+	// Pick up where the checkpoint left off
+	if (checkpoint_in != NULL)
 	{
-		char *arrival_time = strtok(line, ",");
-		char *run_time = strtok(NULL, ",");
-		char *priority = strtok(NULL, ",");
+		int *expires = malloc((job_id + cores + 1) * sizeof(int));
+		int valid = 1;
+
+		SNAPSHOT_GET(&checkpoint, time);
+		SNAPSHOT_GET(&checkpoint, active_jobs);
+		SNAPSHOT_GET(&checkpoint, jobs_alive);
+		if (active_jobs < 0 || active_jobs > job_id)
+			active_jobs = 0, valid = 0;
+		snapshot_get(&checkpoint, jobs, active_jobs * sizeof(simulator_job_list_t));
+		snapshot_get(&checkpoint, expires, active_jobs * sizeof(int));
+
+		wheel_init(&finish_wheel, time);
+		wheel_init(&quantum_wheel, time);
+		for (i = 0; i < active_jobs && valid; i++)
+		{
+			if (jobs[i].job_id < 0 || jobs[i].job_id >= job_id || jobs[i].core_id >= cores)
+			{
+				valid = 0;
+				break;
+			}
+			job_index[jobs[i].job_id] = i;
+			if (expires[i] >= 0)
+				wheel_add(&finish_wheel, &finish_timer[jobs[i].job_id], expires[i]);
+		}
 
-		if (arrival_time != NULL && run_time != NULL && priority != NULL)
+		SNAPSHOT_GET(&checkpoint, order.length);
+		snapshot_get(&checkpoint, order.job, job_id * sizeof(int));
+		snapshot_get(&checkpoint, order.position, job_id * sizeof(int));
+
+		snapshot_get(&checkpoint, expires, cores * sizeof(int));
+		for (i = 0; i < cores; i++)
+			if (expires[i] >= 0)
+				wheel_add(&quantum_wheel, &quantum_timer[i], expires[i]);
+		free(expires);
+
+		snapshot_get(&checkpoint, quantum_length, cores * sizeof(int));
+		snapshot_get(&checkpoint, quantum_job, cores * sizeof(int));
+		snapshot_get(&checkpoint, core_busy, cores * sizeof(int));
+		snapshot_get(&checkpoint, core_work, cores * sizeof(int));
+		snapshot_get(&checkpoint, gang_core_job, cores * sizeof(int));
+		snapshot_get(&checkpoint, core_last_job, cores * sizeof(int));
+		SNAPSHOT_GET(&checkpoint, core_changes);
+		SNAPSHOT_GET(&checkpoint, switches);
+		SNAPSHOT_GET(&checkpoint, switch_overhead);
+		SNAPSHOT_GET(&checkpoint, migration_overhead);
+		SNAPSHOT_GET(&checkpoint, resumes);
+		SNAPSHOT_GET(&checkpoint, cross_llc);
+		SNAPSHOT_GET(&checkpoint, cross_node);
+		SNAPSHOT_GET(&checkpoint, total_weight_alive);
+		snapshot_get(&checkpoint, share_weight_alive, priorities * sizeof(long));
+		snapshot_get(&checkpoint, share_received, priorities * sizeof(long));
+		snapshot_get(&checkpoint, share_entitled, priorities * sizeof(double));
+
+		for (i = 0; i < cores && valid; i++)
 		{
-			if (job_id == jobs_ct)
+			int length;
+			SNAPSHOT_GET(&checkpoint, length);
+			if (checkpoint.failed || length < 0 || (size_t)length > checkpoint.size - checkpoint.offset)
 			{
-				jobs_ct *= 2;
-				jobs = realloc(jobs, jobs_ct * sizeof(simulator_job_list_t));
-
-				if (!jobs)
-				{
-					fprintf(stderr, "Out of memory.\n");
-					return 2;
-				}
+				valid = 0;
+				break;
 			}
 
-			jobs[job_id].job_id = job_id;
-			jobs[job_id].arrival_time = atoi(arrival_time);
-			jobs[job_id].run_time = atoi(run_time);
-			jobs[job_id].priority = atoi(priority);
-			jobs[job_id].core_id = -1;
-			jobs[job_id].arrived = 0;
+			while (length >= core_timing_diagram_size)
+			{
+				core_timing_diagram_size *= 2;
+				for (j = 0; j < cores; j++)
+					core_timing_diagram[j] = realloc(core_timing_diagram[j], core_timing_diagram_size + 1);
+			}
+			snapshot_get(&checkpoint, core_timing_diagram[i], length);
+			core_timing_diagram[i][length] = '\0';
+		}
 
-			job_id++;
+		if (valid && !checkpoint.failed)
+		{
+			if (checkpoint_fork)
+				valid = scheduler_snapshot_fork(&checkpoint, scheme, time) == 0;
+			else
+				valid = scheduler_snapshot_load(&checkpoint) == 0;
 		}
-		else
+
+		if (!valid || checkpoint.failed)
 		{
-			fprintf(stderr, "Illegal file format.\n");
+			fprintf(stderr, "Checkpoint \"%s\" is damaged.\n", checkpoint_in);
+			close_logs(&trace, trace_file_name, &decision_log, decision_log_name);
 			return 2;
 		}
+		snapshot_destroy(&checkpoint);
+
+		if (checkpoint_fork)
+			fork_sync(scheme, quantum, cores, jobs, active_jobs, job_index, gang_core_job,
+					&finish_wheel, finish_timer, &quantum_wheel, quantum_timer, quantum_length);
+
+		printf("Resuming at time %d from checkpoint \"%s\"%s.\n\n", time, checkpoint_in,
+				checkpoint_fork ? " with its remaining jobs scheduled again" : "");
 	}
 
-	fclose(file);
+#ifdef SCHEDULER_METRICS
+	unsigned long long sim_start = scheduler_metrics_cycles();
+#endif
 
+	if (fast)
+		time = fast_forward(jobs, job_id, cores, scheme, &order, core_busy, core_work,
+				show_diagram ? core_timing_diagram : NULL, &period_totals, stats);
 
-	/*
-	 * Run the simulation.
-	 */
+	if (live_unit > 0)
+	{
+		time = run_live(jobs, job_id, cores, scheme, quantum, live_unit);
+		if (time < 0)
+			return 3;
+	}
 
-	printf("Loaded %d core(s) and %d job(s) using ", cores, job_id);
-	if (scheme == FCFS) { printf("First Come First Served (FCFS)"); }
-	else if (scheme == SJF) { printf("Non-preemptive Shortest Job First (SJF)"); }
-	else if (scheme == PSJF) { printf("Preemptive Shortest Job First (PSJF)"); }
-	else if (scheme == PRI) { printf("Non-preemptive Priority (PRI)"); }
-	else if (scheme == PPRI) { printf("Preemptive Priority (PPRI)"); }
-	else if (scheme == RR) { printf("Round Robin (RR) with a quantum of %d", quantum); }
-	printf(" scheduling...\n\n");
+	// A worker runs on through the idle time up to the next run of periods
+	while (active_jobs > 0 || (period != NULL && time < period->end))
+	{
+		// Save everything needed to carry on from here, for -R
+		if (checkpoint_out != NULL && time == checkpoint_time)
+		{
+			snapshot_t snapshot;
+			int has_topology = (topology_llc != NULL);
+
+			snapshot_init(&snapshot);
+			SNAPSHOT_PUT(&snapshot, cores);
+			SNAPSHOT_PUT(&snapshot, scheme);
+			SNAPSHOT_PUT(&snapshot, quantum);
+			SNAPSHOT_PUT(&snapshot, mlfq_levels);
+			SNAPSHOT_PUT(&snapshot, mlfq_quanta);
+			SNAPSHOT_PUT(&snapshot, mlfq_boost);
+			SNAPSHOT_PUT(&snapshot, placement);
+			SNAPSHOT_PUT(&snapshot, seed);
+			SNAPSHOT_PUT(&snapshot, aging_interval);
+			SNAPSHOT_PUT(&snapshot, switch_cost);
+			SNAPSHOT_PUT(&snapshot, migration_cost);
+			SNAPSHOT_PUT(&snapshot, show_overhead);
+			SNAPSHOT_PUT(&snapshot, affinity_window);
+			SNAPSHOT_PUT(&snapshot, has_topology);
+			SNAPSHOT_PUT(&snapshot, custom_speeds);
+			SNAPSHOT_PUT(&snapshot, job_id);
+			SNAPSHOT_PUT(&snapshot, has_deadlines);
+			SNAPSHOT_PUT(&snapshot, min_priority);
+			SNAPSHOT_PUT(&snapshot, max_priority);
+			snapshot_put(&snapshot, core_speed, cores * sizeof(int));
+			if (has_topology)
+			{
+				snapshot_put(&snapshot, topology_llc, cores * sizeof(int));
+				snapshot_put(&snapshot, topology_node, cores * sizeof(int));
+			}
 
-	scheduler_start_up(cores, scheme);
+			SNAPSHOT_PUT(&snapshot, time);
+			SNAPSHOT_PUT(&snapshot, active_jobs);
+			SNAPSHOT_PUT(&snapshot, jobs_alive);
+			snapshot_put(&snapshot, jobs, active_jobs * sizeof(simulator_job_list_t));
+			for (i = 0; i < active_jobs; i++)
+			{
+				wheel_timer_t *timer = &finish_timer[jobs[i].job_id];
+				int expires = wheel_timer_pending(timer) ? timer->expires : -1;
+				SNAPSHOT_PUT(&snapshot, expires);
+			}
+			SNAPSHOT_PUT(&snapshot, order.length);
+			snapshot_put(&snapshot, order.job, job_id * sizeof(int));
+			snapshot_put(&snapshot, order.position, job_id * sizeof(int));
+			for (i = 0; i < cores; i++)
+			{
+				int expires = wheel_timer_pending(&quantum_timer[i]) ? quantum_timer[i].expires : -1;
+				SNAPSHOT_PUT(&snapshot, expires);
+			}
 
+			snapshot_put(&snapshot, quantum_length, cores * sizeof(int));
+			snapshot_put(&snapshot, quantum_job, cores * sizeof(int));
+			snapshot_put(&snapshot, core_busy, cores * sizeof(int));
+			snapshot_put(&snapshot, core_work, cores * sizeof(int));
+			snapshot_put(&snapshot, gang_core_job, cores * sizeof(int));
+			snapshot_put(&snapshot, core_last_job, cores * sizeof(int));
+			SNAPSHOT_PUT(&snapshot, core_changes);
+			SNAPSHOT_PUT(&snapshot, switches);
+			SNAPSHOT_PUT(&snapshot, switch_overhead);
+			SNAPSHOT_PUT(&snapshot, migration_overhead);
+			SNAPSHOT_PUT(&snapshot, resumes);
+			SNAPSHOT_PUT(&snapshot, cross_llc);
+			SNAPSHOT_PUT(&snapshot, cross_node);
+			SNAPSHOT_PUT(&snapshot, total_weight_alive);
+			snapshot_put(&snapshot, share_weight_alive, priorities * sizeof(long));
+			snapshot_put(&snapshot, share_received, priorities * sizeof(long));
+			snapshot_put(&snapshot, share_entitled, priorities * sizeof(double));
 
-	int time = 0, i, j;
-	int active_jobs = job_id, jobs_alive = 0;
+			for (i = 0; i < cores; i++)
+			{
+				int length = strlen(core_timing_diagram[i]);
+				SNAPSHOT_PUT(&snapshot, length);
+				snapshot_put(&snapshot, core_timing_diagram[i], length);
+			}
 
-	int *quantum_clock = malloc(cores * sizeof(int));
-	char **core_timing_diagram = malloc(cores * sizeof(char *));
-	int core_timing_diagram_size = 1024;
+			scheduler_snapshot_save(&snapshot);
 
-	for (i = 0; i < cores; i++)
-	{
-		quantum_clock[i] = -1;
-		core_timing_diagram[i] = malloc(core_timing_diagram_size + 1);
-		core_timing_diagram[i][0] = '\0';
-	}
+			if (snapshot_write(&snapshot, checkpoint_out) != 0)
+			{
+				fprintf(stderr, "Unable to write checkpoint \"%s\".\n", checkpoint_out);
+				close_logs(&trace, trace_file_name, &decision_log, decision_log_name);
+				return 2;
+			}
+			snapshot_destroy(&snapshot);
+			checkpoint_out = NULL;
+		}
 
-	while (active_jobs > 0)
-	{
-		printf("=== [TIME %d] ===\n", time);
+		if (!quiet)
+			printf("=== [TIME %d] ===\n", time);
+#ifdef SCHEDULER_METRICS
+		// Steps 3 and 4 each sweep the job list once
+		sim_jobs_scanned += 2 * active_jobs;
+#endif
 
 		/*
 		 * 1. Check if any jobs finished in the last time unit.
 		 */
-		for (i = 0; i < active_jobs; i++)
+		int finished = 0;
+		for (wheel_timer_t *timer = wheel_expire(&finish_wheel, time); timer != NULL; timer = timer->next)
+			finished_jobs[finished++] = timer->id;
+
+		while (finished > 0)
 		{
-			if (jobs[i].run_time == 0)
+			// Lowest position in the job list first, the order a sweep of the
+			// list finds them in as finished jobs are swapped out
+			int first = 0;
+			for (k = 1; k < finished; k++)
+				if (order.position[finished_jobs[k]] < order.position[finished_jobs[first]])
+					first = k;
+			i = job_index[finished_jobs[first]];
+			finished_jobs[first] = finished_jobs[--finished];
+			assert(jobs[i].run_time == 0);
+
+			// Notify the scheduler has finished
+			int job_id = jobs[i].job_id;
+			int core_id = jobs[i].core_id;
+			int new_job_id = scheduler_job_finished(jobs[i].core_id, jobs[i].job_id, time);
+
+			if (stats != NULL)
+				stats_job_done(stats, time - jobs[i].arrival_time - stats_run_time[job_id], time - jobs[i].arrival_time);
+
+			if (decision_log_name != NULL)
+				replay_record(&decision_log, REPLAY_JOB_FINISHED, core_id, job_id, time, 0, 0, new_job_id);
+
+			if (uses_quantum(scheme))
 			{
-				// Notify the scheduler has finished
-				int job_id = jobs[i].job_id;
-				int core_id = jobs[i].core_id;
-				int new_job_id = scheduler_job_finished(jobs[i].core_id, jobs[i].job_id, time);
+				quantum_length[jobs[i].core_id] = core_quantum(scheme, quantum, jobs[i].core_id);
+				wheel_cancel(&quantum_wheel, &quantum_timer[jobs[i].core_id]);
+			}
 
-				if (scheme == RR)
-					quantum_clock[jobs[i].core_id] = quantum;
+			share_weight_alive[jobs[i].priority - min_priority] -= scheduler_share_weight(jobs[i].priority);
+			total_weight_alive -= scheduler_share_weight(jobs[i].priority);
 
-				// Delete the finished jobs, decrease the number of active jobs
-				if (i != active_jobs - 1)
-					memcpy(&jobs[i], &jobs[active_jobs - 1], sizeof(simulator_job_list_t));
-				active_jobs--;
-				jobs_alive--;
-				i--;
+			// Delete the finished jobs, decrease the number of active jobs
+			job_order_remove(&order, jobs[i].job_id);
+			if (period != NULL)
+				period_finished[period_finished_count++] = jobs[i].job_id;
+			if (i != active_jobs - 1)
+			{
+				memcpy(&jobs[i], &jobs[active_jobs - 1], sizeof(simulator_job_list_t));
+				job_index[jobs[i].job_id] = i;
+			}
+			active_jobs--;
+			jobs_alive--;
 
-				// Set the new job
-				if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
+			// Set the new job
+			if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
+			{
+				printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
+				print_available_jobs(jobs, active_jobs);
+				close_logs(&trace, trace_file_name, &decision_log, decision_log_name);
+				return 3;
+			}
+			else
+			{
+				if (trace_file_name != NULL)
 				{
-					printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
-					print_available_jobs(jobs, active_jobs);
-					return 3;
+					trace_record(&trace, TRACE_FINISH, time, job_id, core_id, new_job_id, 0, 0);
+					if (new_job_id != -1)
+						trace_record(&trace, TRACE_DISPATCH, time, new_job_id, core_id, 0, 0, 0);
 				}
-				else
+
+				if (!quiet)
 				{
 					printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n", job_id, core_id, core_id, new_job_id);
 					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
 				}
 			}
+
+			if (scheme == GANG)
+				gang_sync(gang_core_job, cores, jobs, active_jobs, trace_file_name ? &trace : NULL, quiet, time);
 		}
 
 		/*
 		 * Check to see if we finished our last job.  (If we don't check here, we would run an extra time unit that will be totally idle.)
 		 */
-		if (active_jobs == 0)
+		if (active_jobs == 0 && (period == NULL || time >= period->end))
 			break;
 
 		/*
 		 * 2. Check of any quantums expired in the last time unit.
 		 */
-		if (scheme == RR)
+		if (uses_quantum(scheme))
 		{
-			for (i = 0; i < cores; i++)
+			int expired = 0;
+			for (wheel_timer_t *timer = wheel_expire(&quantum_wheel, time); timer != NULL; timer = timer->next)
+			{
+				// Lowest core first, the order a sweep of the cores finds them in
+				for (k = expired; k > 0 && expired_cores[k - 1] > timer->id; k--)
+					expired_cores[k] = expired_cores[k - 1];
+				expired_cores[k] = timer->id;
+				expired++;
+			}
+			quantum_expiries += expired;
+
+			for (k = 0; k < expired; k++)
 			{
-				if (quantum_clock[i] == 0)
+				i = expired_cores[k];
+				j = job_index[quantum_job[i]];
+				assert(jobs[j].core_id == i);
+
+				// Notify the scheduler the quantum has expired
+				int core_id = jobs[j].core_id;
+				int old_job_id = jobs[j].job_id;
+				int new_job_id = scheduler_quantum_expired(jobs[j].core_id, time);
+
+				if (decision_log_name != NULL)
+					replay_record(&decision_log, REPLAY_QUANTUM_EXPIRED, core_id, time, 0, 0, 0, new_job_id);
+
+				jobs[j].core_id = -1;
+				wheel_cancel(&finish_wheel, &finish_timer[jobs[j].job_id]);
+
+				quantum_length[core_id] = core_quantum(scheme, quantum, core_id);
+
+				// Set the new job
+				if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
+				{
+					printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
+					print_available_jobs(jobs, active_jobs);
+					close_logs(&trace, trace_file_name, &decision_log, decision_log_name);
+					return 3;
+				}
+				else
 				{
-					for (j = 0; j < active_jobs; j++)
+					if (trace_file_name != NULL)
+					{
+						trace_record(&trace, TRACE_QUANTUM_EXPIRE, time, old_job_id, core_id, new_job_id, 0, 0);
+						if (new_job_id != -1)
+							trace_record(&trace, TRACE_DISPATCH, time, new_job_id, core_id, 0, 0, 0);
+					}
+
+					if (!quiet)
 					{
-						if (jobs[j].core_id == i)
-						{
-							// Notify the scheduler the quantum has expired
-							int core_id = jobs[j].core_id;
-							int old_job_id = jobs[j].job_id;
-							int new_job_id = scheduler_quantum_expired(jobs[j].core_id, time);
-
-							jobs[j].core_id = -1;
-
-							quantum_clock[core_id] = quantum;
-
-							// Set the new job
-							if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
-							{
-								printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
-								print_available_jobs(jobs, active_jobs);
-								return 3;
-							}
-							else
-							{
-								printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", old_job_id, core_id, core_id, new_job_id);
-								printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-							}
-
-							break;
-						}
+						printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", old_job_id, core_id, core_id, new_job_id);
+						printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
 					}
 				}
 			}
@@ -336,46 +2204,106 @@ int main(int argc, char **argv)
 		/*
 		 * 3. Check for any new jobs that arrive in this time unit
 		 */
+		int arrived = 0;
+
 		for (i = 0; i < active_jobs; i++)
-		{
 			if (jobs[i].arrival_time == time)
+				arrival_index[arrived++] = i;
+
+		// A worker's job list keeps only its own jobs, so its order is not
+		// the serial one
+		if (period != NULL && arrived > 1)
+			sort_by_position(arrival_index, arrived, jobs, &order);
+
+		for (k = 0; k < arrived; k++)
+		{
+			i = arrival_index[k];
+			arrivals[k].job_number = jobs[i].job_id;
+			arrivals[k].running_time = jobs[i].run_time;
+			arrivals[k].priority = jobs[i].priority;
+			arrivals[k].deadline = jobs[i].deadline;
+			arrivals[k].cores = jobs[i].width;
+		}
+
+		if (arrived > 0)
+		{
+			int scheduled = scheduler_new_jobs(arrivals, arrived, time);
+
+			if (decision_log_name != NULL)
 			{
-				int new_job_core_id = scheduler_new_job(jobs[i].job_id, time, jobs[i].run_time, jobs[i].priority);
-				jobs[i].arrived = 1;
-				jobs_alive++;
+				replay_record(&decision_log, REPLAY_NEW_JOBS, arrived, time, 0, 0, 0, scheduled);
+				for (k = 0; k < arrived; k++)
+					replay_record(&decision_log, REPLAY_NEW_JOB, arrivals[k].job_number, arrivals[k].cores,
+							arrivals[k].running_time, arrivals[k].priority, arrivals[k].deadline, arrivals[k].core_id);
+			}
+		}
+
+		for (k = 0; k < arrived; k++)
+		{
+			i = arrival_index[k];
+			int new_job_core_id = arrivals[k].core_id;
+
+			jobs[i].arrived = 1;
+			jobs_alive++;
+
+			share_weight_alive[jobs[i].priority - min_priority] += scheduler_share_weight(jobs[i].priority);
+			total_weight_alive += scheduler_share_weight(jobs[i].priority);
 
-				if (new_job_core_id >= 0 && new_job_core_id < cores)
+			if (trace_file_name != NULL && new_job_core_id >= -1 && new_job_core_id < cores)
+				trace_record(&trace, TRACE_ARRIVAL, time, jobs[i].job_id, new_job_core_id, jobs[i].run_time, jobs[i].priority, jobs[i].deadline);
+
+			if (new_job_core_id >= 0 && new_job_core_id < cores)
+			{
+				if (!quiet)
 				{
 					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
 							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id, new_job_core_id);
 					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
+				}
+
+				// Find if anyone is currently using the core.
+				for (j = 0; j < active_jobs; j++)
+					if (jobs[j].core_id == new_job_core_id)
+					{
+						if (trace_file_name != NULL)
+							trace_record(&trace, TRACE_PREEMPT, time, jobs[j].job_id, new_job_core_id, 0, 0, 0);
+						jobs[j].core_id = -1;
+						wheel_cancel(&finish_wheel, &finish_timer[jobs[j].job_id]);
+					}
 
-					// Find if anyone is currently using the core.
-					for (j = 0; j < active_jobs; j++)
-						if (jobs[j].core_id == new_job_core_id)
-							jobs[j].core_id = -1;
+				if (trace_file_name != NULL)
+					trace_record(&trace, TRACE_DISPATCH, time, jobs[i].job_id, new_job_core_id, 0, 0, 0);
 
-					// Assign the core to the new job
-					jobs[i].core_id = new_job_core_id;
+				// Assign the core to the new job
+				jobs[i].core_id = new_job_core_id;
 
-					if (scheme == RR)
-						quantum_clock[new_job_core_id] = quantum;
+				if (uses_quantum(scheme))
+				{
+					quantum_length[new_job_core_id] = core_quantum(scheme, quantum, new_job_core_id);
+					wheel_cancel(&quantum_wheel, &quantum_timer[new_job_core_id]);
 				}
-				else if (new_job_core_id == -1)
+			}
+			else if (new_job_core_id == -1)
+			{
+				if (!quiet)
 				{
 					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
 							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id);
 					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
 				}
-				else
-				{
-					printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
-					print_available_cores(cores);
-					return 3;
-				}
+			}
+			else
+			{
+				printf("The scheduler_new_jobs() selected an invalid core (core_id == %d).\n", new_job_core_id);
+				print_available_cores(cores);
+				close_logs(&trace, trace_file_name, &decision_log, decision_log_name);
+				return 3;
 			}
 		}
 
+		if (scheme == GANG && arrived > 0)
+			gang_sync(gang_core_job, cores, jobs, active_jobs, trace_file_name ? &trace : NULL, quiet, time);
+
 
 		/*
 		 * 4. Run the time unit.
@@ -391,19 +2319,84 @@ int main(int argc, char **argv)
 			if (jobs[i].core_id != -1)
 			{
 				cores_working++;
-				jobs[i].run_time--;
-				quantum_clock[jobs[i].core_id]--;
+				core_busy[jobs[i].core_id]++;
+				share_received[jobs[i].priority - min_priority]++;
 
-				assert(time_string[jobs[i].core_id][0] == '\0');
+				// A core taking up a job other than the one it last ran pays for
+				// the switch, and again if the job last ran on another core
+				if (core_last_job[jobs[i].core_id] != jobs[i].job_id)
+				{
+					jobs[i].stall = 0;
+					if (core_last_job[jobs[i].core_id] != -1)
+					{
+						switches++;
+						jobs[i].stall += switch_cost;
+					}
+					if (jobs[i].last_core != -1 && jobs[i].last_core != jobs[i].core_id)
+					{
+						core_changes++;
+						if (topology_llc != NULL && topology_llc[jobs[i].last_core] != topology_llc[jobs[i].core_id])
+							cross_llc++;
+						if (topology_llc != NULL && topology_node[jobs[i].last_core] != topology_node[jobs[i].core_id])
+							cross_node++;
+						jobs[i].stall += migration_cost;
+						migration_overhead += migration_cost;
+					}
+					switch_overhead += jobs[i].stall;
+					core_last_job[jobs[i].core_id] = jobs[i].job_id;
+				}
+				// A job that sat out or moved since it last ran was resumed
+				if (jobs[i].last_core != -1 && (jobs[i].last_time != time - 1 || jobs[i].last_core != jobs[i].core_id))
+					resumes++;
+				jobs[i].last_core = jobs[i].core_id;
+				jobs[i].last_time = time;
+
+				// A job that just started running is due to finish once its
+				// overhead is paid and its run time done at this core's speed; a
+				// fresh quantum likewise starts counting after the overhead
+				int speed = core_speed[jobs[i].core_id];
+				if (!wheel_timer_pending(&finish_timer[jobs[i].job_id]))
+					wheel_add(&finish_wheel, &finish_timer[jobs[i].job_id], time + jobs[i].stall
+							+ (jobs[i].run_time * CORE_SPEED_ONE - jobs[i].progress + speed - 1) / speed);
+				if (quantum_length[jobs[i].core_id] >= 0)
+				{
+					wheel_add(&quantum_wheel, &quantum_timer[jobs[i].core_id], time + jobs[i].stall + quantum_length[jobs[i].core_id]);
+					quantum_job[jobs[i].core_id] = jobs[i].job_id;
+					quantum_length[jobs[i].core_id] = -1;
+				}
 
-				if (jobs[i].job_id < 10)
-					sprintf(time_string[jobs[i].core_id], "%d", jobs[i].job_id);
-				else if (jobs[i].job_id < 10 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 + 'a');
-				else if (jobs[i].job_id < 10 + 26 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 - 26 + 'A');
+				// Overhead holds the core without using up the job or its quantum
+				if (jobs[i].stall > 0)
+					jobs[i].stall--;
 				else
-					snprintf(time_string[jobs[i].core_id], 10, "(%d)", jobs[i].job_id);
+				{
+					// Faster and slower cores do more or less than one unit of
+					// run time per time unit; the remainder carries over
+					jobs[i].progress += speed;
+					while (jobs[i].progress >= CORE_SPEED_ONE && jobs[i].run_time > 0)
+					{
+						jobs[i].progress -= CORE_SPEED_ONE;
+						jobs[i].run_time--;
+						core_work[jobs[i].core_id]++;
+					}
+				}
+
+				assert(time_string[jobs[i].core_id][0] == '\0');
+
+				job_symbol(time_string[jobs[i].core_id], 10, jobs[i].job_id);
+			}
+		}
+
+		// The other cores of gang jobs; their lead core did the work above
+		if (scheme == GANG)
+		{
+			for (i = 0; i < cores; i++)
+			{
+				if (gang_core_job[i] != -1 && time_string[i][0] == '\0')
+				{
+					core_busy[i]++;
+					job_symbol(time_string[i], 10, gang_core_job[i]);
+				}
 			}
 		}
 
@@ -413,6 +2406,9 @@ int main(int argc, char **argv)
 			if (time_string[i][0] == '\0')
 				strcpy(time_string[i], "-");
 
+			if (!show_diagram && quiet)
+				continue;
+
 			// Ensure we have enough memory
 			while (strlen(core_timing_diagram[i]) + strlen(time_string[i]) >= (unsigned int)core_timing_diagram_size)
 			{
@@ -425,6 +2421,7 @@ int main(int argc, char **argv)
 					if (core_timing_diagram[j] == NULL)
 					{
 						fprintf(stderr, "Out of memory.\n");
+						close_logs(&trace, trace_file_name, &decision_log, decision_log_name);
 						return 3;
 					}
 				}
@@ -433,21 +2430,29 @@ int main(int argc, char **argv)
 			strcat( core_timing_diagram[i], time_string[i] );
 		}
 
+		// Split the busy cores by weight between the priorities with work
+		if (total_weight_alive > 0)
+			for (i = 0; i < priorities; i++)
+				share_entitled[i] += (double)cores_working * share_weight_alive[i] / total_weight_alive;
+
 
 		/*
 		 * 5. Print data!
 		 */
-		printf("At the end of time unit %d...\n", time);
+		if (!quiet)
+		{
+			printf("At the end of time unit %d...\n", time);
 
-		for (i = 0; i < cores; i++)
-			printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
+			for (i = 0; i < cores; i++)
+				printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
 
-		printf("\n");
+			printf("\n");
 
-		printf("  Queue: ");
-		scheduler_show_queue();
-		printf("\n");
-		printf("\n");
+			printf("  Queue: ");
+			scheduler_show_queue();
+			printf("\n");
+			printf("\n");
+		}
 
 
 		/*
@@ -459,9 +2464,14 @@ int main(int argc, char **argv)
 		{
 			printf("All cores are idle and at least one job remains unscheduled.\n");
 			print_available_jobs(jobs, active_jobs);
+			close_logs(&trace, trace_file_name, &decision_log, decision_log_name);
 			return 3;
 		}
 
+		if (stats != NULL && stats_due(stats))
+			publish_stats(stats, time + 1, job_id - active_jobs + jobs_alive, job_id - active_jobs, quantum_expiries,
+					jobs_alive - cores_working, cores_working, core_busy, 0);
+
 
 		/*
 		 * 7. Increase time
@@ -470,19 +2480,253 @@ int main(int argc, char **argv)
 	}
 
 
-	printf("FINAL TIMING DIAGRAM:\n");
-	for (i = 0; i < cores; i++)
-		printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
+#ifdef SCHEDULER_METRICS
+	sim_cycles = scheduler_metrics_cycles() - sim_start;
+#endif
 
-	printf("\n");
-	printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
-	printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
-	printf("Average Response Time: %.2f\n", scheduler_average_response_time());
+	if (stats != NULL)
+	{
+		publish_stats(stats, time, job_id, job_id, quantum_expiries, 0, 0, core_busy, 1);
+		stats_writer_close(stats);
+		free(stats_run_time);
+	}
+
+	if (checkpoint_out != NULL)
+		fprintf(stderr, "The run ended at time %d, before checkpoint time %d; no checkpoint was saved.\n", time, checkpoint_time);
+
+	if (period != NULL)
+	{
+		period_result_t result;
+
+		if (period->end != 0 && time > period->end)
+		{
+			printf("Busy periods up to time %d ran on until time %d.\n", period->end, time);
+			return 3;
+		}
+
+		scheduler_job_totals(&result.totals);
+		result.core_changes = core_changes;
+		result.resumes = resumes;
+		result.cross_llc = cross_llc;
+		result.cross_node = cross_node;
+		result.time = time;
+		if (send_period_result(period->fd, &result, cores, core_busy, core_work, core_timing_diagram, period_finished) != 0)
+			return 2;
+		close(period->fd);
+		return 0;
+	}
+
+	// Put the workers' results together
+	for (k = 0; k < period_runs; k++)
+	{
+		period_result_t *result = &periods[k].result;
+
+		period_totals.jobs += result->totals.jobs;
+		period_totals.waiting_time += result->totals.waiting_time;
+		period_totals.turnaround_time += result->totals.turnaround_time;
+		period_totals.response_time += result->totals.response_time;
+		core_changes += result->core_changes;
+		resumes += result->resumes;
+		cross_llc += result->cross_llc;
+		cross_node += result->cross_node;
+		time = result->time;
+
+		for (i = 0; i < cores; i++)
+		{
+			core_busy[i] += periods[k].counts[i];
+			core_work[i] += periods[k].counts[cores + i];
+		}
+	}
+	for (i = 0; i < cores && period_runs > 0; i++)
+	{
+		size_t length = 0;
+		for (k = 0; k < period_runs; k++)
+			length += strlen(periods[k].diagram[i]);
+
+		core_timing_diagram[i] = realloc(core_timing_diagram[i], length + 1);
+		core_timing_diagram[i][0] = '\0';
+		for (k = 0; k < period_runs; k++)
+			strcat(core_timing_diagram[i], periods[k].diagram[i]);
+	}
+
+	if (show_fairness)
+	{
+		long received_total = 0;
+		double entitled_total = 0;
+
+		for (i = 0; i < priorities; i++)
+		{
+			received_total += share_received[i];
+			entitled_total += share_entitled[i];
+		}
+
+		printf("SHARE FAIRNESS (CPU received vs. weighted share of busy cores):\n");
+		for (i = 0; i < priorities; i++)
+		{
+			if (share_received[i] == 0 && share_entitled[i] == 0)
+				continue;
+			printf("  Priority %d (weight %d): %.1f%% received, %.1f%% entitled, ratio %.2f\n",
+					i + min_priority, scheduler_share_weight(i + min_priority),
+					received_total ? 100.0 * share_received[i] / received_total : 0.0,
+					entitled_total ? 100.0 * share_entitled[i] / entitled_total : 0.0,
+					share_entitled[i] ? share_received[i] / share_entitled[i] : 0.0);
+		}
+		printf("\n");
+	}
+
+	if (show_overhead)
+	{
+		int busy_total = 0;
+		for (i = 0; i < cores; i++)
+			busy_total += core_busy[i];
+
+		printf("SWITCH OVERHEAD:\n");
+		printf("  Context switches: %d (%d time units)\n", switches, switches * switch_cost);
+		printf("  Migrations: %d (%d time units)\n", core_changes, migration_overhead);
+		printf("  Total overhead: %d time units, %.1f%% of busy time\n", switch_overhead,
+				busy_total ? 100.0 * switch_overhead / busy_total : 0.0);
+		printf("\n");
+	}
+
+	if (show_utilization)
+	{
+		printf("CORE STATISTICS:\n");
+		for (i = 0; i < cores; i++)
+			printf("  Core %2d: %.1f%% busy\n", i, time ? 100.0 * core_busy[i] / time : 0.0);
+		printf("  Jobs resumed on a different core: %d\n", core_changes);
+		printf("  Affinity hits: %d of %d resumes (%.1f%%)\n", resumes - core_changes, resumes,
+				resumes ? 100.0 * (resumes - core_changes) / resumes : 0.0);
+		if (topology_llc != NULL)
+		{
+			printf("  Cross-LLC migrations: %d\n", cross_llc);
+			printf("  Cross-node migrations: %d\n", cross_node);
+		}
+		printf("  Run queue migrations: %d\n", scheduler_migrations());
+
+		// One line per distinct speed, fastest first
+		if (custom_speeds)
+		{
+			int speed = -1;
+			for (;;)
+			{
+				int next = -1, class_cores = 0, class_busy = 0, class_work = 0;
+				for (i = 0; i < cores; i++)
+					if ((speed == -1 || core_speed[i] < speed) && core_speed[i] > next)
+						next = core_speed[i];
+				if (next == -1)
+					break;
+				speed = next;
+
+				for (i = 0; i < cores; i++)
+				{
+					if (core_speed[i] != speed)
+						continue;
+					class_cores++;
+					class_busy += core_busy[i];
+					class_work += core_work[i];
+				}
+				printf("  Speed %.2fx (%d cores): %.1f%% busy, %d units of work\n", (double)speed / CORE_SPEED_ONE,
+						class_cores, time ? 100.0 * class_busy / ((double)time * class_cores) : 0.0, class_work);
+			}
+		}
+		printf("\n");
+	}
+
+	if (show_diagram)
+	{
+		printf("FINAL TIMING DIAGRAM:\n");
+		for (i = 0; i < cores; i++)
+			printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
+
+		printf("\n");
+	}
+	float waiting_time = scheduler_average_waiting_time();
+	float turnaround_time = scheduler_average_turnaround_time();
+	float response_time = scheduler_average_response_time();
+
+	if (period_runs > 0 || fast)
+	{
+		waiting_time = (1.0 * period_totals.waiting_time) / period_totals.jobs;
+		turnaround_time = (1.0 * period_totals.turnaround_time) / period_totals.jobs;
+		response_time = (1.0 * period_totals.response_time) / period_totals.jobs;
+	}
+
+	printf("Average Waiting Time: %.2f\n", waiting_time);
+	printf("Average Turnaround Time: %.2f\n", turnaround_time);
+	printf("Average Response Time: %.2f\n", response_time);
+
+	if (has_deadlines)
+	{
+		scheduler_deadline_stats_t deadline_stats;
+		scheduler_deadline_stats(&deadline_stats);
+
+		printf("Deadline Miss Rate: %.2f%% (%d of %d)\n", 100.0 * deadline_stats.miss_rate, deadline_stats.missed, deadline_stats.jobs);
+		printf("Lateness p50/p90/p99/max: %.0f/%.0f/%.0f/%d\n", deadline_stats.lateness_p50,
+				deadline_stats.lateness_p90, deadline_stats.lateness_p99, deadline_stats.max_lateness);
+	}
+
+	if (aging_interval > 0)
+	{
+		scheduler_waiting_stats_t waiting_stats;
+		scheduler_waiting_stats(&waiting_stats);
+
+		printf("Waiting Time p50/p90/p99/max: %.0f/%.0f/%.0f/%d\n", waiting_stats.waiting_p50,
+				waiting_stats.waiting_p90, waiting_stats.waiting_p99, waiting_stats.max_waiting);
+		if (waiting_stats.overtake_window < 0)
+			printf("Starvation Bound: none (aging does not apply to this scheme)\n");
+		else
+			printf("Starvation Bound: jobs arriving %d or more time units later never run first\n", waiting_stats.overtake_window);
+	}
+
+	if (show_metrics)
+		print_metrics(sim_cycles, sim_jobs_scanned);
+
+	if (trace_file_name != NULL && trace_writer_close(&trace, waiting_time, turnaround_time, response_time) != 0)
+		fprintf(stderr, "Failed to write trace file \"%s\".\n", trace_file_name);
+
+	if (decision_log_name != NULL)
+	{
+		replay_record_float(&decision_log, REPLAY_AVERAGE_WAITING, waiting_time);
+		replay_record_float(&decision_log, REPLAY_AVERAGE_TURNAROUND, turnaround_time);
+		replay_record_float(&decision_log, REPLAY_AVERAGE_RESPONSE, response_time);
+
+		if (replay_writer_close(&decision_log) != 0)
+			fprintf(stderr, "Failed to write decision log \"%s\".\n", decision_log_name);
+	}
 
 	scheduler_clean_up();
 
 
-	free(quantum_clock);
+	free(finish_timer);
+	free(quantum_timer);
+	free(quantum_length);
+	free(quantum_job);
+	free(job_index);
+	free(finished_jobs);
+	free(expired_cores);
+	free(period_finished);
+	job_order_destroy(&order);
+	for (k = 0; k < period_runs; k++)
+	{
+		for (i = 0; i < cores; i++)
+			free(periods[k].diagram[i]);
+		free(periods[k].diagram);
+		free(periods[k].counts);
+		free(periods[k].finished);
+	}
+	free(periods);
+	free(core_busy);
+	free(core_last_job);
+	free(core_work);
+	free(gang_core_job);
+	free(core_speed);
+	free(topology_llc);
+	free(topology_node);
+	free(share_weight_alive);
+	free(share_received);
+	free(share_entitled);
+	free(arrivals);
+	free(arrival_index);
 	for (i=0; i < cores; i++)
 		free(core_timing_diagram[i]);
 	free(core_timing_diagram);
@@ -0,0 +1,129 @@
+/** @file statwatch.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+
+#include "libstats/libstats.h"
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-i <milliseconds>] [-u] [-1] <stats file>\n", program_name);
+	fprintf(stderr, "Polls the stats page of a simulator run with -M <stats file> and prints a line per poll until\n");
+	fprintf(stderr, "the run ends. Rates and utilization are over the time since the poll before.\n");
+	fprintf(stderr, "  -i  time between polls (default 1000)\n");
+	fprintf(stderr, "  -u  also print each core's utilization\n");
+	fprintf(stderr, "  -1  print the latest snapshot once and exit\n");
+}
+
+/**
+  Prints one snapshot, with rates and utilization since last, or since the
+  start of the run if last is NULL.
+ */
+void print_snapshot(stats_page_t *page, stats_page_t *last, int show_cores)
+{
+	int64_t time = page->sample.time - (last ? last->sample.time : 0);
+	int64_t busy = 0;
+	double seconds = (page->wall_ns - (last ? last->wall_ns : 0)) / 1e9;
+	int i;
+
+	for (i = 0; i < page->cores; i++)
+		busy += page->core_busy[i] - (last ? last->core_busy[i] : 0);
+
+	printf("[%8.1f s] time %lld, %.0f events/s, %lld finished, %lld alive (%lld queued, %lld running), %.1f%% busy\n",
+			page->wall_ns / 1e9, (long long)page->sample.time,
+			seconds > 0 ? (page->sample.events - (last ? last->sample.events : 0)) / seconds : page->events_per_second,
+			(long long)page->sample.finished, (long long)page->sample.alive, (long long)page->sample.queued,
+			(long long)page->sample.running, time > 0 ? 100.0 * busy / ((double)time * page->cores) : 0.0);
+	printf("             waiting p50/p90/p99/max %.0f/%.0f/%.0f/%lld, turnaround p50/p90/p99/max %.0f/%.0f/%.0f/%lld\n",
+			page->waiting_p50, page->waiting_p90, page->waiting_p99, (long long)page->waiting_max,
+			page->turnaround_p50, page->turnaround_p90, page->turnaround_p99, (long long)page->turnaround_max);
+
+	for (i = 0; i < page->cores && show_cores; i++)
+	{
+		int64_t core_busy = page->core_busy[i] - (last ? last->core_busy[i] : 0);
+		printf("             Core %2d: %.1f%% busy\n", i, time > 0 ? 100.0 * core_busy / time : 0.0);
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	int c, interval_ms = 1000, show_cores = 0, once = 0;
+
+	while ((c = getopt(argc, argv, "i:u1")) != -1)
+	{
+		switch (c)
+		{
+			case 'i':
+				interval_ms = atoi(optarg);
+				if (interval_ms <= 0)
+				{
+					fprintf(stderr, "Option -i <milliseconds> requires a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'u': show_cores = 1; break;
+			case '1': once = 1; break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	stats_reader_t reader;
+	if (stats_reader_open(&reader, argv[optind]) != 0)
+	{
+		fprintf(stderr, "\"%s\" is not a stats page.\n", argv[optind]);
+		return 2;
+	}
+
+	size_t size = stats_page_size(reader.page->cores);
+	stats_page_t *page = malloc(size), *last = malloc(size);
+	int have_last = 0, status = 0;
+
+	for (;;)
+	{
+		stats_read(&reader, page);
+
+		// Skip polls that found nothing new, and any before the first snapshot
+		if ((page->snapshots > 0 && (!have_last || page->snapshots != last->snapshots)) || once)
+		{
+			print_snapshot(page, have_last ? last : NULL, show_cores);
+			memcpy(last, page, size);
+			have_last = 1;
+		}
+
+		if (page->state == STATS_DONE || once)
+			break;
+		if (kill(page->pid, 0) != 0 && errno == ESRCH)
+		{
+			stats_read(&reader, page);
+			if (page->state == STATS_DONE)
+				continue;
+			printf("The simulator (pid %d) exited before finishing its run.\n", page->pid);
+			status = 3;
+			break;
+		}
+		usleep(interval_ms * 1000);
+	}
+
+	free(page);
+	free(last);
+	stats_reader_close(&reader);
+	return status;
+}
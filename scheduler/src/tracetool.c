@@ -0,0 +1,312 @@
+/** @file tracetool.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libscheduler/libscheduler.h"
+#include "libtrace/libtrace.h"
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s <text|chrome> <trace file>\n", program_name);
+	fprintf(stderr, "  text    print the trace in the simulator's text format\n");
+	fprintf(stderr, "  chrome  print the trace as Chrome trace event JSON (chrome://tracing)\n");
+}
+
+/**
+  Writes the timing diagram symbol the simulator uses for job_id.
+ */
+void job_symbol(char *buf, size_t size, int job_id)
+{
+	if (job_id < 10)
+		snprintf(buf, size, "%d", job_id);
+	else if (job_id < 10 + 26)
+		snprintf(buf, size, "%c", job_id - 10 + 'a');
+	else if (job_id < 10 + 26 + 26)
+		snprintf(buf, size, "%c", job_id - 10 - 26 + 'A');
+	else
+		snprintf(buf, size, "(%d)", job_id);
+}
+
+/**
+  Whether ev names a core the trace has. Only an arrival may name none (-1).
+ */
+int valid_core(trace_header_t *h, trace_event_t *ev)
+{
+	if ((ev->core_id >= 0 && ev->core_id < h->cores) || (ev->type == TRACE_ARRIVAL && ev->core_id == -1))
+		return 1;
+	fprintf(stderr, "Event at time %d names core %d, but the trace has %d core(s).\n", ev->time, ev->core_id, h->cores);
+	return 0;
+}
+
+int lateness_comparator(const void *a, const void *b)
+{
+	return *(int *)a - *(int *)b;
+}
+
+/**
+  Replays the events in the same order the simulator printed them,
+  rebuilding the timing diagram from the dispatch and release events.
+  Stops early if the trace runs out of events with no job on a core.
+  Jobs that arrived with a deadline get the simulator's deadline lines,
+  from their arrival and finish times.
+ */
+int print_text(trace_reader_t *r)
+{
+	trace_header_t *h = &r->header;
+	int cores = h->cores;
+	int i, time, finished = 0, have_event, busy = 0, status = 0;
+	int late_count = 0, missed = 0, has_deadlines = 0;
+	trace_event_t ev;
+
+	printf("Loaded %d core(s) and %d job(s) using ", cores, h->jobs);
+	if (h->scheme == FCFS) { printf("First Come First Served (FCFS)"); }
+	else if (h->scheme == SJF) { printf("Non-preemptive Shortest Job First (SJF)"); }
+	else if (h->scheme == PSJF) { printf("Preemptive Shortest Job First (PSJF)"); }
+	else if (h->scheme == PRI) { printf("Non-preemptive Priority (PRI)"); }
+	else if (h->scheme == PPRI) { printf("Preemptive Priority (PPRI)"); }
+	else if (h->scheme == RR) { printf("Round Robin (RR) with a quantum of %d", h->quantum); }
+	else if (h->scheme == MLFQ) { printf("Multi-level Feedback Queue (MLFQ) with %d levels", h->quantum); }
+	else if (h->scheme == EDF) { printf("Preemptive Earliest Deadline First (EDF)"); }
+	else if (h->scheme == STRIDE) { printf("Stride Scheduling (STRIDE) with a quantum of %d", h->quantum); }
+	else if (h->scheme == LOTTERY) { printf("Lottery Scheduling (LOTTERY) with a quantum of %d", h->quantum); }
+	else if (h->scheme == GANG) { printf("Gang Scheduling (GANG) with EASY backfilling"); }
+	else if (h->scheme == WS)
+	{
+		const char *placements[] = {"round-robin", "least-loaded", "power-of-two-choices"};
+		printf("Per-core Work Stealing (WS) with %s placement", (h->quantum >= 0 && h->quantum < 3) ? placements[h->quantum] : "unknown");
+	}
+	printf(" scheduling...\n\n");
+
+	int *running = malloc(cores * sizeof(int));
+	char **diagram = malloc(cores * sizeof(char *));
+	size_t diagram_size = 1024, diagram_length = 0;
+	int *deadline = malloc((h->jobs + 1) * sizeof(int));
+	int *lateness = malloc((h->jobs + 1) * sizeof(int));
+
+	for (i = 0; i < h->jobs; i++)
+		deadline[i] = -1;
+
+	for (i = 0; i < cores; i++)
+	{
+		running[i] = -1;
+		diagram[i] = malloc(diagram_size + 1);
+		diagram[i][0] = '\0';
+	}
+
+	have_event = trace_reader_next(r, &ev);
+
+	for (time = 0; finished < h->jobs && (have_event || busy > 0); time++)
+	{
+		printf("=== [TIME %d] ===\n", time);
+
+		for (; have_event && ev.time <= time; have_event = trace_reader_next(r, &ev))
+		{
+			if (!valid_core(h, &ev))
+			{
+				have_event = 0;
+				status = 3;
+				break;
+			}
+
+			switch (ev.type)
+			{
+				case TRACE_FINISH:
+					printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n", ev.job_id, ev.core_id, ev.core_id, ev.arg0);
+					printf("  Queue: \n\n");
+					running[ev.core_id] = -1;
+					finished++;
+					if (ev.job_id >= 0 && ev.job_id < h->jobs && deadline[ev.job_id] >= 0)
+					{
+						lateness[late_count++] = ev.time - deadline[ev.job_id];
+						if (ev.time > deadline[ev.job_id])
+							missed++;
+					}
+					break;
+
+				case TRACE_QUANTUM_EXPIRE:
+					printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", ev.job_id, ev.core_id, ev.core_id, ev.arg0);
+					printf("  Queue: \n\n");
+					running[ev.core_id] = -1;
+					break;
+
+				case TRACE_ARRIVAL:
+					if (ev.core_id >= 0)
+						printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
+								ev.job_id, ev.arg0, ev.arg1, ev.job_id, ev.core_id);
+					else
+						printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
+								ev.job_id, ev.arg0, ev.arg1, ev.job_id);
+					printf("  Queue: \n\n");
+					if (ev.job_id >= 0 && ev.job_id < h->jobs)
+						deadline[ev.job_id] = ev.arg2;
+					if (ev.arg2 != -1)
+						has_deadlines = 1;
+					break;
+
+				case TRACE_PREEMPT:
+					running[ev.core_id] = -1;
+					break;
+
+				case TRACE_DISPATCH:
+					running[ev.core_id] = ev.job_id;
+					break;
+			}
+		}
+
+		if (finished == h->jobs)
+			break;
+
+		busy = 0;
+		for (i = 0; i < cores && !status; i++)
+			busy += (running[i] != -1);
+
+		// Every core gains at most 15 characters per time unit
+		if (diagram_length + 15 >= diagram_size)
+		{
+			diagram_size *= 2;
+			for (i = 0; i < cores; i++)
+				diagram[i] = realloc(diagram[i], diagram_size + 1);
+		}
+
+		printf("At the end of time unit %d...\n", time);
+		for (i = 0; i < cores; i++)
+		{
+			char symbol[16] = "-";
+			if (running[i] != -1)
+				job_symbol(symbol, sizeof(symbol), running[i]);
+			strcat(diagram[i], symbol);
+			if (strlen(diagram[i]) > diagram_length)
+				diagram_length = strlen(diagram[i]);
+			printf("  Core %2d: %s\n", i, diagram[i]);
+		}
+		printf("\n  Queue: \n\n");
+	}
+
+	printf("FINAL TIMING DIAGRAM:\n");
+	for (i = 0; i < cores; i++)
+		printf("  Core %2d: %s\n", i, diagram[i]);
+
+	printf("\n");
+	printf("Average Waiting Time: %.2f\n", r->summary.waiting_time);
+	printf("Average Turnaround Time: %.2f\n", r->summary.turnaround_time);
+	printf("Average Response Time: %.2f\n", r->summary.response_time);
+
+	if (has_deadlines)
+	{
+		// Rounded through a float, as scheduler_deadline_stats() keeps it
+		float miss_rate = (late_count > 0) ? (1.0 * missed) / late_count : 0;
+
+		qsort(lateness, late_count, sizeof(int), lateness_comparator);
+		printf("Deadline Miss Rate: %.2f%% (%d of %d)\n", 100.0 * miss_rate, missed, late_count);
+		if (late_count > 0)
+			printf("Lateness p50/p90/p99/max: %d/%d/%d/%d\n", lateness[(late_count - 1) * 50 / 100],
+					lateness[(late_count - 1) * 90 / 100], lateness[(late_count - 1) * 99 / 100], lateness[late_count - 1]);
+		else
+			printf("Lateness p50/p90/p99/max: 0/0/0/0\n");
+	}
+
+	for (i = 0; i < cores; i++)
+		free(diagram[i]);
+	free(diagram);
+	free(lateness);
+	free(deadline);
+	free(running);
+
+	return status;
+}
+
+/**
+  Prints one complete ("X") event per stretch of a job on a core, one
+  thread per core, plus instant events for arrivals.
+ */
+int print_chrome(trace_reader_t *r)
+{
+	int cores = r->header.cores;
+	int i, status = 0;
+	trace_event_t ev;
+
+	int *running = malloc(cores * sizeof(int));
+	int *since = malloc(cores * sizeof(int));
+
+	printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"simulator\"}}");
+	for (i = 0; i < cores; i++)
+	{
+		running[i] = -1;
+		printf(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"Core %d\"}}", i, i);
+	}
+
+	while (trace_reader_next(r, &ev))
+	{
+		if (!valid_core(&r->header, &ev))
+		{
+			status = 3;
+			break;
+		}
+
+		switch (ev.type)
+		{
+			case TRACE_ARRIVAL:
+				printf(",\n{\"name\":\"arrival %d\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%d,\"pid\":0,\"tid\":0,\"args\":{\"running_time\":%d,\"priority\":%d,\"deadline\":%d}}",
+						ev.job_id, ev.time, ev.arg0, ev.arg1, ev.arg2);
+				break;
+
+			case TRACE_DISPATCH:
+				running[ev.core_id] = ev.job_id;
+				since[ev.core_id] = ev.time;
+				break;
+
+			case TRACE_PREEMPT:
+			case TRACE_QUANTUM_EXPIRE:
+			case TRACE_FINISH:
+				if (running[ev.core_id] == ev.job_id && ev.time > since[ev.core_id])
+					printf(",\n{\"name\":\"job %d\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%d,\"dur\":%d,\"pid\":0,\"tid\":%d}",
+							ev.job_id, ev.type == TRACE_FINISH ? "finish" : (ev.type == TRACE_PREEMPT ? "preempt" : "quantum"),
+							since[ev.core_id], ev.time - since[ev.core_id], ev.core_id);
+				running[ev.core_id] = -1;
+				break;
+		}
+	}
+
+	printf("\n]}\n");
+
+	free(since);
+	free(running);
+	return status;
+}
+
+
+int main(int argc, char **argv)
+{
+	trace_reader_t r;
+	int ret;
+
+	if (argc != 3)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (trace_reader_init(&r, argv[2]) != 0)
+	{
+		fprintf(stderr, "Unable to read trace file \"%s\".\n", argv[2]);
+		return 2;
+	}
+
+	if (strcmp(argv[1], "text") == 0)
+		ret = print_text(&r);
+	else if (strcmp(argv[1], "chrome") == 0)
+		ret = print_chrome(&r);
+	else
+	{
+		print_usage(argv[0]);
+		ret = 1;
+	}
+
+	trace_reader_destroy(&r);
+	return ret;
+}
@@ -0,0 +1,250 @@
+/** @file wheeltest.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libwheel/libwheel.h"
+
+// Timers and time units in the churn benchmark
+#define BENCH_TIMERS 4096
+#define BENCH_TIME 200000
+
+// Random stream the churning re-arms draw from, after one per timer
+#define BENCH_CHURN BENCH_TIMERS
+
+/**
+  Binary heap of timer expiry times the benchmark compares the wheel
+  against. Each timer remembers its heap slot so it can be cancelled.
+ */
+typedef struct _heap_timer_t
+{
+  int expires;
+  int index;  // Position in the heap, -1 if not pending
+
+} heap_timer_t;
+
+heap_timer_t **heap;
+int heap_size;
+
+void heap_swap(int a, int b)
+{
+	heap_timer_t *t = heap[a];
+	heap[a] = heap[b];
+	heap[b] = t;
+	heap[a]->index = a;
+	heap[b]->index = b;
+}
+
+void heap_sift(int i)
+{
+	while (i > 0 && heap[(i - 1) / 2]->expires > heap[i]->expires) {
+		heap_swap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+	while (1) {
+		int least = i;
+		if (2 * i + 1 < heap_size && heap[2 * i + 1]->expires < heap[least]->expires)
+			least = 2 * i + 1;
+		if (2 * i + 2 < heap_size && heap[2 * i + 2]->expires < heap[least]->expires)
+			least = 2 * i + 2;
+		if (least == i)
+			break;
+		heap_swap(i, least);
+		i = least;
+	}
+}
+
+void heap_cancel(heap_timer_t *t)
+{
+	int i = t->index;
+	if (i < 0)
+		return;
+
+	heap_size--;
+	if (i != heap_size) {
+		heap[i] = heap[heap_size];
+		heap[i]->index = i;
+		heap_sift(i);
+	}
+	t->index = -1;
+}
+
+void heap_add(heap_timer_t *t, int expires)
+{
+	heap_cancel(t);
+	t->expires = expires;
+	t->index = heap_size;
+	heap[heap_size++] = t;
+	heap_sift(t->index);
+}
+
+/**
+  rand_r() states for the churn benchmark: one per timer, which its
+  re-arms draw from, and BENCH_CHURN for the churning re-arms. The wheel
+  and the heap fire the timers due in a time unit in different orders, so
+  with a single stream they would give them different delays.
+ */
+unsigned int *bench_seeds(unsigned int seed)
+{
+	unsigned int *seeds = malloc((BENCH_CHURN + 1) * sizeof(unsigned int));
+
+	for (int i = 0; i <= BENCH_CHURN; i++)
+		seeds[i] = seed + i;
+	return seeds;
+}
+
+/**
+  Every time unit, fires what is due and re-arms it, then cancels and
+  re-arms a few more timers the way preemptive schemes move quantum and
+  completion events around. Both runs start from the same seed and so
+  make the same timer operations (see bench_seeds()).
+ */
+double bench_wheel(unsigned int seed, long *fired_total, long *misfired_total)
+{
+	timer_wheel_t w;
+	wheel_timer_t *timers = malloc(BENCH_TIMERS * sizeof(wheel_timer_t));
+	unsigned int *seeds = bench_seeds(seed);
+	long fired = 0, misfired = 0;
+
+	wheel_init(&w, 0);
+	for (int i = 0; i < BENCH_TIMERS; i++) {
+		wheel_timer_init(&timers[i], i);
+		wheel_add(&w, &timers[i], 1 + rand_r(&seeds[i]) % 1000);
+	}
+
+	clock_t start = clock();
+	for (int now = 0; now < BENCH_TIME; now++) {
+		wheel_timer_t *t = wheel_expire(&w, now);
+		while (t != NULL) {
+			wheel_timer_t *next = t->next;
+			if (t->expires != now)
+				misfired++;
+			wheel_add(&w, t, now + 1 + rand_r(&seeds[t->id]) % 1000);
+			fired++;
+			t = next;
+		}
+		for (int k = 0; k < 8; k++) {
+			int i = rand_r(&seeds[BENCH_CHURN]) % BENCH_TIMERS;
+			wheel_add(&w, &timers[i], now + 1 + rand_r(&seeds[BENCH_CHURN]) % 16);
+		}
+	}
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	free(seeds);
+	free(timers);
+	*fired_total = fired;
+	*misfired_total = misfired;
+	return seconds;
+}
+
+double bench_heap(unsigned int seed, long *fired_total)
+{
+	heap_timer_t *timers = malloc(BENCH_TIMERS * sizeof(heap_timer_t));
+	heap_timer_t **due = malloc(BENCH_TIMERS * sizeof(heap_timer_t *));
+	unsigned int *seeds = bench_seeds(seed);
+	long fired = 0;
+
+	heap = malloc(BENCH_TIMERS * sizeof(heap_timer_t *));
+	heap_size = 0;
+	for (int i = 0; i < BENCH_TIMERS; i++) {
+		timers[i].index = -1;
+		heap_add(&timers[i], 1 + rand_r(&seeds[i]) % 1000);
+	}
+
+	clock_t start = clock();
+	for (int now = 0; now < BENCH_TIME; now++) {
+		int count = 0;
+		while (heap_size > 0 && heap[0]->expires <= now) {
+			due[count] = heap[0];
+			heap_cancel(heap[0]);
+			count++;
+		}
+		for (int i = 0; i < count; i++) {
+			heap_add(due[i], now + 1 + rand_r(&seeds[due[i] - timers]) % 1000);
+			fired++;
+		}
+		for (int k = 0; k < 8; k++) {
+			int i = rand_r(&seeds[BENCH_CHURN]) % BENCH_TIMERS;
+			heap_add(&timers[i], now + 1 + rand_r(&seeds[BENCH_CHURN]) % 16);
+		}
+	}
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	free(seeds);
+	free(heap);
+	free(due);
+	free(timers);
+	*fired_total = fired;
+	return seconds;
+}
+
+void print_fired(timer_wheel_t *w, int time)
+{
+	for (wheel_timer_t *t = wheel_expire(w, time); t != NULL; t = t->next)
+		printf("%d ", t->id);
+}
+
+int main()
+{
+	timer_wheel_t w;
+	wheel_timer_t timers[6];
+	int i;
+
+	wheel_init(&w, 0);
+	for (i = 0; i < 6; i++)
+		wheel_timer_init(&timers[i], i);
+
+	/* Near, far and very far timers, one cancelled, one moved. */
+	wheel_add(&w, &timers[0], 3);
+	wheel_add(&w, &timers[1], 3);
+	wheel_add(&w, &timers[2], 70);
+	wheel_add(&w, &timers[3], 5000);
+	wheel_add(&w, &timers[4], 20000000);
+	wheel_add(&w, &timers[5], 10);
+	wheel_cancel(&w, &timers[1]);
+	wheel_add(&w, &timers[5], 69);
+	printf("Pending timers: %d (expected 5).\n", w.pending);
+
+	printf("Fired through 2 (expected none): ");
+	print_fired(&w, 2);
+	printf("\n");
+
+	printf("Fired through 3 (expected 0): ");
+	print_fired(&w, 3);
+	printf("\n");
+
+	printf("Fired through 70 (expected 5 2): ");
+	print_fired(&w, 70);
+	printf("\n");
+
+	printf("Fired through 4999 (expected none): ");
+	print_fired(&w, 4999);
+	printf("\n");
+
+	printf("Fired through 5000 (expected 3): ");
+	print_fired(&w, 5000);
+	printf("\n");
+
+	wheel_add(&w, &timers[0], 100);
+	printf("Fired after adding in the past (expected 0): ");
+	print_fired(&w, 5001);
+	printf("\n");
+
+	printf("Fired through 20000000 (expected 4): ");
+	print_fired(&w, 20000000);
+	printf("\n");
+	printf("Pending timers: %d (expected 0).\n", w.pending);
+
+	long wheel_fired, wheel_misfired, heap_fired;
+	double wheel_seconds = bench_wheel(678, &wheel_fired, &wheel_misfired);
+	double heap_seconds = bench_heap(678, &heap_fired);
+	printf("Churn benchmark, %d timers over %d time units: wheel %.3fs, binary heap %.3fs (%ld and %ld fired).\n",
+			BENCH_TIMERS, BENCH_TIME, wheel_seconds, heap_seconds, wheel_fired, heap_fired);
+	printf("Wheel timers fired in the wrong time unit: %ld (expected 0).\n", wheel_misfired);
+	printf("Timers the wheel fired less those the heap fired: %ld (expected 0).\n", wheel_fired - heap_fired);
+
+	// The two runs make the same timer operations, or the timings mean nothing
+	return wheel_fired != heap_fired;
+}